@@ -1,13 +1,26 @@
 #pragma once
 #include <cstddef>
 
+class SnapshotWriter;
+
 class Allocator {
 public:
     virtual int malloc(size_t size) = 0;
     virtual void free(int id) = 0;
 
+    // Where an allocated block starts, so accesses to it can be turned into
+    // addresses; false if id is not allocated.
+    virtual bool get_block_start(int id, size_t& start) const = 0;
+
+    // Share of free memory outside the largest free block, in percent.
+    virtual double external_fragmentation() const = 0;
+
     virtual void dump() const = 0;
     virtual void stats() const = 0;
 
+    // Adds the allocator's full state to a snapshot; each allocator has a
+    // constructor that rebuilds it from one.
+    virtual void save(SnapshotWriter& out) const = 0;
+
     virtual ~Allocator() = default;
 };
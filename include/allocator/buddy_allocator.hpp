@@ -7,6 +7,8 @@
 #include <list>
 #include <unordered_map>
 
+class SnapshotReader;
+
 class BuddyAllocator : public Allocator {
 private:
     size_t total_memory;
@@ -30,15 +32,23 @@ private:
 
 public:
     BuddyAllocator(size_t memory_size);
+    // Rebuilds the free lists and allocation table saved by save(); throws
+    // std::runtime_error if the snapshot holds no buddy allocator or its
+    // blocks are misaligned or do not tile the memory exactly.
+    explicit BuddyAllocator(const SnapshotReader& in);
     ~BuddyAllocator() override = default;
 
     int malloc(size_t size) override;
     void free(int id) override;
+    bool get_block_start(int id, size_t& start) const override;
 
     void dump() const override;
     void stats() const override;
+    void save(SnapshotWriter& out) const override;
+
+    size_t get_total_memory() const { return total_memory; }
 
-    double external_fragmentation() const;
+    double external_fragmentation() const override;
     double internal_fragmentation() const;
     double utilization() const;
     double failure_rate() const;
@@ -4,6 +4,8 @@
 #include "block.hpp"
 #include "allocator_stats.hpp"
 
+class SnapshotReader;
+
 enum class FitStrategy {
     FirstFit,
     BestFit,
@@ -26,14 +28,21 @@ private:
 
 public:
     ListAllocator(size_t memory_size, FitStrategy strat);
+    // Rebuilds the block list saved by save(); throws std::runtime_error if
+    // the snapshot holds no list allocator.
+    explicit ListAllocator(const SnapshotReader& in);
     ~ListAllocator();
 
     int malloc(size_t size) override;
     void free(int id) override;
+    bool get_block_start(int id, size_t& start) const override;
+    double external_fragmentation() const override { return compute_external_fragmentation(); }
 
     void dump() const override;
     void stats() const override;
+    void save(SnapshotWriter& out) const override;
 
+    size_t get_total_memory() const { return total_memory; }
     size_t get_used_memory() const { return stats_data.used_memory; }
     size_t get_total_requests() const { return stats_data.total_alloc_requests; }
     size_t get_failed_requests() const { return stats_data.failed_alloc_requests; }
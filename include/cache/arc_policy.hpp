@@ -0,0 +1,47 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+#include "cache/replacement_policy.hpp"
+
+// Adaptive Replacement Cache (Megiddo & Modha). T1 holds blocks seen once
+// recently, T2 blocks seen at least twice; B1/B2 remember the ids recently
+// evicted from each. A hit in a ghost list moves the target size p of T1
+// towards the list that would have kept the block.
+class ArcPolicy final : public ReplacementPolicy {
+private:
+    enum Queue : uint8_t { T1, T2, B1, B2, NONE };
+
+    size_t capacity;
+    size_t target;    // p: desired size of T1
+
+    std::list<size_t> t1, t2;
+    std::list<size_t> b1, b2;
+
+    struct Ghost {
+        Queue queue;
+        std::list<size_t>::iterator pos;
+    };
+    std::unordered_map<size_t, Ghost> ghosts;
+
+    // Ghost hit of the block about to be inserted, found by adapt().
+    size_t pending_id;
+    Queue pending_ghost;
+
+    void adapt(size_t incoming);
+    void trim_ghosts();
+
+public:
+    ArcPolicy(size_t capacity);
+
+    CachePolicy kind() const override { return CachePolicy::ARC; }
+
+    void on_insert(CacheBlock& blk) override;
+    void on_hit(CacheBlock& blk) override;
+    size_t evict(size_t incoming) override;
+    void on_remove(CacheBlock& blk) override;
+    std::vector<size_t> eviction_order() const override;
+
+    size_t get_target() const { return target; }
+};
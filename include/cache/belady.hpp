@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Offline Belady MIN (OPT) for one cache level.
+//
+// The input is a raw trace of native-endian 64-bit addresses. One backward
+// pass writes the position of each access's next use to a side file, then
+// a forward pass replays the trace and evicts, within the block's set, the
+// resident block used farthest in the future. Both passes stream the files
+// in fixed-size chunks, so memory is bounded by the number of distinct
+// blocks and the level capacity, not by the trace length.
+//
+// Misses are appended to miss_path (same format), which is the input of
+// the next level down.
+
+struct BeladyResult {
+    size_t accesses = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+BeladyResult simulate_belady(const std::string& trace_path,
+                             const std::string& miss_path,
+                             size_t capacity,
+                             size_t line_size,
+                             size_t ways);
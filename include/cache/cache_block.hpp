@@ -0,0 +1,196 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+
+enum class CachePolicy {
+    FIFO,
+    LRU,
+    LFU,
+    LFU_AGING,
+    ARC,
+    TWO_Q,
+    CLOCK,
+    S3_FIFO
+};
+
+enum class AccessType {
+    READ,
+    WRITE
+};
+
+enum class WritePolicy {
+    WRITE_BACK,     // writes dirty the line; written out on eviction
+    WRITE_THROUGH   // every write is also sent to the next level
+};
+
+// A resident block as stored in a snapshot. slot is the block's way index
+// (set * ways + way) in a set-associative level and unused otherwise.
+struct SavedBlock {
+    uint64_t block_id;
+    uint64_t freq;
+    uint64_t last_used;
+    uint64_t inserted;
+    uint64_t slot;
+    uint8_t dirty;
+    uint8_t prefetched;
+    uint8_t padding[6];
+};
+
+// Block layouts. CacheBlock carries what every policy a CacheLevel may
+// pick at run time needs. Each static policy names two smaller layouts:
+// Policy::Line, a way of a set-associative level, holds only what ranking
+// ways needs; Policy::Block, an entry of a fully associative level, adds
+// the block's place in the policy's lists. Neither keeps a field it never
+// reads. Every layout provides:
+//   fill(now)     stamps a block just filled
+//   use(now)      stamps a hit, after the policy's on_hit()
+//   save(slot)    the snapshot record; stamps the layout does not keep
+//                 are derived from those it does
+//   load(saved)   the reverse
+struct CacheBlock {
+    size_t block_id;
+    size_t freq;
+    size_t last_used;
+    size_t inserted;
+
+    // Position of this block in the level's eviction order (or, for LFU,
+    // in its frequency bucket), so hits and evictions can relink it
+    // without scanning the list.
+    std::list<size_t>::iterator pos;
+
+    // Which of the policy's lists pos points into (ARC, 2Q).
+    uint8_t queue;
+
+    // Modified since it was filled; must be written back on eviction.
+    bool dirty;
+
+    // Brought in by a prefetcher and not demanded yet.
+    bool prefetched;
+
+    void fill(size_t now) {
+        freq = 1;
+        last_used = now;
+        inserted = now;
+    }
+
+    void use(size_t now) {
+        last_used = now;
+        freq++;
+    }
+
+    SavedBlock save(size_t slot) const {
+        return {block_id, freq, last_used, inserted, slot, dirty, prefetched, {}};
+    }
+
+    void load(const SavedBlock& s) {
+        block_id = s.block_id;
+        freq = s.freq;
+        last_used = s.last_used;
+        inserted = s.inserted;
+        queue = 0;
+        dirty = s.dirty;
+        prefetched = s.prefetched;
+    }
+};
+
+// FIFO ranks by fill time only.
+struct FifoLine {
+    size_t block_id;
+    size_t inserted;
+    bool dirty;
+    bool prefetched;
+
+    void fill(size_t now) { inserted = now; }
+    void use(size_t) {}
+
+    SavedBlock save(size_t slot) const {
+        return {block_id, 1, inserted, inserted, slot, dirty, prefetched, {}};
+    }
+
+    void load(const SavedBlock& s) {
+        block_id = s.block_id;
+        inserted = s.inserted;
+        dirty = s.dirty;
+        prefetched = s.prefetched;
+    }
+};
+
+struct FifoBlock : FifoLine {
+    std::list<size_t>::iterator pos;
+};
+
+// LRU ranks by last use only.
+struct LruLine {
+    size_t block_id;
+    size_t last_used;
+    bool dirty;
+    bool prefetched;
+
+    void fill(size_t now) { last_used = now; }
+    void use(size_t now) { last_used = now; }
+
+    SavedBlock save(size_t slot) const {
+        return {block_id, 1, last_used, last_used, slot, dirty, prefetched, {}};
+    }
+
+    void load(const SavedBlock& s) {
+        block_id = s.block_id;
+        last_used = s.last_used;
+        dirty = s.dirty;
+        prefetched = s.prefetched;
+    }
+};
+
+struct LruBlock : LruLine {
+    std::list<size_t>::iterator pos;
+};
+
+// LFU ranks by frequency, then last use.
+struct LfuLine {
+    size_t block_id;
+    size_t freq;
+    size_t last_used;
+    bool dirty;
+    bool prefetched;
+
+    void fill(size_t now) {
+        freq = 1;
+        last_used = now;
+    }
+
+    void use(size_t now) {
+        last_used = now;
+        freq++;
+    }
+
+    SavedBlock save(size_t slot) const {
+        return {block_id, freq, last_used, last_used, slot, dirty, prefetched, {}};
+    }
+
+    void load(const SavedBlock& s) {
+        block_id = s.block_id;
+        freq = s.freq;
+        last_used = s.last_used;
+        dirty = s.dirty;
+        prefetched = s.prefetched;
+    }
+};
+
+// An LfuPolicy frequency bucket (see cache_policies.hpp).
+struct LfuBucket;
+
+// Also keeps its bucket, which a CacheBlock has to look up by frequency on
+// every hit.
+struct LfuBlock : LfuLine {
+    std::list<size_t>::iterator pos;
+    std::list<LfuBucket>::iterator bucket;
+};
+
+// What an insert pushed out of the level, if anything.
+struct CacheEviction {
+    bool valid;
+    size_t block_id;
+    bool dirty;
+    bool prefetched;   // an unused prefetch
+};
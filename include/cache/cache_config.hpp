@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "cache/cache_level.hpp"
+#include "cache/prefetcher.hpp"
+#include "cache/virtual_memory.hpp"
+#include "cache/timing_model.hpp"
+#include "cache/dram.hpp"
+
+// How the contents of the levels relate:
+//   NINE       non-inclusive non-exclusive: misses fill every level, each
+//              level evicts on its own
+//   INCLUSIVE  every line above is also below; an eviction invalidates the
+//              copies in the levels above it (back-invalidation)
+//   EXCLUSIVE  a line lives in one level; data moves up to L1 on a hit and
+//              L1's victims are demoted level by level
+enum class InclusionPolicy {
+    NINE,
+    INCLUSIVE,
+    EXCLUSIVE
+};
+
+struct CacheLevelConfig {
+    std::string name;
+    size_t capacity;    // in lines
+    size_t line_size;   // in bytes
+    size_t hit_time;    // in cycles
+    CachePolicy policy;
+    size_t ways;        // 0 = fully associative
+    WritePolicy write_policy = WritePolicy::WRITE_BACK;
+    bool write_allocate = true;   // write misses fill the level
+    PrefetchPolicy prefetch = PrefetchPolicy::NONE;
+    size_t prefetch_degree = 1;   // lines per prefetch (stream depth)
+    size_t mshrs = 8;             // outstanding misses (non-blocking timing)
+};
+
+struct CacheConfig {
+    std::vector<CacheLevelConfig> levels;
+    size_t memory_penalty = 100;   // per memory access, unless dram is enabled
+    DramConfig dram;
+    InclusionPolicy inclusion = InclusionPolicy::NINE;
+    size_t sample_one_in = 1;   // > 1 enables sampled simulation
+    bool classify_misses = false;   // 3C breakdown; costs about a third of the speed
+    VmConfig vm;   // translation in front of the levels, off by default
+    TimingModel timing = TimingModel::BLOCKING;
+    size_t issue_width = 4;   // accesses issued per cycle (non-blocking)
+
+    // The classic three-level hierarchy: 4/8/16 lines of 16 bytes with
+    // 1/5/20 cycle hit times in front of a 100 cycle memory.
+    static CacheConfig defaults(CachePolicy policy);
+
+    // Reads a hierarchy description, one directive per line:
+    //   level <name> <capacity> <line_size> <hit_time> <policy> [ways]
+    //         [write-back|write-through] [write-allocate|no-write-allocate]
+    //   memory_penalty <cycles>
+    //   inclusion <nine|inclusive|exclusive>
+    //   prefetch <level name> <none|next-line|stride|stream> [degree]
+    //   sample <one in N lines, a power of two>
+    //   classify_misses <on|off>
+    //   virtual_memory <on|off>
+    //   page_size <bytes>
+    //   page_table_levels <levels for 4 KiB pages>
+    //   tlb <L1|L2> <entries> <hit_time> <policy> [ways]
+    //   physical_pages <count> [replacement policy]
+    //   page_faults <minor cycles> <major cycles>
+    //   timing <blocking|non-blocking> [issue width]
+    //   mshrs <level name> <count>
+    //   memory <fixed|dram>
+    //   dram <setting> <value>...   (see set_dram)
+    // Blank lines and '#' comments are ignored. Throws std::runtime_error
+    // on malformed input.
+    static CacheConfig load(const std::string& path);
+
+    // Parses "<name>:<capacity>:<line_size>:<hit_time>:<policy>[:<ways>]"
+    // with the same optional write options, the form accepted by the
+    // --cache-level flag.
+    static CacheLevelConfig parse_level(const std::string& spec);
+
+    void set_policy(CachePolicy policy);
+
+    // Throws if no level has that name.
+    void set_prefetch(const std::string& level, PrefetchPolicy policy, size_t degree);
+
+    // Parses "<level>:<policy>[:<degree>]", the --prefetch flag.
+    void parse_prefetch(const std::string& spec);
+
+    // One DRAM setting: channels|ranks|banks|row_size <n>,
+    // timings <tRCD> <tCAS> <tRP> [tBURST], row_policy <open|closed>,
+    // mapping <row-bank-column|row-column-bank|xor>. Throws on anything
+    // else.
+    void set_dram(const std::vector<std::string>& setting);
+
+    // Throws if no level has that name.
+    void set_mshrs(const std::string& level, size_t count);
+
+    // Parses "<level>:<count>", the --mshrs flag.
+    void parse_mshrs(const std::string& spec);
+    void validate() const;
+};
+
+bool cache_policy_from_string(const std::string& s, CachePolicy& out);
+std::string cache_policy_name(CachePolicy policy);
+std::string write_policy_name(WritePolicy policy);
+bool inclusion_policy_from_string(const std::string& s, InclusionPolicy& out);
+std::string inclusion_policy_name(InclusionPolicy policy);
@@ -4,38 +4,154 @@
 #include <unordered_map>
 #include <list>
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
 
-enum class CachePolicy {
-    FIFO,
-    LRU,
-    LFU
-};
+#include "cache/cache_block.hpp"
+#include "cache/cache_policies.hpp"
 
-struct CacheBlock {
-    size_t block_id;
-    size_t freq;
-    size_t last_used;
+// Which storage a level is compiled with. FULL keeps only the hash map
+// of a fully associative level, SET only the tag and line arrays of a
+// set-associative one; ANY keeps both and picks per level at run time,
+// which is what the CLI-facing CacheLevel needs.
+enum class Associativity {
+    FULL,
+    SET,
+    ANY
 };
 
-class CacheLevel {
+// Stands in for the storage a layout does not use.
+struct NoStorage {};
+
+// One cache level. Policy supplies the replacement bookkeeping and the
+// block layouts (see cache_policies.hpp): CacheLevel picks both at run
+// time, while BasicCacheLevel<LruPolicy, Associativity::SET> and friends
+// compile a hot path with one storage, the policy's own layout and no
+// per-access branch on the policy.
+template <class Policy, Associativity Layout>
+class BasicCacheLevel {
 private:
+    using Block = typename Policy::Block;   // map entries
+    using Line = typename Policy::Line;     // set-associative ways
+    using Traits = PolicyTraits<Policy>;
+    using BlockMap = std::unordered_map<size_t, Block>;
+
+    static constexpr bool HAS_MAP = Layout != Associativity::SET;
+    static constexpr bool HAS_SETS = Layout != Associativity::FULL;
+    static constexpr bool ONLY_SETS = Layout == Associativity::SET;
+    static constexpr bool HAS_SET_POLICIES = HAS_SETS && Traits::MAY_KEEP_SET_POLICIES;
+
+    // What find() returns: a level with both storages needs one layout.
+    using Resident = std::conditional_t<ONLY_SETS, Line, Block>;
+    static_assert(!HAS_MAP || !HAS_SETS || std::is_same_v<Line, Block>,
+                  "Associativity::ANY needs one layout for lines and blocks");
+
     size_t capacity;
     size_t hit_time;
-    CachePolicy policy;
+    Policy policy;
 
     size_t time_counter;
 
-    std::list<size_t> order;
-    std::unordered_map<size_t, CacheBlock> blocks;
+    std::conditional_t<HAS_MAP, BlockMap, NoStorage> blocks;
+
+    // Aging policies halve every frequency once per this many operations.
+    static constexpr size_t LFU_DECAY_FACTOR = 16;
+    size_t decay_interval;
+
+    // Set-associative layout (sets > 1). Way w of set s lives at index
+    // s * ways + w in both arrays; tags holds INVALID_TAG for empty ways.
+    size_t sets;
+    size_t ways;
+    size_t set_mask;
+    std::conditional_t<HAS_SETS, std::vector<uint64_t>, NoStorage> tags;
+    std::conditional_t<HAS_SETS, std::vector<Line>, NoStorage> lines;
+    size_t valid_lines;
+
+    // One policy per set, for policies that cannot rank ways.
+    std::conditional_t<HAS_SET_POLICIES, std::vector<Policy>, NoStorage> set_policies;
+
+    static constexpr uint64_t INVALID_TAG = ~uint64_t(0);
+
+    bool set_associative() const;
+    bool ranks_ways() const;
+    bool ages() const;
+    size_t set_of(size_t block_id) const;
+    uint64_t tag_of(size_t block_id) const;
+    size_t find_way(size_t set, uint64_t tag) const;
+    Resident* find(size_t block_id);
+    size_t victim_way(size_t set, size_t incoming);
+
+    void tick();
+    void touch(Block& blk);
+    void touch_way(size_t set, Line& line);
+    void decay();
 
 public:
-    CacheLevel(size_t cap, size_t hit, CachePolicy pol);
+    // ways == 0 (or ways == cap) models a fully associative level;
+    // otherwise the level has cap / ways sets indexed by the low bits of
+    // the block address. Throws if a FULL or SET layout is given the
+    // other kind of level.
+    BasicCacheLevel(size_t cap, size_t hit, CachePolicy pol, size_t ways = 0);
 
-    bool access(size_t block_id);
+    // Blocks hold iterators into the policy's own lists, so a level can be
+    // moved but never copied.
+    BasicCacheLevel(const BasicCacheLevel&) = delete;
+    BasicCacheLevel& operator=(const BasicCacheLevel&) = delete;
+    BasicCacheLevel(BasicCacheLevel&&) = default;
+    BasicCacheLevel& operator=(BasicCacheLevel&&) = default;
 
-    void insert(size_t block_id);
+    // A hit with write set marks the block dirty.
+    bool access(size_t block_id, bool write = false);
+
+    // Fills the block (dirty and/or flagged as a prefetch if requested) and
+    // reports the victim.
+    CacheEviction insert(size_t block_id, bool dirty = false, bool prefetched = false);
+
+    // True if the block is resident with its prefetch flag still set; the
+    // flag is cleared, so each prefetch is counted useful at most once.
+    bool consume_prefetch(size_t block_id);
+
+    // Lookups that leave the replacement state alone, for write-back and
+    // write-through traffic arriving from the level above.
+    bool contains(size_t block_id) const;
+    bool set_dirty(size_t block_id);
+
+    // Drops a resident block without counting an eviction; the result says
+    // whether it was there and dirty.
+    CacheEviction invalidate(size_t block_id);
+
+    size_t get_size() const;
+    std::vector<size_t> resident_blocks() const;
 
     void dump(const std::string& name) const;
 
+    // Resident blocks for a snapshot, in eviction order for a fully
+    // associative level. Throws unless the policy ranks ways (FIFO, LRU,
+    // LFU, LFU-aging): the others keep history the blocks do not carry.
+    std::vector<SavedBlock> save_blocks() const;
+
+    // Refills an empty level of the same geometry and policy from
+    // save_blocks() output and sets its clock to time.
+    void restore_blocks(const SavedBlock* saved, size_t count, size_t time);
+
+    // Ticks so far: the stamp the next access is recorded with.
+    size_t get_time() const;
+
     size_t get_hit_time() const;
+    CachePolicy get_policy() const;
+    size_t get_sets() const;
+    size_t get_ways() const;
 };
+
+using CacheLevel = BasicCacheLevel<DynamicPolicy, Associativity::ANY>;
+
+extern template class BasicCacheLevel<DynamicPolicy, Associativity::ANY>;
+extern template class BasicCacheLevel<FifoPolicy, Associativity::FULL>;
+extern template class BasicCacheLevel<FifoPolicy, Associativity::SET>;
+extern template class BasicCacheLevel<LruPolicy, Associativity::FULL>;
+extern template class BasicCacheLevel<LruPolicy, Associativity::SET>;
+extern template class BasicCacheLevel<LfuPolicy, Associativity::FULL>;
+extern template class BasicCacheLevel<LfuPolicy, Associativity::SET>;
+extern template class BasicCacheLevel<LfuAgingPolicy, Associativity::FULL>;
+extern template class BasicCacheLevel<LfuAgingPolicy, Associativity::SET>;
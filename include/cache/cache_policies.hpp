@@ -0,0 +1,349 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/cache_block.hpp"
+#include "cache/replacement_policy.hpp"
+
+// Replacement policies for BasicCacheLevel. A policy is constructed with
+// (CachePolicy, capacity), names its layouts as Line and Block (see
+// cache_block.hpp), keeps the eviction order of a fully associative level
+// and is called with:
+//   on_insert(blk)       new block, freq == 1
+//   on_hit(blk)          resident block used again, before freq is bumped
+//   evict(incoming)      unlink and return the victim's id
+//   on_remove(blk)       unlink a block invalidated from outside
+//   evict_before(a, b)   true if way a should be replaced before way b
+//   decay(blocks)        periodic aging, only when ages() is true
+//   on_restore(blk)      relink a block loaded from a snapshot; blocks
+//                        arrive in eviction_order() with freq restored
+// Set-associative levels rank their ways with evict_before() when
+// ranks_ways() is true, otherwise they keep one policy per set.
+// The policies below have no virtual functions and answer ages() and
+// ranks_ways() with constants, so BasicCacheLevel instantiated with one of
+// them compiles out the dispatch and the branches for the other cases
+// (see PolicyTraits). LfuPolicy is not final: LfuAgingPolicy extends it,
+// hiding rather than overriding its members.
+
+class QueuePolicy {
+protected:
+    std::list<size_t> order;
+
+public:
+    static constexpr bool ages() { return false; }
+    static constexpr bool ranks_ways() { return true; }
+
+    template <class B>
+    void on_insert(B& blk) {
+        blk.pos = order.insert(order.end(), blk.block_id);
+    }
+
+    template <class B>
+    void on_restore(B& blk) {
+        on_insert(blk);
+    }
+
+    size_t evict(size_t) {
+        size_t victim = order.front();
+        order.pop_front();
+        return victim;
+    }
+
+    template <class B>
+    void on_remove(B& blk) {
+        order.erase(blk.pos);
+    }
+
+    template <class B>
+    void decay(std::unordered_map<size_t, B>&) {}
+
+    std::vector<size_t> eviction_order() const {
+        return std::vector<size_t>(order.begin(), order.end());
+    }
+};
+
+class FifoPolicy final : public QueuePolicy {
+public:
+    using Line = FifoLine;
+    using Block = FifoBlock;
+
+    explicit FifoPolicy(CachePolicy = CachePolicy::FIFO, size_t = 0) {}
+
+    static constexpr CachePolicy kind() { return CachePolicy::FIFO; }
+
+    template <class B>
+    void on_hit(B&) {}
+
+    template <class B>
+    bool evict_before(const B& a, const B& b) const {
+        return a.inserted < b.inserted;
+    }
+};
+
+class LruPolicy final : public QueuePolicy {
+public:
+    using Line = LruLine;
+    using Block = LruBlock;
+
+    explicit LruPolicy(CachePolicy = CachePolicy::LRU, size_t = 0) {}
+
+    static constexpr CachePolicy kind() { return CachePolicy::LRU; }
+
+    template <class B>
+    void on_hit(B& blk) {
+        order.splice(order.end(), order, blk.pos);
+    }
+
+    template <class B>
+    bool evict_before(const B& a, const B& b) const {
+        return a.last_used < b.last_used;
+    }
+};
+
+// Blocks grouped by frequency, each bucket ordered by last_used, so the
+// front of the lowest bucket is the oldest of the least frequently used.
+// Buckets sit in a list sorted by frequency (the classic O(1) LFU): a hit
+// moves a block to the next bucket, creating it if needed, and the lowest
+// bucket is always the front, so no hook ever scans the frequencies.
+struct LfuBucket {
+    size_t freq;
+    std::list<size_t> blocks;
+};
+
+class LfuPolicy {
+protected:
+    using Bucket = LfuBucket;
+    using BucketIt = std::list<Bucket>::iterator;
+
+    std::list<Bucket> buckets;                      // ascending freq
+    std::unordered_map<size_t, BucketIt> by_freq;
+
+    BucketIt bucket_after(BucketIt pos, size_t freq);
+    void drop_if_empty(BucketIt bucket);
+
+    // The block's bucket: kept in an LfuBlock, looked up for a CacheBlock.
+    template <class B> BucketIt bucket_of(const B& blk);
+    template <class B> void link(B& blk, BucketIt bucket);
+
+public:
+    using Line = LfuLine;
+    using Block = LfuBlock;
+
+    explicit LfuPolicy(CachePolicy = CachePolicy::LFU, size_t = 0) {}
+
+    // Buckets are found through iterators into buckets, which a copy would
+    // leave pointing into the original.
+    LfuPolicy(const LfuPolicy&) = delete;
+    LfuPolicy& operator=(const LfuPolicy&) = delete;
+    LfuPolicy(LfuPolicy&&) = default;
+    LfuPolicy& operator=(LfuPolicy&&) = default;
+
+    static constexpr CachePolicy kind() { return CachePolicy::LFU; }
+    static constexpr bool ages() { return false; }
+    static constexpr bool ranks_ways() { return true; }
+
+    template <class B> void on_insert(B& blk);
+    template <class B> void on_hit(B& blk);
+    size_t evict(size_t incoming);
+    template <class B> void on_remove(B& blk);
+    template <class B> void on_restore(B& blk);
+
+    // Defined in cache_policies.cpp for CacheBlock and LfuBlock.
+    template <class B> void decay(std::unordered_map<size_t, B>& blocks);
+
+    std::vector<size_t> eviction_order() const;
+
+    template <class B>
+    bool evict_before(const B& a, const B& b) const {
+        return a.freq < b.freq ||
+               (a.freq == b.freq && a.last_used < b.last_used);
+    }
+};
+
+// LFU whose frequencies are halved periodically so blocks that were hot
+// long ago stop pinning the level.
+class LfuAgingPolicy final : public LfuPolicy {
+public:
+    explicit LfuAgingPolicy(CachePolicy = CachePolicy::LFU_AGING, size_t = 0) {}
+
+    static constexpr CachePolicy kind() { return CachePolicy::LFU_AGING; }
+    static constexpr bool ages() { return true; }
+};
+
+// The bucket for freq, which belongs right after pos (or at the front when
+// pos is the end); created if missing.
+inline LfuPolicy::BucketIt LfuPolicy::bucket_after(BucketIt pos, size_t freq) {
+    BucketIt next = pos == buckets.end() ? buckets.begin() : std::next(pos);
+    if (next != buckets.end() && next->freq == freq)
+        return next;
+
+    BucketIt bucket = buckets.insert(next, Bucket{freq, {}});
+    by_freq[freq] = bucket;
+    return bucket;
+}
+
+inline void LfuPolicy::drop_if_empty(BucketIt bucket) {
+    if (!bucket->blocks.empty())
+        return;
+    by_freq.erase(bucket->freq);
+    buckets.erase(bucket);
+}
+
+template <class B>
+LfuPolicy::BucketIt LfuPolicy::bucket_of(const B& blk) {
+    if constexpr (std::is_same_v<B, LfuBlock>)
+        return blk.bucket;
+    else
+        return by_freq.find(blk.freq)->second;
+}
+
+// Appends the block to bucket.
+template <class B>
+void LfuPolicy::link(B& blk, BucketIt bucket) {
+    blk.pos = bucket->blocks.insert(bucket->blocks.end(), blk.block_id);
+    if constexpr (std::is_same_v<B, LfuBlock>)
+        blk.bucket = bucket;
+}
+
+template <class B>
+void LfuPolicy::on_insert(B& blk) {
+    link(blk, bucket_after(buckets.end(), 1));
+}
+
+// Blocks arrive in eviction order, so their bucket is the last one or a
+// new one after it.
+template <class B>
+void LfuPolicy::on_restore(B& blk) {
+    BucketIt bucket;
+    if (!buckets.empty() && buckets.back().freq == blk.freq)
+        bucket = std::prev(buckets.end());
+    else if (buckets.empty() || buckets.back().freq < blk.freq)
+        bucket = bucket_after(std::prev(buckets.end()), blk.freq);
+    else
+        throw std::runtime_error("Snapshot blocks are not in eviction order");
+
+    link(blk, bucket);
+}
+
+template <class B>
+void LfuPolicy::on_hit(B& blk) {
+    BucketIt bucket = bucket_of(blk);
+    BucketIt next = bucket_after(bucket, blk.freq + 1);
+    next->blocks.splice(next->blocks.end(), bucket->blocks, blk.pos);
+    if constexpr (std::is_same_v<B, LfuBlock>)
+        blk.bucket = next;
+    drop_if_empty(bucket);
+}
+
+template <class B>
+void LfuPolicy::on_remove(B& blk) {
+    BucketIt bucket = bucket_of(blk);
+    bucket->blocks.erase(blk.pos);
+    drop_if_empty(bucket);
+}
+
+inline size_t LfuPolicy::evict(size_t) {
+    BucketIt lowest = buckets.begin();
+    size_t victim = lowest->blocks.front();
+    lowest->blocks.pop_front();
+    drop_if_empty(lowest);
+    return victim;
+}
+
+// Exposes a static policy through the runtime interface.
+template <class Policy>
+class PolicyAdapter final : public ReplacementPolicy {
+private:
+    Policy impl;
+
+public:
+    using Line = CacheBlock;
+    using Block = CacheBlock;
+
+    PolicyAdapter(CachePolicy pol, size_t capacity) : impl(pol, capacity) {}
+
+    CachePolicy kind() const override { return impl.kind(); }
+    bool ages() const override { return impl.ages(); }
+    bool ranks_ways() const override { return impl.ranks_ways(); }
+
+    void on_insert(CacheBlock& blk) override { impl.on_insert(blk); }
+    void on_hit(CacheBlock& blk) override { impl.on_hit(blk); }
+    size_t evict(size_t incoming) override { return impl.evict(incoming); }
+    void on_remove(CacheBlock& blk) override { impl.on_remove(blk); }
+    void on_restore(CacheBlock& blk) override { impl.on_restore(blk); }
+
+    bool evict_before(const CacheBlock& a, const CacheBlock& b) const override {
+        return impl.evict_before(a, b);
+    }
+
+    void decay(std::unordered_map<size_t, CacheBlock>& blocks) override {
+        impl.decay(blocks);
+    }
+
+    std::vector<size_t> eviction_order() const override {
+        return impl.eviction_order();
+    }
+};
+
+// Runtime-selected policy, used by the CLI-facing CacheLevel. Every hook
+// is one virtual call into the ReplacementPolicy picked by make_policy().
+class DynamicPolicy {
+private:
+    std::unique_ptr<ReplacementPolicy> impl;
+
+public:
+    using Line = CacheBlock;
+    using Block = CacheBlock;
+
+    DynamicPolicy(CachePolicy pol, size_t capacity);
+
+    CachePolicy kind() const { return impl->kind(); }
+    bool ages() const { return impl->ages(); }
+    bool ranks_ways() const { return impl->ranks_ways(); }
+
+    void on_insert(CacheBlock& blk) { impl->on_insert(blk); }
+    void on_hit(CacheBlock& blk) { impl->on_hit(blk); }
+    size_t evict(size_t incoming) { return impl->evict(incoming); }
+    void on_remove(CacheBlock& blk) { impl->on_remove(blk); }
+    void on_restore(CacheBlock& blk) { impl->on_restore(blk); }
+
+    bool evict_before(const CacheBlock& a, const CacheBlock& b) const {
+        return impl->evict_before(a, b);
+    }
+
+    void decay(std::unordered_map<size_t, CacheBlock>& blocks) {
+        impl->decay(blocks);
+    }
+
+    std::vector<size_t> eviction_order() const {
+        return impl->eviction_order();
+    }
+};
+
+// What BasicCacheLevel can settle at compile time. A static policy's
+// ranks_ways() and ages() are constants, so the level keeps only the code
+// and storage for its answer; DynamicPolicy may answer either way, so the
+// level keeps both and asks it on each use.
+template <class Policy>
+struct PolicyTraits {
+    static constexpr bool DYNAMIC = false;
+    static constexpr bool MAY_RANK_WAYS = Policy::ranks_ways();
+    static constexpr bool MAY_KEEP_SET_POLICIES = !Policy::ranks_ways();
+    static constexpr bool MAY_AGE = Policy::ages();
+};
+
+template <>
+struct PolicyTraits<DynamicPolicy> {
+    static constexpr bool DYNAMIC = true;
+    static constexpr bool MAY_RANK_WAYS = true;
+    static constexpr bool MAY_KEEP_SET_POLICIES = true;
+    static constexpr bool MAY_AGE = true;
+};
+
+std::unique_ptr<ReplacementPolicy> make_policy(CachePolicy pol, size_t capacity);
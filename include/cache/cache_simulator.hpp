@@ -2,55 +2,249 @@
 
 #include <cstddef>
 #include <string>
-#include <fstream>
+#include <memory>
+#include <vector>
 
 #include "cache/cache_level.hpp"
+#include "cache/cache_config.hpp"
+#include "cache/event_log.hpp"
+#include "cache/prefetcher.hpp"
+#include "cache/sampling.hpp"
+#include "cache/miss_classifier.hpp"
+#include "cache/profiler.hpp"
+#include "snapshot/snapshot.hpp"
 
-class CacheSimulator {
-private:
-    CacheLevel l1;
-    CacheLevel l2;
-    CacheLevel l3;
+// Per-access logging is compiled out entirely with -DMEMSIM_NO_CACHE_LOGS;
+// otherwise a disabled log costs one branch per access and formats nothing.
+#ifdef MEMSIM_NO_CACHE_LOGS
+inline constexpr bool CACHE_LOGS_COMPILED = false;
+#else
+inline constexpr bool CACHE_LOGS_COMPILED = true;
+#endif
 
-    static constexpr size_t BLOCK_SIZE = 16;
-    static constexpr size_t MEMORY_PENALTY = 100;
+// Walks an access down a hierarchy of Level (a BasicCacheLevel). The
+// CLI uses CacheSimulator, whose policy is chosen at run time;
+// StaticCacheSimulator<LruPolicy, Associativity::SET> etc. compile one
+// policy and one layout into every level, ignore the policies named in the
+// config and throw if a level's ways do not match the layout.
+template <class Level>
+class BasicCacheSimulator {
+private:
+    CacheConfig config;
+    std::vector<Level> levels;
 
     bool logs_enabled;
-    bool filelog_enabled;
-    std::ofstream logfile;
+    std::vector<std::string> level_names;
+    std::unique_ptr<EventLog> event_log;
 
     size_t total_accesses;
 
-    size_t l1_hits, l1_misses;
-    size_t l2_hits, l2_misses;
-    size_t l3_hits, l3_misses;
+    std::vector<size_t> hits;
+    std::vector<size_t> misses;
     size_t memory_accesses;
 
+    // Memory accesses run_opt() charged at the flat memory_penalty, which
+    // it uses even when the DRAM model is on.
+    size_t opt_memory_accesses;
+
+    // 3C breakdown of each level's demand misses when the config asks for
+    // it (see miss_classifier.hpp); classifiers is empty otherwise.
+    std::vector<MissClassifier> classifiers;
+    std::vector<MissCounts> miss_kinds;
+
+    // Hot-block and reuse profile, null unless enabled.
+    std::unique_ptr<CacheProfiler> profiler;
+
+    // Address translation when config.vm is enabled, null otherwise.
+    std::unique_ptr<VirtualMemory> vm;
+
+    // Overlapped timing in the non-blocking model, null when blocking.
+    std::unique_ptr<NonBlockingTimer> timer;
+
+    // DRAM behind the last level, null for the flat memory_penalty.
+    std::unique_ptr<DramController> dram;
+
+    // Write traffic: dirty evictions and write-throughs leaving each level,
+    // writes that reached memory, and the cycles all of it cost (already
+    // included in total_cycles).
+    size_t writes;
+    std::vector<size_t> writebacks;
+    std::vector<size_t> write_throughs;
+    size_t memory_writes;
+    size_t write_cycles;
+
+    // Lines invalidated above a level by its evictions (inclusive) and
+    // victims demoted from a level to the next (exclusive).
+    std::vector<size_t> back_invalidations;
+    std::vector<size_t> demotions;
+
+    // Per-level prefetchers (null when disabled) and their bookkeeping.
+    std::vector<std::unique_ptr<Prefetcher>> prefetchers;
+    std::vector<PrefetchCounters> prefetch_stats;
+    std::vector<PollutionTracker> pollution;
+    std::vector<size_t> prefetch_candidates;   // reused by every access
+
     size_t total_cycles;
 
-    size_t address_to_block(size_t address) const;
-    void log(const std::string& msg);
+    // Sampled mode (sample_one_in > 1, see sampling.hpp): the counters
+    // above cover only the sampled accesses.
+    size_t sample_one_in;
+    size_t sample_unit;   // the largest line size
+    size_t skipped_accesses;
+    std::vector<SampleGroup> sample_groups;
+
+    size_t address_to_block(size_t address, size_t level) const;
+    void write_below(size_t level, size_t address, size_t& cycles);
+    void fill(size_t level, size_t address, bool dirty, size_t& cycles,
+              bool prefetched = false);
+    bool back_invalidate(size_t level, size_t address);
+    size_t read_page_table(size_t address);
+    size_t memory_latency(size_t address, bool write, size_t cycles);
+    void drop_frame(size_t base, size_t bytes);
+    void prefetch(size_t level, size_t block, size_t& cycles);
+    bool should_log() const {
+        return CACHE_LOGS_COMPILED && (logs_enabled || event_log);
+    }
+
+    void log(const CacheEvent& event);
 
 public:
-    CacheSimulator(CachePolicy policy);
-    ~CacheSimulator();
+    BasicCacheSimulator(CachePolicy policy);
+    BasicCacheSimulator(const CacheConfig& config);
+    ~BasicCacheSimulator();
 
     void enable_logs();
     void disable_logs();
 
+    // Records every access to a binary event log (EVENT_LOG_PATH) written
+    // by a background thread; decode it with decode_event_log().
+    static constexpr const char* EVENT_LOG_PATH = "cache_log.bin";
+
+    // A write error ends file logging: the access that hits it, or
+    // disable_filelog(), throws std::runtime_error.
     void enable_filelog();
     void disable_filelog();
 
-    void access(size_t address);
+    // Simulates only lines whose hash falls in a 1-in-one_in sample, on
+    // levels scaled down to match (see scale_for_sampling). Hit rates and
+    // the average access time become estimates; the *_estimate getters add
+    // 95% confidence intervals. The constructor calls it when the config
+    // sets sample_one_in. Must be called before the first access; throws if
+    // one_in is not a power of two or a level prefetches.
+    void enable_sampling(size_t one_in);
+
+    // Profiles the accesses that follow: the blocks missing most at each
+    // level, in bounded memory, and each level's reuse intervals (see
+    // profiler.hpp). Disabling drops the profile.
+    void enable_profiling(size_t counters = CacheProfiler::DEFAULT_COUNTERS);
+    void disable_profiling();
+    // Null while profiling is off.
+    const CacheProfiler* get_profiler() const;
+
+    // Writes follow each level's write policy: write-back levels mark the
+    // line dirty and write it to the next level when it is evicted,
+    // write-through levels pass every write on. Write misses fill only
+    // write-allocate levels. Write traffic that misses a lower level passes
+    // through it without allocating.
+    //
+    // With virtual memory enabled the address is virtual: it is translated
+    // first, and page-table reads on a TLB miss go through the levels
+    // ahead of the access without counting as accesses themselves.
+    //
+    // Each level's prefetcher then sees the access as that level saw it.
+    // Prefetches fill lines flagged as prefetched and add no latency of
+    // their own; write-backs of the lines they displace are charged.
+    void access(size_t address, AccessType type = AccessType::READ);
+
+    // Offline mode: replays a whole trace with Belady's OPT at every level
+    // (each level sees the misses of the one above) and adds the result to
+    // the counters, giving per-level miss counts no online policy can beat.
+    // The file form reads raw native-endian 64-bit addresses and runs in
+    // bounded memory; see belady.hpp. Levels are treated as non-inclusive
+    // whatever the configured inclusion policy, and memory always costs
+    // the flat memory_penalty: with the DRAM model on, stats() says so.
+    void run_opt(const std::string& trace_path);
+    void run_opt(const std::vector<size_t>& addresses);
+
+    // Adds the warmed hierarchy to a snapshot: every level's blocks with
+    // their stamps and clock, and the hit, miss and write counters. Throws
+    // in sampled mode, with virtual memory, or for a level whose policy
+    // does not rank ways (see BasicCacheLevel::save_blocks).
+    void save(SnapshotWriter& out) const;
+
+    // Loads a snapshot saved by a simulator with the same levels (sizes,
+    // associativity, line sizes, policies); the simulator then continues
+    // exactly as the saved one would have. Must be called before the first
+    // access. Prefetcher training, miss classification, the profile, DRAM
+    // rows and non-blocking timing are not saved and start cold.
+    void restore(const SnapshotReader& in);
 
     void dump() const;
     void stats() const;
 
     double get_overall_hit_rate() const;
+    // Serial latency per access, or with non-blocking timing the elapsed
+    // cycles per access, which credits overlapping misses.
     double get_avg_access_time() const;
+    double get_hit_rate(size_t level) const;
     double get_l1_hit_rate() const;
     double get_l2_hit_rate() const;
     double get_l3_hit_rate() const;
     size_t get_memory_accesses() const;
+    size_t get_write_count() const;
+    size_t get_writebacks(size_t level) const;
+    size_t get_write_throughs(size_t level) const;
+    size_t get_memory_writes() const;
+    size_t get_write_cycles() const;
+    size_t get_back_invalidations(size_t level) const;
+
+    // Demand misses of a level by cause; with classify_misses set in the
+    // config they add up to its misses, otherwise they are zero.
+    size_t get_compulsory_misses(size_t level) const;
+    size_t get_capacity_misses(size_t level) const;
+    size_t get_conflict_misses(size_t level) const;
+    size_t get_demotions(size_t level) const;
+
+    // Prefetch quality per level: accuracy is useful / issued, coverage is
+    // useful / (useful + remaining demand misses), both in percent.
+    const PrefetchCounters& get_prefetch_counters(size_t level) const;
+    double get_prefetch_accuracy(size_t level) const;
+    double get_prefetch_coverage(size_t level) const;
+
+    // Bytes of distinct data held across all levels, against the sum of
+    // the level sizes. Inclusive hierarchies duplicate every upper line;
+    // exclusive ones reach the sum.
+    size_t get_unique_capacity() const;
+    size_t get_total_capacity() const;
+    SampleEstimate get_overall_hit_rate_estimate() const;
+    SampleEstimate get_avg_access_time_estimate() const;
+    SampleEstimate get_hit_rate_estimate(size_t level) const;
+
+    // Simulated accesses; in sampled mode the rest are skipped.
     size_t get_total_accesses() const;
+    size_t get_skipped_accesses() const;
+    size_t get_level_count() const;
+    const CacheConfig& get_config() const;
+
+    // Null unless the config enables virtual memory.
+    const VirtualMemory* get_virtual_memory() const;
+    // Null unless the config selects non-blocking timing.
+    const NonBlockingTimer* get_timer() const;
+    // Null unless the config enables the DRAM model.
+    const DramController* get_dram() const;
 };
+
+using CacheSimulator = BasicCacheSimulator<CacheLevel>;
+
+template <class Policy, Associativity Layout>
+using StaticCacheSimulator = BasicCacheSimulator<BasicCacheLevel<Policy, Layout>>;
+
+extern template class BasicCacheSimulator<CacheLevel>;
+extern template class BasicCacheSimulator<BasicCacheLevel<FifoPolicy, Associativity::FULL>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<FifoPolicy, Associativity::SET>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<LruPolicy, Associativity::FULL>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<LruPolicy, Associativity::SET>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<LfuPolicy, Associativity::FULL>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<LfuPolicy, Associativity::SET>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<LfuAgingPolicy, Associativity::FULL>>;
+extern template class BasicCacheSimulator<BasicCacheLevel<LfuAgingPolicy, Associativity::SET>>;
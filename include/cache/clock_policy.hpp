@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "cache/replacement_policy.hpp"
+
+// CLOCK (second chance). Blocks sit on a ring with a reference bit; the
+// hand clears set bits as it sweeps and evicts the first block whose bit
+// is already clear. A hit only sets the bit, so it never relinks the ring.
+class ClockPolicy final : public ReplacementPolicy {
+private:
+    // The ring holds slots into ids and referenced rather than block ids,
+    // so a hit reaches its bit through the block's pos without hashing.
+    std::list<size_t> ring;
+    std::list<size_t>::iterator hand;
+    std::vector<size_t> ids;
+    std::vector<uint8_t> referenced;
+    std::vector<size_t> free_slots;
+
+    size_t take_slot(size_t block_id);
+    void unlink(std::list<size_t>::iterator pos);
+
+public:
+    ClockPolicy(size_t capacity);
+
+    // The ring holds iterators, including the hand, so it cannot be copied.
+    ClockPolicy(const ClockPolicy&) = delete;
+    ClockPolicy& operator=(const ClockPolicy&) = delete;
+
+    CachePolicy kind() const override { return CachePolicy::CLOCK; }
+
+    void on_insert(CacheBlock& blk) override;
+    void on_hit(CacheBlock& blk) override;
+    size_t evict(size_t incoming) override;
+    void on_remove(CacheBlock& blk) override;
+    std::vector<size_t> eviction_order() const override;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "cache/trace_reader.hpp"
+
+// Compressed trace layout (all integers little-endian):
+//
+//   header   "MSTRACE1", u32 version, u32 flags, u32 block_shift, u32 0
+//   chunk*   u32 payload bytes, u32 records, payload
+//   end      u32 0, u32 0
+//   index    per chunk: u64 file offset of the chunk, u32 bytes, u32 records
+//   footer   u64 chunk count, u64 total records, u64 index offset, "MSTRIDX1"
+//
+// Each payload holds zigzag varints of the delta between consecutive block
+// addresses (address >> block_shift), starting from block 0, so every chunk
+// decodes on its own. With TRACE_FLAG_WRITES the low bit of each varint is
+// the write flag.
+
+constexpr uint32_t COMPRESSED_TRACE_VERSION = 1;
+constexpr uint32_t TRACE_FLAG_WRITES = 1;
+constexpr size_t TRACE_CHUNK_RECORDS = 1 << 16;
+
+struct CompressedTraceHeader {
+    uint32_t version;
+    uint32_t flags;
+    uint32_t block_shift;
+};
+
+struct TraceChunkInfo {
+    uint64_t offset;   // of the chunk's own 8-byte header
+    uint32_t bytes;
+    uint32_t records;
+};
+
+class CompressedTraceWriter {
+private:
+    std::FILE* file;
+    CompressedTraceHeader header;
+
+    std::vector<uint8_t> payload;
+    uint32_t chunk_records;
+    uint64_t previous;
+
+    std::vector<TraceChunkInfo> index;
+    uint64_t offset;
+    uint64_t total_records;
+
+    void flush_chunk();
+
+public:
+    // block_size must be a power of two; addresses are rounded down to it.
+    CompressedTraceWriter(const std::string& path, size_t block_size,
+                          bool with_writes);
+    ~CompressedTraceWriter();
+
+    CompressedTraceWriter(const CompressedTraceWriter&) = delete;
+    CompressedTraceWriter& operator=(const CompressedTraceWriter&) = delete;
+
+    void append(const TraceRecord& rec);
+
+    // Writes the last chunk, the index and the footer. Called by the
+    // destructor if not done explicitly.
+    void close();
+
+    uint64_t get_records() const;
+    uint64_t get_bytes() const;
+};
+
+// Parses the header; throws if the file is not a compressed trace.
+CompressedTraceHeader read_compressed_header(std::FILE* file);
+
+// Loads the chunk index from the footer, for random access to chunks.
+std::vector<TraceChunkInfo> read_trace_index(const std::string& path,
+                                             CompressedTraceHeader& header);
+
+// Decodes one chunk payload into out, which must hold `records` entries.
+void decode_trace_chunk(const uint8_t* data, size_t bytes, size_t records,
+                        const CompressedTraceHeader& header, TraceRecord* out);
+
+// Re-encodes any trace; returns the number of records written.
+size_t convert_trace(TraceReader& reader, const std::string& path,
+                     size_t block_size, bool with_writes);
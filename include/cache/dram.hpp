@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// What a bank does with its row after a column access:
+//   OPEN    keeps it in the row buffer; a later access to the same row
+//           skips activation, one to another row must precharge first
+//   CLOSED  precharges at once, so every access activates its row
+enum class RowPolicy {
+    OPEN,
+    CLOSED
+};
+
+// How a line address is split into DRAM coordinates, lowest bits first:
+//   ROW_BANK_COLUMN  column, channel, bank, rank, row: consecutive lines
+//                    share a row (row-buffer locality)
+//   ROW_COLUMN_BANK  channel, bank, rank, column, row: consecutive lines
+//                    spread over channels and banks (parallelism)
+//   XOR              ROW_BANK_COLUMN with the bank bits XORed with the low
+//                    row bits, so rows that conflict in one bank spread
+//                    over all of them (permutation interleaving)
+enum class AddressMapping {
+    ROW_BANK_COLUMN,
+    ROW_COLUMN_BANK,
+    XOR
+};
+
+bool row_policy_from_string(const std::string& s, RowPolicy& out);
+std::string row_policy_name(RowPolicy policy);
+bool address_mapping_from_string(const std::string& s, AddressMapping& out);
+std::string address_mapping_name(AddressMapping mapping);
+
+// Timings are in simulator cycles. Channels, ranks, banks and the lines
+// per row must be powers of two.
+struct DramConfig {
+    bool enabled = false;   // false: the flat memory_penalty
+    size_t channels = 1;
+    size_t ranks = 1;
+    size_t banks = 8;
+    size_t row_size = 8192;   // bytes per row buffer
+    size_t t_rcd = 15;        // activate to column access
+    size_t t_cas = 15;        // column access to data
+    size_t t_rp = 15;         // precharge
+    size_t t_burst = 4;       // data transfer of one line
+    RowPolicy row_policy = RowPolicy::OPEN;
+    AddressMapping mapping = AddressMapping::ROW_BANK_COLUMN;
+
+    // Throws std::runtime_error unless the geometry divides into lines of
+    // line_size bytes.
+    void validate(size_t line_size) const;
+};
+
+struct DramCounters {
+    size_t reads = 0;
+    size_t writes = 0;
+    size_t row_hits = 0;
+    size_t row_empty = 0;       // bank precharged: activate only
+    size_t row_conflicts = 0;   // another row open: precharge and activate
+    uint64_t latency = 0;       // summed request latencies, queueing included
+    uint64_t bus_cycles = 0;    // data bursts
+    uint64_t first = 0;         // arrival of the first request
+    uint64_t last = 0;          // completion of the last
+};
+
+// Memory behind the last level, one request per line. Each bank keeps its
+// open row and the cycle it is free again; each channel its data bus.
+// A request waits for its bank, pays activation and precharge according
+// to the row-buffer state and policy, then waits for the bus.
+class DramController {
+private:
+    struct Bank {
+        bool open = false;
+        uint64_t row = 0;
+        uint64_t ready = 0;
+    };
+
+    DramConfig config;
+    size_t line_size;
+    unsigned column_bits, channel_bits, bank_bits, rank_bits;
+    std::vector<Bank> banks;               // channel, rank, bank
+    std::vector<uint64_t> bus_ready;       // per channel
+    DramCounters counters;
+
+public:
+    struct Location {
+        size_t channel;
+        size_t rank;
+        size_t bank;
+        uint64_t row;
+        size_t column;
+    };
+
+    DramController(const DramConfig& config, size_t line_size);
+
+    Location map(uint64_t address) const;
+
+    // Serves the line holding address for a request arriving at now;
+    // returns the cycles until its data has been transferred.
+    size_t access(uint64_t address, bool write, uint64_t now);
+
+    const DramCounters& get_counters() const;
+    double get_row_hit_rate() const;
+
+    // Bytes moved per cycle between the first request and the last
+    // completion.
+    double get_bandwidth() const;
+
+    void stats(std::ostream& out) const;
+};
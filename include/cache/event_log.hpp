@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One simulated access. hit_level is the index of the level that supplied
+// the data, or the number of levels for a main-memory access; block is the
+// L1 block number. Bit i of filled is set if the access loaded the line
+// into level i: exclusive hierarchies fill only L1, and no-write-allocate
+// writes skip the levels that do not allocate.
+struct CacheEvent {
+    uint64_t address;
+    uint64_t block;
+    uint32_t hit_level;
+    uint32_t cycles;
+    uint32_t filled;
+    uint8_t write;
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(CacheEvent) == 32, "CacheEvent is a fixed-size record");
+
+// Prints an event in the simulator's text log format.
+void write_event_text(std::ostream& out, const std::vector<std::string>& level_names,
+                      const CacheEvent& event);
+
+// Binary event log: "MSEVLOG1", u32 version, u32 level count, then per level
+// a u32 length and the name, followed by native-endian CacheEvent records.
+//
+// record() only copies into a ring buffer; a background thread drains it
+// with large fwrite calls. When the ring is full the producer waits, so no
+// event is ever dropped. If a write fails (e.g. a full disk) the writer
+// stops, and the next record() or close() throws its error.
+class EventLog {
+private:
+    std::FILE* file;
+    std::vector<CacheEvent> ring;
+
+    std::atomic<size_t> head;   // next slot to fill, owned by record()
+    std::atomic<size_t> tail;   // next slot to write, owned by the writer
+    std::atomic<bool> stopping;
+    std::atomic<bool> failed;     // the writer stopped on error
+    std::exception_ptr error;     // set before failed
+
+    std::mutex mutex;
+    std::condition_variable wake_writer;
+    std::condition_variable wake_producer;
+    std::thread writer;
+
+    size_t written;
+
+    void run();
+    void drain();
+    void flush_range(size_t from, size_t to);
+
+public:
+    EventLog(const std::string& path, const std::vector<std::string>& level_names,
+             size_t capacity = 1 << 16);
+    ~EventLog();
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    // Throws std::runtime_error once the writer has failed.
+    void record(const CacheEvent& event);
+
+    // Drains the ring, stops the writer and closes the file; throws if any
+    // write failed. The destructor closes too but swallows the error.
+    void close();
+
+    size_t get_written() const;
+};
+
+// Offline decoder: prints a binary event log in the text format; returns
+// the number of events.
+size_t decode_event_log(const std::string& path, std::ostream& out);
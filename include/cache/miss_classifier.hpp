@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What a fully associative LRU cache of the same capacity, seeing the same
+// references, makes of one of them.
+enum class ShadowResult {
+    FIRST_TOUCH,   // never referenced before
+    MISS,
+    HIT
+};
+
+// 3C classification for one level. A miss is compulsory on the first touch
+// of a block, capacity if the shadow LRU misses too, and conflict if the
+// shadow would have hit (so conflict misses also include those a better
+// replacement policy would avoid).
+//
+// One open-addressing table maps every block ever referenced to its shadow
+// node, or NO_NODE once evicted, so a reference costs one probe sequence
+// plus one more per shadow eviction. It holds every block the level has
+// seen, so it is kept flat (12 bytes a slot, at most half full) rather
+// than a node-based map.
+class MissClassifier {
+private:
+    static constexpr uint32_t NO_NODE = ~uint32_t(0);
+
+    struct Node {
+        size_t block;
+        uint32_t prev;   // towards the MRU end
+        uint32_t next;   // towards the LRU end
+    };
+
+    size_t capacity;
+    std::vector<Node> nodes;
+    uint32_t head;   // most recently used
+    uint32_t tail;   // least recently used
+    // Slot i holds block keys[i] - 1 (0 marks an empty slot).
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> node_of;   // shadow node of keys[i], or NO_NODE
+    size_t used_slots;
+    unsigned shift;   // 64 - log2(table size)
+
+    size_t find_slot(size_t block) const;
+    void grow();
+    void unlink(uint32_t n);
+    void push_front(uint32_t n);
+
+public:
+    explicit MissClassifier(size_t capacity);
+
+    ShadowResult reference(size_t block);
+};
+
+// Per-level miss breakdown.
+struct MissCounts {
+    size_t compulsory = 0;
+    size_t capacity = 0;
+    size_t conflict = 0;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/cache_level.hpp"
+#include "cache/cache_config.hpp"
+#include "cache/trace_reader.hpp"
+
+// MESI state of one core's copy of a line.
+enum class MesiState {
+    INVALID,
+    SHARED,
+    EXCLUSIVE,
+    MODIFIED
+};
+
+std::string mesi_state_name(MesiState state);
+
+// Counters kept for each core.
+struct CoreCounters {
+    size_t accesses = 0;
+    size_t writes = 0;
+    std::vector<size_t> hits;     // per private level
+    std::vector<size_t> misses;
+    size_t shared_hits = 0;
+    size_t shared_misses = 0;
+    size_t cycles = 0;
+
+    // Private misses on lines another core's write invalidated. True
+    // sharing if the word accessed was written by another core meanwhile,
+    // false sharing otherwise.
+    size_t coherence_misses = 0;
+    size_t true_sharing = 0;
+    size_t false_sharing = 0;
+
+    size_t upgrades = 0;               // S -> M on a private hit
+    size_t invalidations_received = 0;
+};
+
+// Several cores, each with private copies of every level of the config but
+// the last, in front of one shared last level. The private levels are kept
+// coherent with MESI through a directory held alongside the shared level,
+// which is inclusive of them: evicting a line there invalidates it in every
+// core. All levels must share one line size; every level is write-back and
+// write-allocate, and the config's inclusion and prefetch settings are not
+// used.
+class MulticoreSimulator {
+private:
+    struct DirectoryEntry {
+        uint64_t sharers = 0;   // cores holding the line
+        bool owned = false;     // the single sharer is E or M
+        bool dirty = false;     // ... and it is M
+        uint64_t lost = 0;      // cores that lost the line to a write
+    };
+
+    CacheConfig config;
+    size_t cores;
+    size_t line_size;
+    size_t word_size;   // sharing is tracked in up to 64 words per line
+
+    std::vector<std::vector<CacheLevel>> private_levels;   // [core][level]
+    CacheLevel shared;
+    std::unordered_map<size_t, DirectoryEntry> directory;
+
+    // Words written by other cores since each core lost a line.
+    std::vector<std::unordered_map<size_t, uint64_t>> lost_words;
+
+    std::vector<CoreCounters> counters;
+    size_t invalidations;
+    size_t interventions;       // lines supplied or downgraded by an E/M owner
+    size_t writebacks;          // M lines written back to the shared level
+    size_t back_invalidations;  // private copies dropped by shared evictions
+    size_t memory_accesses;
+    size_t memory_writes;
+
+    uint64_t word_bit(size_t address) const;
+    bool holds(size_t core, size_t block) const;
+    void drop(size_t core, size_t block);
+    void release(size_t core, size_t block, size_t& cycles);
+    void fill_private(size_t core, size_t level, size_t block, size_t& cycles);
+    void fill_shared(size_t block, size_t& cycles);
+    void invalidate_others(size_t core, size_t block, DirectoryEntry& entry, size_t& cycles);
+
+public:
+    // Throws std::runtime_error unless there are 1 to 64 cores, at least
+    // two levels and a single line size.
+    MulticoreSimulator(const CacheConfig& config, size_t cores);
+
+    void access(size_t core, size_t address, AccessType type = AccessType::READ);
+
+    // Replays one trace per core, merged by record time (ties go to the
+    // lower core). Each trace is parsed on its own host thread, a few
+    // chunks ahead of the simulation. Returns the number of accesses.
+    size_t replay(const std::vector<std::string>& paths, TraceFormat format);
+
+    void stats() const;
+
+    MesiState get_state(size_t core, size_t address) const;
+    bool is_cached(size_t core, size_t address) const;
+
+    size_t get_core_count() const;
+    const CoreCounters& get_counters(size_t core) const;
+    size_t get_coherence_misses() const;
+    size_t get_invalidations() const;
+    size_t get_interventions() const;
+    size_t get_writebacks() const;
+    size_t get_back_invalidations() const;
+    size_t get_memory_accesses() const;
+    size_t get_memory_writes() const;
+};
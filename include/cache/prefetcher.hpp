@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+enum class PrefetchPolicy {
+    NONE,
+    NEXT_LINE,
+    STRIDE,
+    STREAM
+};
+
+bool prefetch_policy_from_string(const std::string& s, PrefetchPolicy& out);
+std::string prefetch_policy_name(PrefetchPolicy policy);
+
+// A per-level hardware prefetcher. It sees the demand stream reaching its
+// level, in that level's block numbers, and proposes blocks to bring in.
+// trigger is true on a miss or on the first demand hit to a prefetched
+// block, the points where real prefetchers issue.
+class Prefetcher {
+public:
+    virtual ~Prefetcher() = default;
+
+    virtual PrefetchPolicy kind() const = 0;
+
+    // Appends the blocks to prefetch to out (which the caller clears).
+    virtual void on_access(size_t block, bool trigger, std::vector<size_t>& out) = 0;
+};
+
+// Fetches the next degree blocks after every trigger.
+class NextLinePrefetcher final : public Prefetcher {
+private:
+    size_t degree;
+
+public:
+    explicit NextLinePrefetcher(size_t degree);
+
+    PrefetchPolicy kind() const override { return PrefetchPolicy::NEXT_LINE; }
+    void on_access(size_t block, bool trigger, std::vector<size_t>& out) override;
+};
+
+// PC-less stride detector. Accesses are grouped into zones of
+// ZONE_BLOCKS contiguous blocks, each tracked in a small direct-mapped
+// table; once the same non-zero stride is seen twice in a zone, the next
+// degree blocks along it are fetched.
+class StridePrefetcher final : public Prefetcher {
+private:
+    static constexpr size_t ZONE_BLOCKS = 256;
+    static constexpr size_t TABLE_SIZE = 64;
+
+    struct Entry {
+        bool valid;
+        size_t zone;
+        size_t last_block;
+        int64_t stride;
+        uint8_t confidence;
+    };
+
+    size_t degree;
+    std::vector<Entry> table;
+
+public:
+    explicit StridePrefetcher(size_t degree);
+
+    PrefetchPolicy kind() const override { return PrefetchPolicy::STRIDE; }
+    void on_access(size_t block, bool trigger, std::vector<size_t>& out) override;
+};
+
+// Sequential stream detector in the spirit of Jouppi's stream buffers. A
+// miss allocates a stream (replacing the least recently used one); a second
+// miss close to it fixes the direction, and from then on each trigger
+// inside the stream's window keeps the next depth blocks prefetched. The
+// lines go into the cache itself rather than separate buffers.
+class StreamPrefetcher final : public Prefetcher {
+private:
+    static constexpr size_t STREAMS = 8;
+
+    struct Stream {
+        bool valid;
+        size_t head;        // last block of the stream that was demanded
+        int direction;      // 0 while still training
+        size_t last_used;
+    };
+
+    size_t depth;
+    std::vector<Stream> streams;
+    size_t clock;
+
+public:
+    explicit StreamPrefetcher(size_t depth);
+
+    PrefetchPolicy kind() const override { return PrefetchPolicy::STREAM; }
+    void on_access(size_t block, bool trigger, std::vector<size_t>& out) override;
+};
+
+// Returns nullptr for PrefetchPolicy::NONE.
+std::unique_ptr<Prefetcher> make_prefetcher(PrefetchPolicy policy, size_t degree);
+
+struct PrefetchCounters {
+    size_t issued = 0;      // prefetched lines actually filled
+    size_t useful = 0;      // of those, demanded before eviction
+    size_t unused = 0;      // evicted without a demand hit
+    size_t pollution = 0;   // demand misses on lines a prefetch evicted
+};
+
+// Remembers the last `limit` blocks evicted to make room for a prefetch,
+// so a later demand miss on one of them can be charged as pollution.
+class PollutionTracker {
+private:
+    size_t limit;
+    std::unordered_set<size_t> evicted;
+    std::deque<size_t> order;
+
+public:
+    explicit PollutionTracker(size_t limit);
+
+    void record(size_t block);
+
+    // True (and forgets the block) if the miss was caused by a prefetch.
+    bool demand_miss(size_t block);
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/cache_config.hpp"
+
+// A block reported by SpaceSaving. count may overestimate the true count,
+// by at most error.
+struct HotBlock {
+    size_t block;
+    size_t count;
+    size_t error;
+};
+
+// Space-Saving heavy hitters in a fixed number of counters. A block not
+// being counted takes over the smallest counter, inheriting its count as
+// error, so every block seen more than total / capacity times is kept.
+// Counters sit in a min-heap, making an update O(log capacity).
+class SpaceSaving {
+private:
+    size_t capacity;
+    size_t total;
+    std::vector<HotBlock> heap;                  // min-heap on count
+    std::unordered_map<size_t, size_t> index;    // block -> heap position
+
+    void swap_nodes(size_t a, size_t b);
+    void sift_down(size_t i);
+
+public:
+    explicit SpaceSaving(size_t capacity);
+
+    void add(size_t block);
+
+    // Up to k blocks, largest count first.
+    std::vector<HotBlock> top(size_t k) const;
+    size_t get_total() const;
+};
+
+// Reuse intervals of one level: the number of references the level saw
+// between two references to the same block, in power-of-two buckets.
+// Bucket b holds intervals in [2^b, 2^(b+1)).
+//
+// Only the tracked most recently used blocks are remembered, so memory
+// stays bounded. A block is aged out only after tracked other blocks were
+// referenced, so every interval shorter than tracked is counted exactly;
+// a block coming back after being aged out counts as a first touch.
+class ReuseHistogram {
+private:
+    struct Use {
+        size_t block;
+        uint64_t time;
+    };
+
+    size_t tracked;
+    std::list<Use> recent;   // most recent first
+    std::unordered_map<size_t, std::list<Use>::iterator> last_use;
+    uint64_t now;
+    size_t first_touches;
+    size_t aged_out;
+    std::vector<size_t> buckets;
+
+public:
+    static constexpr size_t DEFAULT_TRACKED = 1 << 16;
+
+    explicit ReuseHistogram(size_t tracked = DEFAULT_TRACKED);
+
+    // recent owns the nodes last_use points at.
+    ReuseHistogram(const ReuseHistogram&) = delete;
+    ReuseHistogram& operator=(const ReuseHistogram&) = delete;
+    ReuseHistogram(ReuseHistogram&&) = default;
+    ReuseHistogram& operator=(ReuseHistogram&&) = default;
+
+    void access(size_t block);
+
+    size_t get_first_touches() const;
+    size_t get_aged_out() const;
+    const std::vector<size_t>& get_buckets() const;
+};
+
+// Optional per-level profile of a hierarchy: the blocks that miss most
+// (at the last level, the ones causing memory traffic) and the reuse
+// intervals of the references each level sees.
+class CacheProfiler {
+private:
+    std::vector<std::string> names;
+    std::vector<size_t> line_sizes;
+    std::vector<SpaceSaving> miss_blocks;
+    std::vector<ReuseHistogram> reuse;
+
+public:
+    static constexpr size_t DEFAULT_COUNTERS = 256;
+
+    explicit CacheProfiler(const CacheConfig& config, size_t counters = DEFAULT_COUNTERS);
+
+    void on_access(size_t level, size_t block, bool hit);
+
+    const SpaceSaving& get_miss_blocks(size_t level) const;
+    const ReuseHistogram& get_reuse(size_t level) const;
+
+    void report(std::ostream& out, size_t k) const;
+
+    // Two CSV tables separated by a blank line: the top k missing blocks
+    // of every level, then every level's reuse histogram.
+    void export_csv(const std::string& path, size_t k) const;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/cache_block.hpp"
+
+// Runtime interface behind DynamicPolicy. It mirrors the hooks the static
+// policies in cache_policies.hpp provide, so any policy can back a
+// CacheLevel chosen with "set policy". Implementations must keep every
+// hook O(1).
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() = default;
+
+    virtual CachePolicy kind() const = 0;
+
+    // True if the policy ages frequencies through decay().
+    virtual bool ages() const { return false; }
+
+    // True if set-associative levels can pick a victim by ranking the ways
+    // of a set with evict_before(). Otherwise each set gets its own policy
+    // instance sized to the associativity.
+    virtual bool ranks_ways() const { return false; }
+
+    virtual void on_insert(CacheBlock& blk) = 0;
+    virtual void on_hit(CacheBlock& blk) = 0;
+
+    // Unlinks and returns the block to replace so incoming can be filled.
+    virtual size_t evict(size_t incoming) = 0;
+
+    // Unlinks a resident block removed by the hierarchy (back-invalidation
+    // or exclusive promotion). It is not an eviction, so no ghost entry.
+    virtual void on_remove(CacheBlock& blk) = 0;
+
+    // Relinks a block loaded from a snapshot. Only policies whose state is
+    // the blocks' own stamps and order (those that rank ways) support it.
+    virtual void on_restore(CacheBlock&) {
+        throw std::runtime_error("Replacement policy cannot be restored from a snapshot");
+    }
+
+    virtual bool evict_before(const CacheBlock&, const CacheBlock&) const {
+        return false;
+    }
+
+    virtual void decay(std::unordered_map<size_t, CacheBlock>&) {}
+
+    // Resident blocks, next victim first (approximate for CLOCK-like
+    // policies whose order depends on reference bits).
+    virtual std::vector<size_t> eviction_order() const = 0;
+};
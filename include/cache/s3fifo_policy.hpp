@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/replacement_policy.hpp"
+
+// S3-FIFO (Yang et al., SOSP '23). A small FIFO S (10% of the blocks)
+// filters one-hit wonders; blocks re-referenced while in S move to the
+// main FIFO M, the rest leave a ghost entry in G. M evicts with a 2-bit
+// frequency counter, reinserting blocks whose counter is non-zero.
+class S3FifoPolicy final : public ReplacementPolicy {
+private:
+    static constexpr uint8_t MAX_FREQ = 3;
+
+    size_t small_capacity;
+    size_t ghost_capacity;
+
+    struct Entry {
+        size_t block_id;
+        uint8_t freq;
+        bool in_main;
+    };
+
+    // S and M hold slots into entries rather than block ids, so a hit
+    // reaches its counter through the block's pos without hashing.
+    std::list<size_t> small, main;
+    std::vector<Entry> entries;
+    std::vector<size_t> free_slots;
+
+    std::list<size_t> ghost;
+    std::unordered_map<size_t, std::list<size_t>::iterator> ghost_index;
+
+    size_t take_slot(size_t block_id, bool in_main);
+    size_t evict_main();
+
+public:
+    S3FifoPolicy(size_t capacity);
+
+    CachePolicy kind() const override { return CachePolicy::S3_FIFO; }
+
+    void on_insert(CacheBlock& blk) override;
+    void on_hit(CacheBlock& blk) override;
+    size_t evict(size_t incoming) override;
+    void on_remove(CacheBlock& blk) override;
+    std::vector<size_t> eviction_order() const override;
+};
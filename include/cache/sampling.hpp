@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cache/cache_config.hpp"
+#include "cache/trace_reader.hpp"
+
+// Sampled simulation keeps the accesses to a hashed 1-in-N subset of lines
+// and runs them against levels with 1/N of the sets (or lines, if fully
+// associative), so each level sees about the load per set of the full
+// cache. Sampled lines are spread over SAMPLE_GROUPS groups by further hash
+// bits; the groups are independent clusters, and the spread between them
+// gives the confidence interval.
+inline constexpr size_t SAMPLE_GROUPS = 64;
+
+struct SampleGroup {
+    size_t accesses = 0;
+    size_t cycles = 0;
+    std::vector<size_t> hits;   // per level
+};
+
+// A value with the half-width of its 95% confidence interval.
+struct SampleEstimate {
+    double value;
+    double half_width;
+};
+
+// Hash of a sampled unit (the block at the largest line size); the low
+// bits pick the sample, higher bits the group.
+uint64_t sample_hash(uint64_t unit);
+
+// Ratio estimate sum(num) / sum(den) * scale over the groups, with the
+// between-group variance of a cluster sample.
+SampleEstimate ratio_estimate(const std::vector<double>& num, const std::vector<double>& den,
+                              double scale);
+
+// The hierarchy as run by a simulator sampling 1 in one_in lines: set
+// counts (or, for fully associative levels, capacities) divided by one_in,
+// keeping at least one line. Throws unless one_in is a power of two.
+CacheConfig scale_for_sampling(const CacheConfig& config, size_t one_in);
+
+// Validation harness: replays a trace fully and sampled with the same
+// config, and compares the sampled estimates with the exact results.
+struct SamplingValidation {
+    size_t one_in;
+    size_t accesses;
+    size_t sampled;
+    double full_seconds;
+    double sampled_seconds;
+
+    std::vector<std::string> level_names;
+    std::vector<double> full_level_hit_rates;
+    std::vector<SampleEstimate> level_hit_rates;
+    double full_hit_rate;
+    SampleEstimate hit_rate;
+    double full_avg_access_time;
+    SampleEstimate avg_access_time;
+};
+
+SamplingValidation validate_sampling(const CacheConfig& config, const std::string& path,
+                                     TraceFormat format, size_t one_in);
+
+void print_sampling_validation(const SamplingValidation& v, std::ostream& out);
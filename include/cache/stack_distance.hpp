@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Single-pass Mattson stack-distance analysis. The reuse distance of an
+// access is the number of distinct blocks touched since the previous access
+// to the same block; an LRU cache of C blocks hits exactly when that
+// distance is below C, so one pass yields the miss ratio of every size.
+//
+// Each block keeps a mark at the time of its last access in a Fenwick tree,
+// and the distance is the number of marks after it. Timestamps are
+// compacted whenever they run past twice the number of distinct blocks,
+// which keeps the tree O(M) and the cost O(log M) per access.
+class StackDistanceAnalyzer {
+private:
+    size_t block_size;
+
+    std::unordered_map<size_t, size_t> last_access;   // block -> timestamp
+    std::vector<size_t> tree;                         // Fenwick, 1-based
+    size_t now;
+
+    size_t accesses;
+    size_t cold_misses;
+    std::vector<size_t> histogram;                    // distance -> count
+
+    void add(size_t pos, long long delta);
+    size_t prefix(size_t pos) const;
+    void compact();
+
+public:
+    explicit StackDistanceAnalyzer(size_t block_size);
+
+    void access(size_t address);
+
+    size_t get_accesses() const;
+    size_t get_cold_misses() const;
+    size_t get_distinct_blocks() const;
+    const std::vector<size_t>& get_histogram() const;
+
+    // LRU miss ratio (0..1) for a fully associative cache of capacity blocks.
+    double miss_ratio(size_t capacity) const;
+
+    // Miss ratio for every capacity 1..distinct blocks; index c - 1.
+    std::vector<double> miss_ratio_curve() const;
+
+    void stats() const;
+    void export_csv(const std::string& path) const;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cache/cache_config.hpp"
+#include "cache/trace_reader.hpp"
+
+struct SweepResult {
+    std::string name;
+    std::vector<std::string> level_names;
+    std::vector<double> level_hit_rates;
+    double hit_rate;
+    double avg_access_time;
+    size_t memory_accesses;
+    size_t accesses;
+};
+
+// Runs many hierarchies over one trace in a single pass. The trace is
+// decoded once into chunks shared read-only by every configuration; a pool
+// of threads simulates each chunk (every simulator stays on one thread, so
+// it sees the chunks in order) while the next chunks are decoded.
+class CacheSweep {
+private:
+    std::vector<std::string> names;
+    std::vector<CacheConfig> configs;
+
+public:
+    // Throws std::runtime_error if the config is invalid.
+    void add(const std::string& name, const CacheConfig& config);
+
+    // Every replacement policy over base with all capacities multiplied by
+    // each scale, named like "lru x2".
+    void add_policy_grid(const CacheConfig& base, const std::vector<size_t>& scales);
+
+    size_t size() const;
+
+    // threads == 0 uses one per hardware thread, at most one per config.
+    std::vector<SweepResult> run(const std::string& path, TraceFormat format,
+                                 size_t threads = 0) const;
+};
+
+void print_sweep(const std::vector<SweepResult>& results, std::ostream& out);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How access latencies add up:
+//   BLOCKING      each access waits for the previous one; the average
+//                 access time is the mean serial latency
+//   NON_BLOCKING  accesses issue in order, up to issue_width per cycle,
+//                 and misses overlap as far as the levels' MSHRs allow
+enum class TimingModel {
+    BLOCKING,
+    NON_BLOCKING
+};
+
+bool timing_model_from_string(const std::string& s, TimingModel& out);
+std::string timing_model_name(TimingModel model);
+
+// Miss status holding registers of one level: the blocks being filled and
+// the cycle each fill lands.
+class MshrFile {
+private:
+    struct Entry {
+        size_t block;
+        uint64_t ready;
+    };
+
+    size_t capacity;
+    std::vector<Entry> entries;
+
+public:
+    explicit MshrFile(size_t capacity);
+
+    // The first cycle from now on with a free register.
+    uint64_t free_at(uint64_t now) const;
+
+    // When a fill of block still outstanding at now lands, or 0 if none is.
+    uint64_t pending(size_t block, uint64_t now) const;
+
+    // Takes a register free at now.
+    void allocate(size_t block, uint64_t ready, uint64_t now);
+};
+
+struct TimingCounters {
+    size_t accesses = 0;
+    size_t primary_misses = 0;   // allocated MSHRs
+    size_t merged = 0;           // waited on a fill already outstanding
+    size_t mshr_stalls = 0;      // issue held back by full MSHRs
+    uint64_t stall_cycles = 0;
+    uint64_t latency = 0;        // summed issue-to-completion cycles
+    uint64_t elapsed = 0;        // completion of the last access
+};
+
+// Timing for the non-blocking model, run alongside the functional
+// simulation. Cache contents change as soon as an access is simulated;
+// the timer only decides when the access would have completed. An access
+// that misses down to level h issues once every level above h has a free
+// MSHR, completes its serial latency later, and holds those MSHRs until
+// then. One that finds its block still being filled where it hit merges
+// with that fill and completes no earlier than it lands.
+class NonBlockingTimer {
+private:
+    size_t issue_width;
+    uint64_t issue_cycle;
+    size_t issued_this_cycle;
+    std::vector<size_t> line_sizes;
+    std::vector<MshrFile> mshrs;
+    TimingCounters counters;
+
+public:
+    NonBlockingTimer(const std::vector<size_t>& line_sizes,
+                     const std::vector<size_t>& mshrs, size_t issue_width);
+
+    // hit_level == number of levels for an access served by memory.
+    void access(size_t address, size_t hit_level, size_t latency);
+
+    const TimingCounters& get_counters() const;
+
+    // The earliest cycle the next access can issue.
+    uint64_t get_issue_cycle() const;
+
+    // Elapsed cycles per access: the achieved average access time.
+    double get_cycles_per_access() const;
+
+    // Average number of accesses in flight.
+    double get_mlp() const;
+
+    void stats(std::ostream& out, size_t serial_cycles) const;
+};
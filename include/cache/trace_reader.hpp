@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Address trace formats understood by TraceReader:
+//   Text        one access per line: "[R|W|L|S] <address> [<time>]", numbers
+//               in decimal or 0x-prefixed hex; '#' starts a comment
+//   Lackey      valgrind --tool=lackey --trace-mem=yes output; L/S/M data
+//               accesses are kept (M as a load then a store), I lines skipped
+//   Binary      raw native-endian 64-bit addresses, all reads
+//   Compressed  delta/varint chunks, see compressed_trace.hpp
+enum class TraceFormat {
+    Text,
+    Lackey,
+    Binary,
+    Compressed
+};
+
+// time orders the records of several per-thread traces. Only text traces
+// can give it; otherwise it is the record's position in its trace.
+struct TraceRecord {
+    uint64_t address;
+    bool write;
+    uint64_t time = 0;
+};
+
+bool trace_format_from_string(const std::string& s, TraceFormat& out);
+
+// Guesses the format from the file extension: .bin/.raw are binary,
+// .lackey/.vg are lackey output, .mtc is compressed, anything else is text.
+TraceFormat guess_trace_format(const std::string& path);
+
+// Streams a trace from disk in large chunks, parsing records in place, so
+// memory stays constant however long the trace is.
+class TraceReader {
+private:
+    std::FILE* file;
+    TraceFormat format;
+
+    std::vector<char> buffer;
+    size_t begin;     // first unparsed byte in buffer
+    size_t end;       // one past the last valid byte
+    bool eof;
+
+    size_t bytes_read;
+    size_t records_read;
+
+    // Lackey "M" yields a load and a store; the store is held here.
+    bool pending_store;
+    uint64_t pending_address;
+
+    // Compressed traces are decoded a whole chunk at a time.
+    uint32_t trace_flags;
+    uint32_t block_shift;
+    std::vector<TraceRecord> decoded;
+    size_t decoded_pos;
+
+    bool refill();
+    bool next_line(const char*& line, const char*& line_end);
+    bool parse_text(const char* p, const char* e, TraceRecord& rec) const;
+    bool parse_lackey(const char* p, const char* e, TraceRecord& rec);
+    bool ensure(size_t bytes);
+    bool decode_next_chunk();
+
+public:
+    TraceReader(const std::string& path, TraceFormat format);
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    // Fills out with up to max records; returns 0 once the trace is done.
+    size_t read(TraceRecord* out, size_t max);
+
+    size_t get_bytes_read() const;
+    size_t get_records_read() const;
+};
+
+// Copies any trace into the raw binary format (addresses only). Throws
+// std::runtime_error if the file cannot be written completely.
+size_t write_binary_trace(TraceReader& reader, const std::string& path);
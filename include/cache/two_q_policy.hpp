@@ -0,0 +1,33 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+#include "cache/replacement_policy.hpp"
+
+// Full 2Q (Johnson & Shasha). New blocks enter the FIFO A1in; blocks
+// evicted from it are remembered in the ghost FIFO A1out, and only a miss
+// that hits A1out is promoted to the LRU queue Am. One-time scans
+// therefore never displace Am.
+class TwoQPolicy final : public ReplacementPolicy {
+private:
+    enum Queue : uint8_t { A1IN, AM };
+
+    size_t kin;     // target size of A1in
+    size_t kout;    // size of the A1out ghost queue
+
+    std::list<size_t> a1in, am;
+    std::list<size_t> a1out;
+    std::unordered_map<size_t, std::list<size_t>::iterator> a1out_index;
+
+public:
+    TwoQPolicy(size_t capacity);
+
+    CachePolicy kind() const override { return CachePolicy::TWO_Q; }
+
+    void on_insert(CacheBlock& blk) override;
+    void on_hit(CacheBlock& blk) override;
+    size_t evict(size_t incoming) override;
+    void on_remove(CacheBlock& blk) override;
+    std::vector<size_t> eviction_order() const override;
+};
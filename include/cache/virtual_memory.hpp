@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "cache/cache_level.hpp"
+
+// One TLB level; entries == 0 leaves it out (only the L2 TLB may be).
+struct TlbConfig {
+    std::string name;
+    size_t entries;
+    size_t hit_time;   // in cycles
+    CachePolicy policy;
+    size_t ways;       // 0 = fully associative
+};
+
+// The virtual memory layer in front of the caches. Page tables are
+// x86-64 style radix trees with 512 entries of 8 bytes per 4 KiB table
+// page; table_levels counts the levels for 4 KiB pages, and huge pages
+// end the walk early (2 MiB one level up, 1 GiB two).
+struct VmConfig {
+    bool enabled = false;
+    size_t page_size = 4096;
+    size_t table_levels = 4;
+    TlbConfig l1_tlb = {"L1 TLB", 64, 1, CachePolicy::LRU, 4};
+    TlbConfig l2_tlb = {"L2 TLB", 1536, 7, CachePolicy::LRU, 12};
+
+    // Frames of page_size bytes, and how a victim is chosen once all are
+    // mapped.
+    size_t physical_pages = 65536;
+    CachePolicy page_policy = CachePolicy::CLOCK;
+
+    // A first touch maps a zeroed frame (minor fault); touching a page
+    // that was swapped out reads it back (major fault). Writing a dirty
+    // victim out costs a major fault too.
+    size_t minor_fault_cycles = 1000;
+    size_t major_fault_cycles = 100000;
+
+    // Throws std::runtime_error if the layout cannot be simulated.
+    void validate() const;
+};
+
+struct VmCounters {
+    size_t translations = 0;
+    size_t l1_tlb_hits = 0;
+    size_t l2_tlb_hits = 0;
+    size_t walks = 0;
+    size_t tlb_cycles = 0;    // TLB lookups
+    size_t walk_cycles = 0;   // page-table reads
+    size_t minor_faults = 0;
+    size_t major_faults = 0;
+    size_t evictions = 0;
+    size_t swap_writes = 0;   // dirty victims written out
+    size_t fault_cycles = 0;
+};
+
+// Translates virtual addresses for one simulated process. A TLB miss in
+// every level walks the page table, reading one entry per level through
+// read_pte (the simulator sends these through its data caches) and
+// allocating table pages as the tree grows. Table pages sit in physical
+// memory above the data frames and are never swapped.
+//
+// Frames are tracked by a fully associative CacheLevel keyed by page
+// number, so page_policy is any cache policy. Like a hardware accessed
+// bit, it sees a page when a walk loads its translation, not on TLB hits.
+// Reclaiming a frame drops its translation from both TLBs and passes the
+// frame's physical range to reclaim.
+class VirtualMemory {
+public:
+    // Returns the cycles one page-table entry read took.
+    using PteReader = std::function<size_t(uint64_t address)>;
+    using FrameReclaimer = std::function<void(uint64_t base, size_t bytes)>;
+
+private:
+    static constexpr size_t TABLE_PAGE = 4096;
+    static constexpr unsigned INDEX_BITS = 9;
+
+    VmConfig config;
+    unsigned page_shift;
+    size_t walk_depth;
+
+    std::vector<CacheLevel> tlbs;
+    CacheLevel frames;
+    std::unordered_map<uint64_t, size_t> frame_of;   // resident page -> frame
+    std::unordered_set<uint64_t> swapped;
+    size_t next_frame;
+
+    // Per walk level, the table page serving each prefix of the page number.
+    std::vector<std::unordered_map<uint64_t, size_t>> table_pages;
+    size_t table_page_count;
+    uint64_t table_base;
+
+    PteReader read_pte;
+    FrameReclaimer reclaim;
+    VmCounters counters;
+
+    void walk(uint64_t page, size_t& cycles);
+    void fault(uint64_t page, size_t& cycles);
+
+public:
+    VirtualMemory(const VmConfig& config, PteReader read_pte, FrameReclaimer reclaim);
+
+    // Adds the translation cost (TLBs, walk, fault) to cycles and returns
+    // the physical address.
+    uint64_t translate(uint64_t address, bool write, size_t& cycles);
+
+    const VmCounters& get_counters() const;
+    const VmConfig& get_config() const;
+    size_t get_walk_depth() const;
+    size_t get_resident_pages() const;
+    size_t get_table_pages() const;
+
+    // Misses over lookups at a TLB level (0 or 1), in percent.
+    double get_tlb_miss_rate(size_t level) const;
+
+    void stats(std::ostream& out) const;
+};
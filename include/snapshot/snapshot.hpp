@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary snapshots of warmed simulator state. A file is a header, a table
+// of sections and the sections themselves, each an 8-byte-aligned array of
+// fixed-size native-endian records:
+//
+//   header   "MSIMSNAP", version, section count
+//   table    per section: kind, record size, offset, record count
+//   data     the records
+//
+// A reader maps the file and hands out pointers straight into the mapping,
+// so loading costs no parsing; restoring only rebuilds the in-memory
+// indexes. Files from another version, or whose records have another size,
+// are rejected.
+enum class SnapshotSection : uint32_t {
+    CACHE_COUNTERS  = 1,
+    CACHE_LEVELS    = 2,
+    CACHE_BLOCKS    = 3,
+    LIST_ALLOCATOR  = 16,
+    LIST_BLOCKS     = 17,
+    BUDDY_ALLOCATOR = 32,
+    BUDDY_FREE      = 33,
+    BUDDY_ALLOCATED = 34
+};
+
+inline constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+class SnapshotWriter {
+private:
+    struct Section {
+        SnapshotSection kind;
+        uint32_t record_size;
+        uint64_t count;
+        std::vector<char> data;
+    };
+
+    std::vector<Section> sections;
+
+    void add_raw(SnapshotSection kind, const void* records, size_t record_size,
+                 size_t count);
+
+public:
+    // Replaces any section of the same kind.
+    template <class T>
+    void add(SnapshotSection kind, const std::vector<T>& records) {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot records must be POD");
+        add_raw(kind, records.data(), sizeof(T), records.size());
+    }
+
+    // Throws std::runtime_error if the file cannot be written.
+    void write(const std::string& path) const;
+};
+
+class SnapshotReader {
+private:
+    const char* base;
+    size_t length;
+
+    const void* find(SnapshotSection kind, size_t record_size, size_t& count) const;
+
+public:
+    // Maps path read-only; throws std::runtime_error if it cannot be opened
+    // or is not a snapshot of this version.
+    explicit SnapshotReader(const std::string& path);
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    bool has(SnapshotSection kind) const;
+
+    // The records of a section, valid while the reader lives. Throws if the
+    // section is missing or was written with another record layout.
+    template <class T>
+    const T* records(SnapshotSection kind, size_t& count) const {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshot records must be POD");
+        return static_cast<const T*>(find(kind, sizeof(T), count));
+    }
+
+    // Single-record sections.
+    template <class T>
+    const T& record(SnapshotSection kind) const {
+        size_t count;
+        const T* r = records<T>(kind, count);
+        if (count != 1)
+            throw_malformed();
+        return *r;
+    }
+
+    [[noreturn]] static void throw_malformed();
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "allocator/allocator.hpp"
+#include "cache/cache_simulator.hpp"
+
+// One step of a synthetic object workload. Objects are numbered in
+// allocation order; arg is the size for ALLOC and the byte offset into the
+// object for READ and WRITE.
+struct WorkloadOp {
+    enum Kind : uint8_t { ALLOC, FREE, READ, WRITE };
+
+    Kind kind;
+    uint32_t object;
+    uint32_t arg;
+};
+
+// A heap workload: each operation allocates an object (and writes every
+// word of it, as initialisation would), frees a live one, or reads or
+// writes one word of a live object. Accesses go to one of the most
+// recently allocated live objects recent_percent of the time, otherwise to
+// any live object.
+struct LocalityWorkload {
+    size_t heap_size = 1 << 20;   // bytes
+    size_t operations = 100000;
+    size_t min_size = 16;         // object sizes, in bytes
+    size_t max_size = 256;
+    unsigned alloc_percent = 10;
+    unsigned free_percent = 8;    // the rest are accesses
+    unsigned write_percent = 30;  // of the accesses
+    unsigned recent_percent = 50;
+    uint32_t seed = 42;
+
+    static constexpr size_t WORD = 8;
+    static constexpr size_t RECENT_OBJECTS = 32;
+
+    // The same operations for every call; throws std::runtime_error if the
+    // percentages or sizes make no sense.
+    std::vector<WorkloadOp> generate() const;
+};
+
+struct LocalityResult {
+    std::string name;
+    size_t heap_size = 0;
+    size_t allocations = 0;
+    size_t failed_allocations = 0;   // their objects are never accessed
+    size_t accesses = 0;
+    size_t footprint = 0;            // highest byte any object reached
+    double external_fragmentation = 0.0;
+    std::vector<std::string> level_names;
+    std::vector<double> level_hit_rates;
+    double hit_rate = 0.0;
+    double avg_access_time = 0.0;
+    size_t memory_accesses = 0;
+};
+
+// Runs ops through allocator, turning each object access into the block
+// start plus its offset, and feeds the addresses to cache.
+LocalityResult run_locality(const std::string& name, Allocator& allocator,
+                            CacheSimulator& cache, const std::vector<WorkloadOp>& ops);
+
+// The workload under first, best and worst fit and the buddy allocator,
+// each on a heap of workload.heap_size bytes and a fresh hierarchy built
+// from config. Buddy gets the largest power of two that fits instead when
+// heap_size is not one; print_locality() notes it.
+std::vector<LocalityResult> compare_allocators(const CacheConfig& config,
+                                               const LocalityWorkload& workload);
+
+void print_locality(const std::vector<LocalityResult>& results, std::ostream& out);
@@ -1,7 +1,30 @@
 #include "allocator/buddy_allocator.hpp"
+#include "snapshot/snapshot.hpp"
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <stdexcept>
+
+// Snapshot records (see snapshot.hpp). Free lists are saved in order, so
+// a restored allocator picks the same blocks.
+struct SavedBuddyAllocator {
+    uint64_t total_memory;
+    uint64_t max_order;
+    int64_t next_id;
+    AllocatorStats stats;
+};
+
+struct SavedBuddyFree {
+    uint64_t order;
+    uint64_t addr;
+};
+
+struct SavedBuddyAllocation {
+    int64_t id;
+    uint64_t addr;
+    uint64_t order;
+    uint64_t requested;
+};
 
 static bool is_power_of_two(size_t x) {
     return x && !(x & (x - 1));
@@ -22,6 +45,62 @@ BuddyAllocator::BuddyAllocator(size_t memory_size)
     stats_data.total_memory = memory_size;
 }
 
+BuddyAllocator::BuddyAllocator(const SnapshotReader& in) {
+    const auto& saved = in.record<SavedBuddyAllocator>(SnapshotSection::BUDDY_ALLOCATOR);
+    if (!is_power_of_two(saved.total_memory) || saved.max_order >= 64 ||
+        (1ULL << saved.max_order) != saved.total_memory)
+        SnapshotReader::throw_malformed();
+
+    total_memory = saved.total_memory;
+    max_order = saved.max_order;
+    next_id = static_cast<int>(saved.next_id);
+    stats_data = saved.stats;
+    free_lists.resize(max_order + 1);
+
+    // Free and allocated blocks together must tile the memory exactly, each
+    // aligned to its own size, or the allocator would hand out overlapping
+    // blocks.
+    std::vector<std::pair<size_t, size_t>> extents;   // addr, size
+    auto add_extent = [&](uint64_t addr, uint64_t order) {
+        if (order > max_order || addr & ((1ULL << order) - 1) ||
+            addr > total_memory - (1ULL << order))
+            SnapshotReader::throw_malformed();
+        extents.push_back({addr, size_t(1) << order});
+    };
+
+    size_t count;
+    const SavedBuddyFree* free_blocks =
+        in.records<SavedBuddyFree>(SnapshotSection::BUDDY_FREE, count);
+    for (size_t i = 0; i < count; i++) {
+        add_extent(free_blocks[i].addr, free_blocks[i].order);
+        free_lists[free_blocks[i].order].push_back(free_blocks[i].addr);
+    }
+
+    const SavedBuddyAllocation* blocks =
+        in.records<SavedBuddyAllocation>(SnapshotSection::BUDDY_ALLOCATED, count);
+    for (size_t i = 0; i < count; i++) {
+        add_extent(blocks[i].addr, blocks[i].order);
+        if (blocks[i].id <= 0 || blocks[i].id >= saved.next_id ||
+            blocks[i].requested == 0 || blocks[i].requested > (1ULL << blocks[i].order))
+            SnapshotReader::throw_malformed();
+        bool added = allocated.insert({static_cast<int>(blocks[i].id),
+                                       {blocks[i].addr, blocks[i].order,
+                                        blocks[i].requested}}).second;
+        if (!added)
+            SnapshotReader::throw_malformed();
+    }
+
+    std::sort(extents.begin(), extents.end());
+    size_t end = 0;
+    for (const auto& extent : extents) {
+        if (extent.first != end)
+            SnapshotReader::throw_malformed();
+        end += extent.second;
+    }
+    if (end != total_memory)
+        SnapshotReader::throw_malformed();
+}
+
 size_t BuddyAllocator::size_to_order(size_t size) const {
     size_t order = 0;
     size_t block = 1;
@@ -101,6 +180,15 @@ void BuddyAllocator::free(int id) {
     free_lists[order].push_back(addr);
 }
 
+bool BuddyAllocator::get_block_start(int id, size_t& start) const {
+    auto it = allocated.find(id);
+    if (it == allocated.end())
+        return false;
+
+    start = it->second.addr;
+    return true;
+}
+
 void BuddyAllocator::dump() const {
     std::cout << "Buddy Free Lists:\n";
     for (size_t i = 0; i <= max_order; i++) {
@@ -177,3 +265,24 @@ void BuddyAllocator::stats() const {
     std::cout << "Allocation failure rate: "
               << failure_rate() << "%\n";
 }
+
+void BuddyAllocator::save(SnapshotWriter& out) const {
+    std::vector<SavedBuddyFree> free_blocks;
+    for (size_t order = 0; order <= max_order; order++) {
+        for (size_t addr : free_lists[order])
+            free_blocks.push_back({order, addr});
+    }
+
+    std::vector<SavedBuddyAllocation> blocks;
+    for (const auto& it : allocated)
+        blocks.push_back({it.first, it.second.addr, it.second.order, it.second.requested});
+    std::sort(blocks.begin(), blocks.end(),
+              [](const SavedBuddyAllocation& a, const SavedBuddyAllocation& b) {
+                  return a.id < b.id;
+              });
+
+    SavedBuddyAllocator saved{total_memory, max_order, next_id, stats_data};
+    out.add(SnapshotSection::BUDDY_ALLOCATOR, std::vector<SavedBuddyAllocator>{saved});
+    out.add(SnapshotSection::BUDDY_FREE, free_blocks);
+    out.add(SnapshotSection::BUDDY_ALLOCATED, blocks);
+}
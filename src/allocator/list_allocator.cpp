@@ -1,6 +1,24 @@
 #include "allocator/list_allocator.hpp"
+#include "snapshot/snapshot.hpp"
 #include <iostream>
 #include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+// Snapshot records (see snapshot.hpp).
+struct SavedListAllocator {
+    uint64_t total_memory;
+    int64_t next_id;
+    uint64_t strategy;
+    AllocatorStats stats;
+};
+
+struct SavedListBlock {
+    uint64_t start;
+    uint64_t size;
+    int64_t id;
+    uint64_t free;
+};
 
 ListAllocator::ListAllocator(size_t memory_size, FitStrategy strat)
     : head(nullptr),
@@ -20,6 +38,45 @@ ListAllocator::ListAllocator(size_t memory_size, FitStrategy strat)
     stats_data.total_memory = memory_size;
 }
 
+ListAllocator::ListAllocator(const SnapshotReader& in) : head(nullptr) {
+    const auto& saved = in.record<SavedListAllocator>(SnapshotSection::LIST_ALLOCATOR);
+    size_t count;
+    const SavedListBlock* blocks = in.records<SavedListBlock>(SnapshotSection::LIST_BLOCKS, count);
+
+    // The blocks must tile the memory exactly.
+    size_t end = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (blocks[i].start != end || blocks[i].size == 0)
+            SnapshotReader::throw_malformed();
+        end += blocks[i].size;
+    }
+    if (count == 0 || end != saved.total_memory ||
+        saved.strategy > static_cast<uint64_t>(FitStrategy::WorstFit))
+        SnapshotReader::throw_malformed();
+
+    total_memory = saved.total_memory;
+    next_id = static_cast<int>(saved.next_id);
+    strategy = static_cast<FitStrategy>(saved.strategy);
+    stats_data = saved.stats;
+
+    Block* prev = nullptr;
+    for (size_t i = 0; i < count; i++) {
+        Block* block = new Block{
+            blocks[i].start,
+            blocks[i].size,
+            blocks[i].free != 0,
+            static_cast<int>(blocks[i].id),
+            prev,
+            nullptr
+        };
+        if (prev)
+            prev->next = block;
+        else
+            head = block;
+        prev = block;
+    }
+}
+
 ListAllocator::~ListAllocator() {
     Block* curr = head;
     while (curr) {
@@ -140,6 +197,16 @@ void ListAllocator::free(int id) {
     coalesce(block);
 }
 
+bool ListAllocator::get_block_start(int id, size_t& start) const {
+    for (Block* curr = head; curr; curr = curr->next) {
+        if (!curr->free && curr->id == id) {
+            start = curr->start;
+            return true;
+        }
+    }
+    return false;
+}
+
 void ListAllocator::dump() const {
     Block* curr = head;
     while (curr) {
@@ -217,3 +284,14 @@ double ListAllocator::compute_external_fragmentation() const {
     return (double)(total_free - largest_free) /
            (double)total_free * 100.0;
 }
+
+void ListAllocator::save(SnapshotWriter& out) const {
+    std::vector<SavedListBlock> blocks;
+    for (Block* curr = head; curr; curr = curr->next)
+        blocks.push_back({curr->start, curr->size, curr->id, curr->free});
+
+    SavedListAllocator saved{total_memory, next_id,
+                             static_cast<uint64_t>(strategy), stats_data};
+    out.add(SnapshotSection::LIST_ALLOCATOR, std::vector<SavedListAllocator>{saved});
+    out.add(SnapshotSection::LIST_BLOCKS, blocks);
+}
@@ -0,0 +1,97 @@
+#include "cache/arc_policy.hpp"
+#include <algorithm>
+
+ArcPolicy::ArcPolicy(size_t cap)
+    : capacity(std::max<size_t>(cap, 1)),
+      target(0),
+      pending_id(0),
+      pending_ghost(NONE) {}
+
+// Looks the incoming block up in the ghost lists and adapts p once per
+// miss. It runs from evict() when the level is full, otherwise from
+// on_insert().
+void ArcPolicy::adapt(size_t incoming) {
+    if (pending_ghost != NONE && pending_id == incoming)
+        return;
+
+    pending_id = incoming;
+    pending_ghost = NONE;
+
+    auto it = ghosts.find(incoming);
+    if (it == ghosts.end())
+        return;
+
+    pending_ghost = it->second.queue;
+
+    if (pending_ghost == B1) {
+        size_t delta = std::max<size_t>(b2.size() / b1.size(), 1);
+        target = std::min(capacity, target + delta);
+    } else {
+        size_t delta = std::max<size_t>(b1.size() / b2.size(), 1);
+        target = target > delta ? target - delta : 0;
+    }
+}
+
+// |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c.
+void ArcPolicy::trim_ghosts() {
+    while (!b1.empty() && t1.size() + b1.size() > capacity) {
+        ghosts.erase(b1.front());
+        b1.pop_front();
+    }
+    while (!b2.empty() &&
+           t1.size() + t2.size() + b1.size() + b2.size() > 2 * capacity) {
+        ghosts.erase(b2.front());
+        b2.pop_front();
+    }
+}
+
+size_t ArcPolicy::evict(size_t incoming) {
+    adapt(incoming);
+
+    bool from_t1 = !t1.empty() &&
+        (t2.empty() || t1.size() > target ||
+         (pending_ghost == B2 && t1.size() == target));
+
+    std::list<size_t>& from = from_t1 ? t1 : t2;
+    std::list<size_t>& ghost = from_t1 ? b1 : b2;
+
+    size_t victim = from.front();
+    from.pop_front();
+    ghosts[victim] = {from_t1 ? B1 : B2, ghost.insert(ghost.end(), victim)};
+
+    return victim;
+}
+
+void ArcPolicy::on_insert(CacheBlock& blk) {
+    adapt(blk.block_id);
+
+    if (pending_ghost != NONE) {
+        auto it = ghosts.find(blk.block_id);
+        (it->second.queue == B1 ? b1 : b2).erase(it->second.pos);
+        ghosts.erase(it);
+
+        blk.pos = t2.insert(t2.end(), blk.block_id);
+        blk.queue = T2;
+    } else {
+        blk.pos = t1.insert(t1.end(), blk.block_id);
+        blk.queue = T1;
+    }
+
+    pending_ghost = NONE;
+    trim_ghosts();
+}
+
+void ArcPolicy::on_hit(CacheBlock& blk) {
+    t2.splice(t2.end(), blk.queue == T1 ? t1 : t2, blk.pos);
+    blk.queue = T2;
+}
+
+void ArcPolicy::on_remove(CacheBlock& blk) {
+    (blk.queue == T1 ? t1 : t2).erase(blk.pos);
+}
+
+std::vector<size_t> ArcPolicy::eviction_order() const {
+    std::vector<size_t> ids(t1.begin(), t1.end());
+    ids.insert(ids.end(), t2.begin(), t2.end());
+    return ids;
+}
@@ -0,0 +1,163 @@
+#include "cache/belady.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+static constexpr size_t CHUNK = 1 << 16;
+static constexpr uint64_t NEVER = ~uint64_t(0);
+
+static size_t count_entries(std::ifstream& in) {
+    in.seekg(0, std::ios::end);
+    size_t bytes = static_cast<size_t>(in.tellg());
+    in.seekg(0, std::ios::beg);
+    return bytes / sizeof(uint64_t);
+}
+
+// Walks the trace from the end, one chunk at a time, remembering where each
+// block was seen last; that position is the next use of the earlier access.
+static void write_next_uses(const std::string& trace_path,
+                            const std::string& next_path,
+                            size_t line_size) {
+    std::ifstream in(trace_path, std::ios::binary);
+    std::ofstream out(next_path, std::ios::binary | std::ios::trunc);
+    if (!in || !out)
+        throw std::runtime_error("Cannot open OPT trace files");
+
+    size_t n = count_entries(in);
+    std::vector<uint64_t> addresses(CHUNK), next(CHUNK);
+    std::unordered_map<uint64_t, uint64_t> last_seen;
+
+    // Pre-size the output so chunks can be written back to front.
+    if (n > 0) {
+        out.seekp(n * sizeof(uint64_t) - 1);
+        out.put(0);
+    }
+
+    size_t end = n;
+    while (end > 0) {
+        size_t start = end > CHUNK ? end - CHUNK : 0;
+        size_t count = end - start;
+
+        in.seekg(start * sizeof(uint64_t));
+        in.read(reinterpret_cast<char*>(addresses.data()), count * sizeof(uint64_t));
+
+        for (size_t i = count; i-- > 0;) {
+            uint64_t block = addresses[i] / line_size;
+            auto it = last_seen.find(block);
+
+            if (it == last_seen.end()) {
+                next[i] = NEVER;
+                last_seen.emplace(block, start + i);
+            } else {
+                next[i] = it->second;
+                it->second = start + i;
+            }
+        }
+
+        out.seekp(start * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(next.data()), count * sizeof(uint64_t));
+        end = start;
+    }
+}
+
+BeladyResult simulate_belady(const std::string& trace_path,
+                             const std::string& miss_path,
+                             size_t capacity,
+                             size_t line_size,
+                             size_t ways) {
+    if (ways == 0 || ways > capacity)
+        ways = capacity;
+    size_t sets = capacity / ways;
+
+    const std::string next_path = miss_path + ".next";
+    write_next_uses(trace_path, next_path, line_size);
+
+    std::ifstream trace(trace_path, std::ios::binary);
+    std::ifstream next_uses(next_path, std::ios::binary);
+    std::ofstream misses(miss_path, std::ios::binary | std::ios::trunc);
+    if (!trace || !next_uses || !misses)
+        throw std::runtime_error("Cannot open OPT trace files");
+
+    // Resident blocks with their next use, plus a max-heap per set keyed on
+    // next use. Hits push a fresh entry instead of updating in place; stale
+    // entries are skipped when popped and the heap is rebuilt whenever it
+    // grows past twice the set size, so memory stays O(capacity).
+    using Entry = std::pair<uint64_t, uint64_t>;    // (next use, block)
+    std::unordered_map<uint64_t, uint64_t> resident;
+    std::vector<std::priority_queue<Entry>> heaps(sets);
+    std::vector<size_t> occupancy(sets, 0);
+
+    auto rebuild = [&](size_t set) {
+        std::vector<Entry> live;
+        auto& heap = heaps[set];
+        while (!heap.empty()) {
+            Entry e = heap.top();
+            heap.pop();
+            auto it = resident.find(e.second);
+            if (it != resident.end() && it->second == e.first)
+                live.push_back(e);
+        }
+        heap = std::priority_queue<Entry>(live.begin(), live.end());
+    };
+
+    BeladyResult result;
+    size_t n = count_entries(trace);
+    std::vector<uint64_t> addresses(CHUNK), next(CHUNK), missed;
+    missed.reserve(CHUNK);
+
+    for (size_t start = 0; start < n; start += CHUNK) {
+        size_t count = std::min(CHUNK, n - start);
+        trace.read(reinterpret_cast<char*>(addresses.data()), count * sizeof(uint64_t));
+        next_uses.read(reinterpret_cast<char*>(next.data()), count * sizeof(uint64_t));
+        missed.clear();
+
+        for (size_t i = 0; i < count; i++) {
+            uint64_t block = addresses[i] / line_size;
+            size_t set = block % sets;
+            auto& heap = heaps[set];
+            result.accesses++;
+
+            auto it = resident.find(block);
+            if (it != resident.end()) {
+                result.hits++;
+                it->second = next[i];
+                heap.emplace(next[i], block);
+                if (heap.size() > 2 * ways + 16)
+                    rebuild(set);
+                continue;
+            }
+
+            result.misses++;
+            missed.push_back(addresses[i]);
+
+            if (occupancy[set] >= ways) {
+                while (true) {
+                    Entry top = heap.top();
+                    heap.pop();
+                    auto victim = resident.find(top.second);
+                    if (victim != resident.end() && victim->second == top.first) {
+                        resident.erase(victim);
+                        break;
+                    }
+                }
+                occupancy[set]--;
+            }
+
+            resident.emplace(block, next[i]);
+            heap.emplace(next[i], block);
+            occupancy[set]++;
+        }
+
+        misses.write(reinterpret_cast<const char*>(missed.data()),
+                     missed.size() * sizeof(uint64_t));
+    }
+
+    next_uses.close();
+    std::remove(next_path.c_str());
+    return result;
+}
@@ -0,0 +1,365 @@
+#include "cache/cache_config.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+bool cache_policy_from_string(const std::string& s, CachePolicy& out) {
+    if (s == "fifo")      { out = CachePolicy::FIFO; return true; }
+    if (s == "lru")       { out = CachePolicy::LRU; return true; }
+    if (s == "lfu")       { out = CachePolicy::LFU; return true; }
+    if (s == "lfu-aging") { out = CachePolicy::LFU_AGING; return true; }
+    if (s == "arc")       { out = CachePolicy::ARC; return true; }
+    if (s == "2q")        { out = CachePolicy::TWO_Q; return true; }
+    if (s == "clock")     { out = CachePolicy::CLOCK; return true; }
+    if (s == "s3-fifo")   { out = CachePolicy::S3_FIFO; return true; }
+    return false;
+}
+
+std::string cache_policy_name(CachePolicy policy) {
+    switch (policy) {
+        case CachePolicy::FIFO:      return "fifo";
+        case CachePolicy::LRU:       return "lru";
+        case CachePolicy::LFU:       return "lfu";
+        case CachePolicy::LFU_AGING: return "lfu-aging";
+        case CachePolicy::ARC:       return "arc";
+        case CachePolicy::TWO_Q:     return "2q";
+        case CachePolicy::CLOCK:     return "clock";
+        case CachePolicy::S3_FIFO:   return "s3-fifo";
+    }
+    return "unknown";
+}
+
+std::string write_policy_name(WritePolicy policy) {
+    return policy == WritePolicy::WRITE_BACK ? "write-back" : "write-through";
+}
+
+bool inclusion_policy_from_string(const std::string& s, InclusionPolicy& out) {
+    if (s == "nine")      { out = InclusionPolicy::NINE; return true; }
+    if (s == "inclusive") { out = InclusionPolicy::INCLUSIVE; return true; }
+    if (s == "exclusive") { out = InclusionPolicy::EXCLUSIVE; return true; }
+    return false;
+}
+
+std::string inclusion_policy_name(InclusionPolicy policy) {
+    switch (policy) {
+        case InclusionPolicy::NINE:      return "nine";
+        case InclusionPolicy::INCLUSIVE: return "inclusive";
+        case InclusionPolicy::EXCLUSIVE: return "exclusive";
+    }
+    return "unknown";
+}
+
+CacheConfig CacheConfig::defaults(CachePolicy policy) {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 4, 16, 1, policy, 0},
+        {"L2", 8, 16, 5, policy, 0},
+        {"L3", 16, 16, 20, policy, 0},
+    };
+    config.memory_penalty = 100;
+    return config;
+}
+
+static size_t parse_size(const std::string& field, const std::string& what) {
+    try {
+        size_t used = 0;
+        unsigned long long value = std::stoull(field, &used, 0);
+        if (used == field.size())
+            return static_cast<size_t>(value);
+    } catch (const std::exception&) {
+    }
+    throw std::runtime_error("Invalid " + what + ": '" + field + "'");
+}
+
+static CacheLevelConfig make_level(const std::vector<std::string>& fields) {
+    if (fields.size() < 5 || fields.size() > 8)
+        throw std::runtime_error(
+            "Cache level needs name, capacity, line size, hit time, policy and optional "
+            "ways and write options");
+
+    CacheLevelConfig level;
+    level.name = fields[0];
+    level.capacity = parse_size(fields[1], "capacity");
+    level.line_size = parse_size(fields[2], "line size");
+    level.hit_time = parse_size(fields[3], "hit time");
+
+    if (!cache_policy_from_string(fields[4], level.policy))
+        throw std::runtime_error("Unknown cache policy: '" + fields[4] + "'");
+
+    level.ways = 0;
+    for (size_t i = 5; i < fields.size(); i++) {
+        const std::string& option = fields[i];
+        if (option == "write-back" || option == "wb")
+            level.write_policy = WritePolicy::WRITE_BACK;
+        else if (option == "write-through" || option == "wt")
+            level.write_policy = WritePolicy::WRITE_THROUGH;
+        else if (option == "write-allocate" || option == "wa")
+            level.write_allocate = true;
+        else if (option == "no-write-allocate" || option == "nwa")
+            level.write_allocate = false;
+        else if (i == 5)
+            level.ways = parse_size(option, "ways");
+        else
+            throw std::runtime_error("Unknown cache level option: '" + option + "'");
+    }
+    return level;
+}
+
+CacheLevelConfig CacheConfig::parse_level(const std::string& spec) {
+    std::vector<std::string> fields;
+    std::stringstream ss(spec);
+    std::string field;
+    while (std::getline(ss, field, ':'))
+        fields.push_back(field);
+
+    return make_level(fields);
+}
+
+CacheConfig CacheConfig::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("Cannot open cache config: " + path);
+
+    CacheConfig config;
+    std::string line;
+    size_t line_no = 0;
+
+    while (std::getline(in, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+
+        std::stringstream ss(line);
+        std::vector<std::string> fields;
+        std::string field;
+        while (ss >> field)
+            fields.push_back(field);
+
+        if (fields.empty())
+            continue;
+
+        try {
+            if (fields[0] == "level") {
+                fields.erase(fields.begin());
+                config.levels.push_back(make_level(fields));
+            }
+            else if (fields[0] == "memory_penalty" && fields.size() == 2) {
+                config.memory_penalty = parse_size(fields[1], "memory penalty");
+            }
+            else if (fields[0] == "prefetch" && (fields.size() == 3 || fields.size() == 4)) {
+                PrefetchPolicy policy;
+                if (!prefetch_policy_from_string(fields[2], policy))
+                    throw std::runtime_error("Unknown prefetcher: '" + fields[2] + "'");
+                size_t degree = fields.size() == 4 ? parse_size(fields[3], "prefetch degree") : 1;
+                config.set_prefetch(fields[1], policy, degree);
+            }
+            else if (fields[0] == "classify_misses" && fields.size() == 2) {
+                if (fields[1] != "on" && fields[1] != "off")
+                    throw std::runtime_error("classify_misses takes on or off");
+                config.classify_misses = fields[1] == "on";
+            }
+            else if (fields[0] == "virtual_memory" && fields.size() == 2) {
+                if (fields[1] != "on" && fields[1] != "off")
+                    throw std::runtime_error("virtual_memory takes on or off");
+                config.vm.enabled = fields[1] == "on";
+            }
+            else if (fields[0] == "page_size" && fields.size() == 2) {
+                config.vm.page_size = parse_size(fields[1], "page size");
+            }
+            else if (fields[0] == "page_table_levels" && fields.size() == 2) {
+                config.vm.table_levels = parse_size(fields[1], "page-table levels");
+            }
+            else if (fields[0] == "tlb" && (fields.size() == 5 || fields.size() == 6)) {
+                if (fields[1] != "L1" && fields[1] != "L2")
+                    throw std::runtime_error("tlb takes L1 or L2");
+                TlbConfig& tlb = fields[1] == "L1" ? config.vm.l1_tlb : config.vm.l2_tlb;
+                tlb.entries = parse_size(fields[2], "TLB entries");
+                tlb.hit_time = parse_size(fields[3], "TLB hit time");
+                if (!cache_policy_from_string(fields[4], tlb.policy))
+                    throw std::runtime_error("Unknown cache policy: '" + fields[4] + "'");
+                tlb.ways = fields.size() == 6 ? parse_size(fields[5], "TLB ways") : 0;
+            }
+            else if (fields[0] == "physical_pages" && (fields.size() == 2 || fields.size() == 3)) {
+                config.vm.physical_pages = parse_size(fields[1], "physical pages");
+                if (fields.size() == 3 && !cache_policy_from_string(fields[2], config.vm.page_policy))
+                    throw std::runtime_error("Unknown cache policy: '" + fields[2] + "'");
+            }
+            else if (fields[0] == "page_faults" && fields.size() == 3) {
+                config.vm.minor_fault_cycles = parse_size(fields[1], "minor fault cycles");
+                config.vm.major_fault_cycles = parse_size(fields[2], "major fault cycles");
+            }
+            else if (fields[0] == "timing" && (fields.size() == 2 || fields.size() == 3)) {
+                if (!timing_model_from_string(fields[1], config.timing))
+                    throw std::runtime_error("Unknown timing model: '" + fields[1] + "'");
+                if (fields.size() == 3)
+                    config.issue_width = parse_size(fields[2], "issue width");
+            }
+            else if (fields[0] == "mshrs" && fields.size() == 3) {
+                config.set_mshrs(fields[1], parse_size(fields[2], "MSHR count"));
+            }
+            else if (fields[0] == "memory" && fields.size() == 2) {
+                if (fields[1] != "fixed" && fields[1] != "dram")
+                    throw std::runtime_error("memory takes fixed or dram");
+                config.dram.enabled = fields[1] == "dram";
+            }
+            else if (fields[0] == "dram") {
+                config.set_dram(std::vector<std::string>(fields.begin() + 1, fields.end()));
+            }
+            else if (fields[0] == "sample" && fields.size() == 2) {
+                config.sample_one_in = parse_size(fields[1], "sample rate");
+            }
+            else if (fields[0] == "inclusion" && fields.size() == 2) {
+                if (!inclusion_policy_from_string(fields[1], config.inclusion))
+                    throw std::runtime_error("Unknown inclusion policy: '" + fields[1] + "'");
+            }
+            else {
+                throw std::runtime_error("Unknown directive '" + fields[0] + "'");
+            }
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(
+                path + ":" + std::to_string(line_no) + ": " + e.what());
+        }
+    }
+
+    config.validate();
+    return config;
+}
+
+void CacheConfig::set_policy(CachePolicy policy) {
+    for (auto& level : levels)
+        level.policy = policy;
+}
+
+void CacheConfig::set_prefetch(const std::string& name, PrefetchPolicy policy, size_t degree) {
+    for (auto& level : levels) {
+        if (level.name == name) {
+            level.prefetch = policy;
+            level.prefetch_degree = degree;
+            return;
+        }
+    }
+    throw std::runtime_error("Unknown cache level: '" + name + "'");
+}
+
+void CacheConfig::parse_prefetch(const std::string& spec) {
+    std::vector<std::string> fields;
+    std::stringstream ss(spec);
+    std::string field;
+    while (std::getline(ss, field, ':'))
+        fields.push_back(field);
+
+    if (fields.size() < 2 || fields.size() > 3)
+        throw std::runtime_error("Prefetch needs level, prefetcher and optional degree");
+
+    PrefetchPolicy policy;
+    if (!prefetch_policy_from_string(fields[1], policy))
+        throw std::runtime_error("Unknown prefetcher: '" + fields[1] + "'");
+
+    set_prefetch(fields[0], policy,
+                 fields.size() == 3 ? parse_size(fields[2], "prefetch degree") : 1);
+}
+
+void CacheConfig::validate() const {
+    if (levels.empty())
+        throw std::runtime_error("Cache hierarchy needs at least one level");
+    // The event log records the levels an access filled in 32 bits.
+    if (levels.size() > 32)
+        throw std::runtime_error("Cache hierarchy supports at most 32 levels");
+
+    if (sample_one_in == 0 || (sample_one_in & (sample_one_in - 1)) != 0)
+        throw std::runtime_error("Sampling rate must be 1 in a power of two");
+
+    if (timing == TimingModel::NON_BLOCKING) {
+        if (issue_width == 0)
+            throw std::runtime_error("Issue width must be at least 1");
+        if (sample_one_in > 1)
+            throw std::runtime_error("Sampled simulation does not support non-blocking timing");
+    }
+
+    if (dram.enabled)
+        dram.validate(levels.back().line_size);
+
+    if (vm.enabled) {
+        vm.validate();
+        if (sample_one_in > 1)
+            throw std::runtime_error("Sampled simulation does not support virtual memory");
+    }
+
+    for (const auto& level : levels) {
+        if (level.capacity == 0 || level.line_size == 0)
+            throw std::runtime_error(
+                "Cache level " + level.name + " needs a non-zero capacity and line size");
+
+        // Lines move between levels whole, so they must be the same size.
+        if (inclusion == InclusionPolicy::EXCLUSIVE &&
+            level.line_size != levels.front().line_size)
+            throw std::runtime_error(
+                "Exclusive hierarchies need the same line size at every level");
+
+        if (timing == TimingModel::NON_BLOCKING && level.mshrs == 0)
+            throw std::runtime_error("Cache level " + level.name + " needs at least one MSHR");
+
+        if (sample_one_in > 1 && level.prefetch != PrefetchPolicy::NONE)
+            throw std::runtime_error("Sampled simulation does not support prefetchers");
+
+        if (level.ways == 0 || level.ways >= level.capacity)
+            continue;
+
+        size_t sets = level.capacity / level.ways;
+        if (level.capacity % level.ways != 0 || (sets & (sets - 1)) != 0)
+            throw std::runtime_error(
+                "Cache level " + level.name + " needs a power-of-two number of sets");
+    }
+}
+
+void CacheConfig::set_mshrs(const std::string& name, size_t count) {
+    for (auto& level : levels) {
+        if (level.name == name) {
+            level.mshrs = count;
+            return;
+        }
+    }
+    throw std::runtime_error("Unknown cache level: '" + name + "'");
+}
+
+void CacheConfig::parse_mshrs(const std::string& spec) {
+    size_t colon = spec.find(':');
+    if (colon == std::string::npos)
+        throw std::runtime_error("MSHRs need level and count");
+    set_mshrs(spec.substr(0, colon), parse_size(spec.substr(colon + 1), "MSHR count"));
+}
+
+void CacheConfig::set_dram(const std::vector<std::string>& setting) {
+    if (setting.size() < 2)
+        throw std::runtime_error("dram needs a setting and a value");
+
+    const std::string& key = setting[0];
+    if (key == "timings" && (setting.size() == 4 || setting.size() == 5)) {
+        dram.t_rcd = parse_size(setting[1], "tRCD");
+        dram.t_cas = parse_size(setting[2], "tCAS");
+        dram.t_rp = parse_size(setting[3], "tRP");
+        if (setting.size() == 5)
+            dram.t_burst = parse_size(setting[4], "tBURST");
+        return;
+    }
+    if (setting.size() != 2)
+        throw std::runtime_error("Unknown dram setting '" + key + "'");
+
+    if (key == "channels")
+        dram.channels = parse_size(setting[1], "channel count");
+    else if (key == "ranks")
+        dram.ranks = parse_size(setting[1], "rank count");
+    else if (key == "banks")
+        dram.banks = parse_size(setting[1], "bank count");
+    else if (key == "row_size")
+        dram.row_size = parse_size(setting[1], "row size");
+    else if (key == "row_policy") {
+        if (!row_policy_from_string(setting[1], dram.row_policy))
+            throw std::runtime_error("Unknown row policy: '" + setting[1] + "'");
+    }
+    else if (key == "mapping") {
+        if (!address_mapping_from_string(setting[1], dram.mapping))
+            throw std::runtime_error("Unknown address mapping: '" + setting[1] + "'");
+    }
+    else
+        throw std::runtime_error("Unknown dram setting '" + key + "'");
+}
@@ -1,90 +1,558 @@
 #include "cache/cache_level.hpp"
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <stdexcept>
 
-CacheLevel::CacheLevel(size_t cap, size_t hit, CachePolicy pol)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Each member below that touches storage has a set-associative path under
+// if constexpr (HAS_SETS) and a fully associative one under
+// if constexpr (HAS_MAP). A FULL or SET level compiles only its own path.
+// The set path tests ONLY_SETS || sets > 1 in place of set_associative()
+// so a SET level's compiler sees the constant and knows the map path,
+// which it lacks, is never reached.
+
+template <class Policy, Associativity Layout>
+BasicCacheLevel<Policy, Layout>::BasicCacheLevel(size_t cap, size_t hit, CachePolicy pol, size_t ways)
     : capacity(cap),
       hit_time(hit),
-      policy(pol),
-      time_counter(0) {}
+      policy(pol, cap),
+      time_counter(0),
+      decay_interval(std::max<size_t>(cap, 1) * LFU_DECAY_FACTOR),
+      sets(1),
+      ways(cap),
+      set_mask(0),
+      valid_lines(0) {
 
-bool CacheLevel::access(size_t block_id) {
-    time_counter++;
+    if (ways == 0 || ways >= cap) {
+        if (!HAS_MAP)
+            throw std::runtime_error("This cache level needs a set-associative layout");
+        return;
+    }
 
-    auto it = blocks.find(block_id);
-    if (it == blocks.end()) {
-        return false;
+    if (!HAS_SETS)
+        throw std::runtime_error("This cache level needs a fully associative layout");
+
+    if (cap % ways != 0)
+        throw std::runtime_error("Cache capacity must be a multiple of the associativity");
+
+    this->ways = ways;
+    sets = cap / ways;
+
+    if (sets & (sets - 1))
+        throw std::runtime_error("Cache set count must be a power of two");
+
+    set_mask = sets - 1;
+
+    if constexpr (HAS_SETS) {
+        tags.assign(cap, INVALID_TAG);
+        lines.resize(cap);
+    }
+
+    if constexpr (HAS_SET_POLICIES) {
+        if (!ranks_ways()) {
+            set_policies.reserve(sets);
+            for (size_t i = 0; i < sets; i++)
+                set_policies.emplace_back(pol, ways);
+        }
     }
+}
+
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::set_associative() const {
+    return ONLY_SETS || (HAS_SETS && sets > 1);
+}
+
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::ranks_ways() const {
+    if constexpr (Traits::DYNAMIC)
+        return policy.ranks_ways();
+    else
+        return Policy::ranks_ways();
+}
+
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::ages() const {
+    if constexpr (Traits::DYNAMIC)
+        return policy.ages();
+    else
+        return Policy::ages();
+}
+
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::set_of(size_t block_id) const {
+    return block_id & set_mask;
+}
+
+template <class Policy, Associativity Layout>
+uint64_t BasicCacheLevel<Policy, Layout>::tag_of(size_t block_id) const {
+    return block_id / sets;
+}
+
+// Compares the tag against every way of the set; returns ways on a miss.
+// Tags of one set are contiguous, so on x86 two ways are checked per SSE2
+// compare (64-bit equality built from two 32-bit lane compares).
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::find_way(size_t set, uint64_t tag) const {
+    if constexpr (HAS_SETS) {
+        const uint64_t* way_tags = tags.data() + set * ways;
+        size_t w = 0;
+
+#if defined(__SSE2__)
+        const __m128i needle = _mm_set1_epi64x((long long)tag);
+        for (; w + 2 <= ways; w += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(way_tags + w));
+            __m128i eq = _mm_cmpeq_epi32(v, needle);
+            eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
 
-    CacheBlock& blk = it->second;
-    blk.last_used = time_counter;
-    blk.freq++;
+            int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+            if (mask)
+                return w + (mask & 1 ? 0 : 1);
+        }
+#endif
 
-    if (policy == CachePolicy::LRU) {
-        order.remove(block_id);
-        order.push_back(block_id);
+        for (; w < ways; w++) {
+            if (way_tags[w] == tag)
+                return w;
+        }
     }
+    return ways;
+}
 
-    return true;
+// Picks the way to replace in a full set using the policy's ranking (FIFO:
+// oldest fill, LRU: oldest use, LFU: lowest freq, then oldest use), or asks
+// the set's own policy when it cannot rank ways. An empty way is always
+// preferred.
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::victim_way(size_t set, size_t incoming) {
+    size_t victim = 0;
+
+    if constexpr (HAS_SETS) {
+        const uint64_t* way_tags = tags.data() + set * ways;
+        const Line* way_lines = lines.data() + set * ways;
+
+        for (size_t w = 0; w < ways; w++) {
+            if (way_tags[w] == INVALID_TAG)
+                return w;
+        }
+
+        if constexpr (HAS_SET_POLICIES) {
+            if (!ranks_ways())
+                return find_way(set, tag_of(set_policies[set].evict(incoming)));
+        }
+
+        if constexpr (Traits::MAY_RANK_WAYS) {
+            for (size_t w = 1; w < ways; w++) {
+                if (policy.evict_before(way_lines[w], way_lines[victim]))
+                    victim = w;
+            }
+        }
+    }
+    (void)incoming;
+    return victim;
 }
 
-void CacheLevel::insert(size_t block_id) {
+template <class Policy, Associativity Layout>
+void BasicCacheLevel<Policy, Layout>::tick() {
     time_counter++;
 
-    if (blocks.count(block_id)) {
-        blocks[block_id].last_used = time_counter;
-        blocks[block_id].freq++;
-        return;
+    if constexpr (Traits::MAY_AGE) {
+        if (ages() && time_counter % decay_interval == 0)
+            decay();
     }
+}
 
-    if (blocks.size() >= capacity) {
-        size_t victim;
+// Records a use of a resident block and lets the policy relink it.
+template <class Policy, Associativity Layout>
+void BasicCacheLevel<Policy, Layout>::touch(Block& blk) {
+    policy.on_hit(blk);
+    blk.use(time_counter);
+}
 
-        if (policy == CachePolicy::FIFO || policy == CachePolicy::LRU) {
-            victim = order.front();
-            order.pop_front();
-        } else {
-            victim = std::min_element(
-                blocks.begin(), blocks.end(),
-                [](const auto& a, const auto& b) {
-                    if (a.second.freq == b.second.freq)
-                        return a.second.last_used < b.second.last_used;
-                    return a.second.freq < b.second.freq;
+// Same for a way of a set-associative level; ranking policies only need
+// the updated stamps.
+template <class Policy, Associativity Layout>
+void BasicCacheLevel<Policy, Layout>::touch_way(size_t set, Line& line) {
+    if constexpr (HAS_SET_POLICIES) {
+        if (!ranks_ways())
+            set_policies[set].on_hit(line);
+    }
+    (void)set;
+    line.use(time_counter);
+}
+
+// Halves every frequency (keeping at least 1) so blocks that were hot long
+// ago stop pinning the level. Only aging policies get here.
+template <class Policy, Associativity Layout>
+void BasicCacheLevel<Policy, Layout>::decay() {
+    if constexpr (Traits::MAY_AGE) {
+        if constexpr (HAS_SETS) {
+            if (ONLY_SETS || sets > 1) {
+                for (size_t i = 0; i < lines.size(); i++) {
+                    if (tags[i] != INVALID_TAG)
+                        lines[i].freq = std::max<size_t>(lines[i].freq / 2, 1);
                 }
-            )->first;
+                return;
+            }
+        }
+
+        if constexpr (HAS_MAP)
+            policy.decay(blocks);
+    }
+}
 
-            order.remove(victim);
+template <class Policy, Associativity Layout>
+typename BasicCacheLevel<Policy, Layout>::Resident*
+BasicCacheLevel<Policy, Layout>::find(size_t block_id) {
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            size_t set = set_of(block_id);
+            size_t way = find_way(set, tag_of(block_id));
+            return way == ways ? nullptr : &lines[set * ways + way];
         }
+    }
 
-        blocks.erase(victim);
+    if constexpr (HAS_MAP) {
+        auto it = blocks.find(block_id);
+        return it == blocks.end() ? nullptr : &it->second;
     }
+}
 
-    CacheBlock blk;
-    blk.block_id = block_id;
-    blk.freq = 1;
-    blk.last_used = time_counter;
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::access(size_t block_id, bool write) {
+    tick();
 
-    blocks[block_id] = blk;
-    order.push_back(block_id);
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            size_t set = set_of(block_id);
+            size_t way = find_way(set, tag_of(block_id));
+            if (way == ways)
+                return false;
+
+            Line& line = lines[set * ways + way];
+            touch_way(set, line);
+            line.dirty |= write;
+            return true;
+        }
+    }
+
+    if constexpr (HAS_MAP) {
+        auto it = blocks.find(block_id);
+        if (it == blocks.end()) {
+            return false;
+        }
+
+        touch(it->second);
+        it->second.dirty |= write;
+        return true;
+    }
 }
 
-void CacheLevel::dump(const std::string& name) const {
+template <class Policy, Associativity Layout>
+CacheEviction BasicCacheLevel<Policy, Layout>::insert(size_t block_id, bool dirty, bool prefetched) {
+    tick();
+    CacheEviction evicted{false, 0, false, false};
+
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            size_t set = set_of(block_id);
+            uint64_t tag = tag_of(block_id);
+            size_t way = find_way(set, tag);
+
+            if (way != ways) {
+                Line& line = lines[set * ways + way];
+                touch_way(set, line);
+                line.dirty |= dirty;
+                return evicted;
+            }
+
+            way = victim_way(set, block_id);
+            size_t slot = set * ways + way;
+            if (tags[slot] == INVALID_TAG)
+                valid_lines++;
+            else
+                evicted = {true, lines[slot].block_id, lines[slot].dirty, lines[slot].prefetched};
+
+            tags[slot] = tag;
+            Line& line = lines[slot];
+            line.block_id = block_id;
+            line.fill(time_counter);
+            line.dirty = dirty;
+            line.prefetched = prefetched;
+
+            if constexpr (HAS_SET_POLICIES) {
+                if (!ranks_ways())
+                    set_policies[set].on_insert(line);
+            }
+            return evicted;
+        }
+    }
+
+    if constexpr (HAS_MAP) {
+        auto it = blocks.find(block_id);
+        if (it != blocks.end()) {
+            touch(it->second);
+            it->second.dirty |= dirty;
+            return evicted;
+        }
+
+        // A full level hands the victim's node to the incoming block, so
+        // steady-state misses allocate nothing.
+        typename BlockMap::node_type node;
+        if (blocks.size() >= capacity) {
+            node = blocks.extract(policy.evict(block_id));
+            evicted = {true, node.key(), node.mapped().dirty, node.mapped().prefetched};
+            node.key() = block_id;
+        }
+
+        Block blk;
+        blk.block_id = block_id;
+        blk.fill(time_counter);
+        blk.dirty = dirty;
+        blk.prefetched = prefetched;
+
+        policy.on_insert(blk);
+        if (node) {
+            node.mapped() = blk;
+            blocks.insert(std::move(node));
+        } else {
+            blocks.emplace(block_id, blk);
+        }
+        return evicted;
+    }
+}
+
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::contains(size_t block_id) const {
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1)
+            return find_way(set_of(block_id), tag_of(block_id)) != ways;
+    }
+
+    if constexpr (HAS_MAP)
+        return blocks.count(block_id) != 0;
+}
+
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::set_dirty(size_t block_id) {
+    Resident* blk = find(block_id);
+    if (!blk)
+        return false;
+
+    blk->dirty = true;
+    return true;
+}
+
+template <class Policy, Associativity Layout>
+bool BasicCacheLevel<Policy, Layout>::consume_prefetch(size_t block_id) {
+    Resident* blk = find(block_id);
+    if (!blk || !blk->prefetched)
+        return false;
+
+    blk->prefetched = false;
+    return true;
+}
+
+template <class Policy, Associativity Layout>
+CacheEviction BasicCacheLevel<Policy, Layout>::invalidate(size_t block_id) {
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            size_t set = set_of(block_id);
+            size_t way = find_way(set, tag_of(block_id));
+            if (way == ways)
+                return {false, block_id, false, false};
+
+            size_t slot = set * ways + way;
+            if constexpr (HAS_SET_POLICIES) {
+                if (!ranks_ways())
+                    set_policies[set].on_remove(lines[slot]);
+            }
+
+            tags[slot] = INVALID_TAG;
+            valid_lines--;
+            return {true, block_id, lines[slot].dirty, lines[slot].prefetched};
+        }
+    }
+
+    if constexpr (HAS_MAP) {
+        auto it = blocks.find(block_id);
+        if (it == blocks.end())
+            return {false, block_id, false, false};
+
+        CacheEviction removed{true, block_id, it->second.dirty, it->second.prefetched};
+        policy.on_remove(it->second);
+        blocks.erase(it);
+        return removed;
+    }
+}
+
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::get_size() const {
+    if constexpr (HAS_MAP) {
+        if (!set_associative())
+            return blocks.size();
+    }
+    return valid_lines;
+}
+
+template <class Policy, Associativity Layout>
+std::vector<size_t> BasicCacheLevel<Policy, Layout>::resident_blocks() const {
+    std::vector<size_t> ids;
+    ids.reserve(get_size());
+
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            for (size_t i = 0; i < lines.size(); i++) {
+                if (tags[i] != INVALID_TAG)
+                    ids.push_back(lines[i].block_id);
+            }
+            return ids;
+        }
+    }
+
+    if constexpr (HAS_MAP) {
+        for (const auto& entry : blocks)
+            ids.push_back(entry.first);
+    }
+    return ids;
+}
+
+template <class Policy, Associativity Layout>
+void BasicCacheLevel<Policy, Layout>::dump(const std::string& name) const {
     std::cout << name << " Cache:\n";
 
-    if (blocks.empty()) {
+    if (get_size() == 0) {
         std::cout << "  [empty]\n";
         return;
     }
 
-    for (const auto& id : order) {
-        const auto& blk = blocks.at(id);
-        std::cout << "  block=" << blk.block_id
-                  << " freq=" << blk.freq
-                  << " last_used=" << blk.last_used
+    // Printed from the snapshot record, which has every stamp whatever the
+    // block layout keeps.
+    auto print = [](const auto& blk) {
+        SavedBlock s = blk.save(0);
+        std::cout << "  block=" << s.block_id
+                  << " freq=" << s.freq
+                  << " last_used=" << s.last_used
+                  << (s.dirty ? " dirty" : "")
                   << "\n";
+    };
+
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            for (size_t set = 0; set < sets; set++) {
+                for (size_t w = 0; w < ways; w++) {
+                    size_t slot = set * ways + w;
+                    if (tags[slot] == INVALID_TAG)
+                        continue;
+                    std::cout << "  set=" << set << " way=" << w;
+                    print(lines[slot]);
+                }
+            }
+            return;
+        }
+    }
+
+    if constexpr (HAS_MAP) {
+        for (size_t id : policy.eviction_order())
+            print(blocks.at(id));
     }
 }
 
-size_t CacheLevel::get_hit_time() const {
+template <class Policy, Associativity Layout>
+std::vector<SavedBlock> BasicCacheLevel<Policy, Layout>::save_blocks() const {
+    if (!ranks_ways())
+        throw std::runtime_error("Snapshots support only FIFO, LRU and LFU levels");
+
+    std::vector<SavedBlock> out;
+    out.reserve(get_size());
+
+    if constexpr (HAS_SETS) {
+        if (ONLY_SETS || sets > 1) {
+            for (size_t i = 0; i < lines.size(); i++) {
+                if (tags[i] != INVALID_TAG)
+                    out.push_back(lines[i].save(i));
+            }
+            return out;
+        }
+    }
+
+    if constexpr (HAS_MAP) {
+        for (size_t id : policy.eviction_order())
+            out.push_back(blocks.at(id).save(0));
+    }
+    return out;
+}
+
+template <class Policy, Associativity Layout>
+void BasicCacheLevel<Policy, Layout>::restore_blocks(const SavedBlock* saved, size_t count, size_t time) {
+    if (!ranks_ways())
+        throw std::runtime_error("Snapshots support only FIFO, LRU and LFU levels");
+    if (get_size() != 0)
+        throw std::runtime_error("Only an empty cache level can be restored");
+    if (count > capacity)
+        throw std::runtime_error("Snapshot holds more blocks than the level");
+
+    for (size_t i = 0; i < count; i++) {
+        const SavedBlock& s = saved[i];
+
+        if constexpr (HAS_SETS) {
+            if (ONLY_SETS || sets > 1) {
+                if (s.slot >= lines.size() || s.slot / ways != set_of(s.block_id) ||
+                    tags[s.slot] != INVALID_TAG)
+                    throw std::runtime_error("Snapshot block does not fit the level's sets");
+                tags[s.slot] = tag_of(s.block_id);
+                valid_lines++;
+                lines[s.slot].load(s);
+                continue;
+            }
+        }
+
+        if constexpr (HAS_MAP) {
+            auto [it, added] = blocks.try_emplace(s.block_id);
+            if (!added)
+                throw std::runtime_error("Snapshot holds a block twice");
+            it->second.load(s);
+            policy.on_restore(it->second);
+        }
+    }
+
+    time_counter = time;
+}
+
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::get_time() const {
+    return time_counter;
+}
+
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::get_hit_time() const {
     return hit_time;
 }
+
+template <class Policy, Associativity Layout>
+CachePolicy BasicCacheLevel<Policy, Layout>::get_policy() const {
+    return policy.kind();
+}
+
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::get_sets() const {
+    return sets;
+}
+
+template <class Policy, Associativity Layout>
+size_t BasicCacheLevel<Policy, Layout>::get_ways() const {
+    return ways;
+}
+
+template class BasicCacheLevel<DynamicPolicy, Associativity::ANY>;
+template class BasicCacheLevel<FifoPolicy, Associativity::FULL>;
+template class BasicCacheLevel<FifoPolicy, Associativity::SET>;
+template class BasicCacheLevel<LruPolicy, Associativity::FULL>;
+template class BasicCacheLevel<LruPolicy, Associativity::SET>;
+template class BasicCacheLevel<LfuPolicy, Associativity::FULL>;
+template class BasicCacheLevel<LfuPolicy, Associativity::SET>;
+template class BasicCacheLevel<LfuAgingPolicy, Associativity::FULL>;
+template class BasicCacheLevel<LfuAgingPolicy, Associativity::SET>;
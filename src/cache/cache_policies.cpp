@@ -0,0 +1,80 @@
+#include "cache/cache_policies.hpp"
+#include <algorithm>
+
+#include "cache/arc_policy.hpp"
+#include "cache/two_q_policy.hpp"
+#include "cache/clock_policy.hpp"
+#include "cache/s3fifo_policy.hpp"
+
+// Halves every frequency (keeping at least 1). Neighbouring buckets
+// collapse into one; both are already sorted by last_used, so a merge keeps
+// that order and leaves every block's iterator valid. Blocks of a merged
+// bucket that keep their bucket (LfuBlock) are pointed at the survivor.
+template <class B>
+void LfuPolicy::decay(std::unordered_map<size_t, B>& blocks) {
+    std::list<Bucket> decayed;
+    by_freq.clear();
+
+    while (!buckets.empty()) {
+        size_t freq = std::max<size_t>(buckets.front().freq / 2, 1);
+
+        // Halving keeps the order, so only the newest bucket can collide.
+        bool merge = !decayed.empty() && decayed.back().freq == freq;
+        for (size_t id : buckets.front().blocks) {
+            B& blk = blocks[id];
+            blk.freq = freq;
+            if constexpr (std::is_same_v<B, LfuBlock>) {
+                if (merge)
+                    blk.bucket = std::prev(decayed.end());
+            }
+        }
+
+        if (merge) {
+            decayed.back().blocks.merge(buckets.front().blocks, [&blocks](size_t a, size_t b) {
+                return blocks[a].last_used < blocks[b].last_used;
+            });
+            buckets.pop_front();
+        } else {
+            decayed.splice(decayed.end(), buckets, buckets.begin());
+            decayed.back().freq = freq;
+            by_freq[freq] = std::prev(decayed.end());
+        }
+    }
+
+    buckets.swap(decayed);
+}
+
+template void LfuPolicy::decay(std::unordered_map<size_t, CacheBlock>&);
+template void LfuPolicy::decay(std::unordered_map<size_t, LfuBlock>&);
+
+std::vector<size_t> LfuPolicy::eviction_order() const {
+    std::vector<size_t> ids;
+    for (const Bucket& bucket : buckets)
+        ids.insert(ids.end(), bucket.blocks.begin(), bucket.blocks.end());
+    return ids;
+}
+
+std::unique_ptr<ReplacementPolicy> make_policy(CachePolicy pol, size_t capacity) {
+    switch (pol) {
+        case CachePolicy::FIFO:
+            return std::make_unique<PolicyAdapter<FifoPolicy>>(pol, capacity);
+        case CachePolicy::LRU:
+            return std::make_unique<PolicyAdapter<LruPolicy>>(pol, capacity);
+        case CachePolicy::LFU:
+            return std::make_unique<PolicyAdapter<LfuPolicy>>(pol, capacity);
+        case CachePolicy::LFU_AGING:
+            return std::make_unique<PolicyAdapter<LfuAgingPolicy>>(pol, capacity);
+        case CachePolicy::ARC:
+            return std::make_unique<ArcPolicy>(capacity);
+        case CachePolicy::TWO_Q:
+            return std::make_unique<TwoQPolicy>(capacity);
+        case CachePolicy::CLOCK:
+            return std::make_unique<ClockPolicy>(capacity);
+        case CachePolicy::S3_FIFO:
+            return std::make_unique<S3FifoPolicy>(capacity);
+    }
+    return std::make_unique<PolicyAdapter<LruPolicy>>(CachePolicy::LRU, capacity);
+}
+
+DynamicPolicy::DynamicPolicy(CachePolicy pol, size_t capacity)
+    : impl(make_policy(pol, capacity)) {}
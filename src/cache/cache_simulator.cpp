@@ -1,197 +1,990 @@
 #include "cache/cache_simulator.hpp"
+#include <algorithm>
 #include <iostream>
-#include <sstream>
-
-CacheSimulator::CacheSimulator(CachePolicy policy)
-    : l1(4, 1, policy),
-      l2(8, 5, policy),
-      l3(16, 20, policy),
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "cache/belady.hpp"
+
+template <class Level>
+BasicCacheSimulator<Level>::BasicCacheSimulator(CachePolicy policy)
+    : BasicCacheSimulator(CacheConfig::defaults(policy)) {}
+
+template <class Level>
+BasicCacheSimulator<Level>::BasicCacheSimulator(const CacheConfig& cfg)
+    : config(cfg),
       logs_enabled(false),
-      filelog_enabled(false),
       total_accesses(0),
-      l1_hits(0), l1_misses(0),
-      l2_hits(0), l2_misses(0),
-      l3_hits(0), l3_misses(0),
+      hits(cfg.levels.size(), 0),
+      misses(cfg.levels.size(), 0),
       memory_accesses(0),
-      total_cycles(0) {}
+      opt_memory_accesses(0),
+      miss_kinds(cfg.levels.size()),
+      writes(0),
+      writebacks(cfg.levels.size(), 0),
+      write_throughs(cfg.levels.size(), 0),
+      memory_writes(0),
+      write_cycles(0),
+      back_invalidations(cfg.levels.size(), 0),
+      demotions(cfg.levels.size(), 0),
+      total_cycles(0),
+      sample_one_in(1),
+      sample_unit(1),
+      skipped_accesses(0) {
+
+    config.validate();
+
+    levels.reserve(config.levels.size());
+    for (auto& level : config.levels) {
+        levels.emplace_back(level.capacity, level.hit_time, level.policy, level.ways);
+        level.policy = levels.back().get_policy();
+        level_names.push_back(level.name);
+        if (config.classify_misses)
+            classifiers.emplace_back(level.capacity);
+
+        prefetchers.push_back(make_prefetcher(level.prefetch, level.prefetch_degree));
+        prefetch_stats.emplace_back();
+        pollution.emplace_back(level.capacity);
+    }
+
+    if (config.sample_one_in > 1)
+        enable_sampling(config.sample_one_in);
+
+    if (config.timing == TimingModel::NON_BLOCKING) {
+        std::vector<size_t> line_sizes, mshrs;
+        for (const auto& level : config.levels) {
+            line_sizes.push_back(level.line_size);
+            mshrs.push_back(level.mshrs);
+        }
+        timer = std::make_unique<NonBlockingTimer>(line_sizes, mshrs, config.issue_width);
+    }
+
+    if (config.dram.enabled)
+        dram = std::make_unique<DramController>(config.dram, config.levels.back().line_size);
+
+    if (config.vm.enabled) {
+        vm = std::make_unique<VirtualMemory>(
+            config.vm,
+            [this](uint64_t address) { return read_page_table(address); },
+            [this](uint64_t base, size_t bytes) { drop_frame(base, bytes); });
+    }
+}
+
+template <class Level>
+BasicCacheSimulator<Level>::~BasicCacheSimulator() = default;
 
-CacheSimulator::~CacheSimulator() {
-    if (logfile.is_open())
-        logfile.close();
+template <class Level>
+void BasicCacheSimulator<Level>::enable_logs() { logs_enabled = true; }
+
+template <class Level>
+void BasicCacheSimulator<Level>::disable_logs() { logs_enabled = false; }
+
+template <class Level>
+void BasicCacheSimulator<Level>::enable_filelog() {
+    if (!event_log)
+        event_log = std::make_unique<EventLog>(EVENT_LOG_PATH, level_names);
 }
 
-void CacheSimulator::enable_logs() { logs_enabled = true; }
-void CacheSimulator::disable_logs() { logs_enabled = false; }
+template <class Level>
+void BasicCacheSimulator<Level>::disable_filelog() {
+    std::unique_ptr<EventLog> log = std::move(event_log);
+    if (log)
+        log->close();
+}
+
+template <class Level>
+void BasicCacheSimulator<Level>::log(const CacheEvent& event) {
+    if (logs_enabled) write_event_text(std::cout, level_names, event);
+    if (!event_log)
+        return;
 
-void CacheSimulator::enable_filelog() {
-    if (!filelog_enabled) {
-        logfile.open("cache_log.txt");
-        filelog_enabled = true;
+    try {
+        event_log->record(event);
+    } catch (const std::exception&) {
+        event_log.reset();
+        throw;
     }
 }
 
-void CacheSimulator::disable_filelog() {
-    if (filelog_enabled) {
-        logfile.close();
-        filelog_enabled = false;
+template <class Level>
+void BasicCacheSimulator<Level>::enable_sampling(size_t one_in) {
+    if (total_accesses > 0 || skipped_accesses > 0)
+        throw std::runtime_error("Sampling must be enabled before the first access");
+    for (const auto& prefetcher : prefetchers) {
+        if (prefetcher)
+            throw std::runtime_error("Sampled simulation does not support prefetchers");
     }
+    if (vm)
+        throw std::runtime_error("Sampled simulation does not support virtual memory");
+    if (timer)
+        throw std::runtime_error("Sampled simulation does not support non-blocking timing");
+
+    CacheConfig scaled = scale_for_sampling(config, one_in);
+    levels.clear();
+    classifiers.clear();
+    for (const auto& level : scaled.levels) {
+        levels.emplace_back(level.capacity, level.hit_time, level.policy, level.ways);
+        if (config.classify_misses)
+            classifiers.emplace_back(level.capacity);
+    }
+
+    config.sample_one_in = sample_one_in = one_in;
+    sample_unit = 1;
+    for (const auto& level : config.levels)
+        sample_unit = std::max(sample_unit, level.line_size);
+
+    SampleGroup empty;
+    empty.hits.assign(levels.size(), 0);
+    sample_groups.assign(one_in > 1 ? SAMPLE_GROUPS : 0, empty);
 }
 
-void CacheSimulator::log(const std::string& msg) {
-    if (logs_enabled) std::cout << msg << "\n";
-    if (filelog_enabled && logfile.is_open()) logfile << msg << "\n";
+template <class Level>
+void BasicCacheSimulator<Level>::enable_profiling(size_t counters) {
+    profiler = std::make_unique<CacheProfiler>(config, counters);
 }
 
-size_t CacheSimulator::address_to_block(size_t address) const {
-    return address / BLOCK_SIZE;
+template <class Level>
+void BasicCacheSimulator<Level>::disable_profiling() {
+    profiler.reset();
 }
 
-void CacheSimulator::access(size_t address) {
-    total_accesses++;
-    size_t block = address_to_block(address);
-    size_t access_cycles = 0;
+template <class Level>
+const CacheProfiler* BasicCacheSimulator<Level>::get_profiler() const {
+    return profiler.get();
+}
 
-    std::ostringstream oss;
-    oss << "ACCESS " << address << " (block " << block << "):";
-    log(oss.str());
+template <class Level>
+size_t BasicCacheSimulator<Level>::address_to_block(size_t address, size_t level) const {
+    return address / config.levels[level].line_size;
+}
 
-    if (l1.access(block)) {
-        l1_hits++;
-        access_cycles = l1.get_hit_time();
-        total_cycles += access_cycles;
-        log("  L1 HIT");
-        log("  Access time: " + std::to_string(access_cycles) + " cycles");
-        return;
+// Delivers a write-back or write-through to the first level at or below
+// `level` that holds the line, or to memory.
+template <class Level>
+void BasicCacheSimulator<Level>::write_below(size_t level, size_t address, size_t& cycles) {
+    for (size_t i = level; i < levels.size(); i++) {
+        cycles += levels[i].get_hit_time();
+        write_cycles += levels[i].get_hit_time();
+
+        if (!levels[i].contains(address_to_block(address, i)))
+            continue;
+
+        if (config.levels[i].write_policy == WritePolicy::WRITE_BACK) {
+            levels[i].set_dirty(address_to_block(address, i));
+            return;
+        }
+        write_throughs[i]++;
+    }
+
+    memory_writes++;
+    size_t latency = memory_latency(address, true, cycles);
+    cycles += latency;
+    write_cycles += latency;
+}
+
+// Cycles memory takes to serve a line. `cycles` is how far into the
+// current access the request is made, placing it on the DRAM's clock: the
+// serial cycle count, or the issue cycle with non-blocking timing.
+template <class Level>
+size_t BasicCacheSimulator<Level>::memory_latency(size_t address, bool write, size_t cycles) {
+    if (!dram)
+        return config.memory_penalty;
+    uint64_t now = (timer ? timer->get_issue_cycle() : total_cycles) + cycles;
+    return dram->access(address, write, now);
+}
+
+// Removes every copy of the line at `address` (as sized by `level`) from
+// the levels above it; returns true if any of them was dirty.
+template <class Level>
+bool BasicCacheSimulator<Level>::back_invalidate(size_t level, size_t address) {
+    size_t line = config.levels[level].line_size;
+    bool dirty = false;
+
+    for (size_t i = 0; i < level; i++) {
+        size_t step = config.levels[i].line_size;
+        for (size_t a = address - address % step; a < address + line; a += step) {
+            CacheEviction removed = levels[i].invalidate(address_to_block(a, i));
+            if (removed.valid) {
+                back_invalidations[level]++;
+                dirty |= removed.dirty;
+            }
+        }
     }
-    l1_misses++;
-    log("  L1 MISS");
-
-    if (l2.access(block)) {
-        l2_hits++;
-        access_cycles = l1.get_hit_time() + l2.get_hit_time();
-        total_cycles += access_cycles;
-        log("  L2 HIT");
-        l1.insert(block);
-        log("  Loaded into L1");
-        log("  Access time: " + std::to_string(access_cycles) + " cycles");
+    return dirty;
+}
+
+// Inserts the line into `level` and disposes of the victim according to
+// the inclusion policy: exclusive hierarchies demote it to the next level
+// (and so on down), the others write it back if dirty.
+template <class Level>
+void BasicCacheSimulator<Level>::fill(size_t level, size_t address, bool dirty, size_t& cycles,
+                                      bool prefetched) {
+    for (size_t i = level; i < levels.size(); i++) {
+        CacheEviction victim = levels[i].insert(address_to_block(address, i), dirty, prefetched);
+        if (!victim.valid)
+            return;
+
+        if (victim.prefetched)
+            prefetch_stats[i].unused++;
+        else if (prefetched)
+            pollution[i].record(victim.block_id);
+        prefetched = false;
+
+        size_t victim_address = victim.block_id * config.levels[i].line_size;
+
+        if (config.inclusion == InclusionPolicy::INCLUSIVE)
+            victim.dirty |= back_invalidate(i, victim_address);
+
+        if (config.inclusion == InclusionPolicy::EXCLUSIVE && i + 1 < levels.size()) {
+            demotions[i]++;
+            address = victim_address;
+            dirty = victim.dirty;
+            continue;
+        }
+
+        if (victim.dirty) {
+            writebacks[i]++;
+            write_below(i + 1, victim_address, cycles);
+        }
         return;
     }
-    l2_misses++;
-    log("  L2 MISS");
-
-    if (l3.access(block)) {
-        l3_hits++;
-        access_cycles =
-            l1.get_hit_time() + l2.get_hit_time() + l3.get_hit_time();
-        total_cycles += access_cycles;
-        log("  L3 HIT");
-        l2.insert(block);
-        l1.insert(block);
-        log("  Loaded into L2");
-        log("  Loaded into L1");
-        log("  Access time: " + std::to_string(access_cycles) + " cycles");
+}
+
+// Brings a block into `level` on behalf of its prefetcher, keeping the
+// inclusion policy: inclusive hierarchies fill the levels below first,
+// exclusive ones move the line up from wherever it is.
+template <class Level>
+void BasicCacheSimulator<Level>::prefetch(size_t level, size_t block, size_t& cycles) {
+    if (levels[level].contains(block))
         return;
+
+    size_t address = block * config.levels[level].line_size;
+    bool dirty = false;
+
+    if (config.inclusion == InclusionPolicy::INCLUSIVE) {
+        for (size_t i = levels.size(); i-- > level + 1;) {
+            if (!levels[i].contains(address_to_block(address, i)))
+                fill(i, address, false, cycles);
+        }
+    } else if (config.inclusion == InclusionPolicy::EXCLUSIVE) {
+        for (size_t i = level + 1; i < levels.size(); i++) {
+            CacheEviction moved = levels[i].invalidate(address_to_block(address, i));
+            if (moved.valid) {
+                dirty = moved.dirty;
+                break;
+            }
+        }
+    }
+
+    fill(level, address, dirty, cycles, true);
+    prefetch_stats[level].issued++;
+}
+
+// A page-table entry read on behalf of the page walker: looked up and
+// filled like a demand read, but kept out of the access counters.
+template <class Level>
+size_t BasicCacheSimulator<Level>::read_page_table(size_t address) {
+    size_t cycles = 0;
+    size_t hit_level = levels.size();
+    for (size_t i = 0; i < levels.size(); i++) {
+        cycles += levels[i].get_hit_time();
+        if (levels[i].access(address_to_block(address, i))) {
+            hit_level = i;
+            break;
+        }
+    }
+    if (hit_level == levels.size())
+        cycles += memory_latency(address, false, cycles);
+
+    if (config.inclusion == InclusionPolicy::EXCLUSIVE) {
+        if (hit_level > 0) {
+            bool dirty = false;
+            if (hit_level < levels.size())
+                dirty = levels[hit_level].invalidate(address_to_block(address, hit_level)).dirty;
+            fill(0, address, dirty, cycles);
+        }
+    } else {
+        for (size_t i = hit_level; i-- > 0;)
+            fill(i, address, false, cycles);
+    }
+    return cycles;
+}
+
+// Drops every cached line of a reclaimed frame, so the page mapped there
+// next cannot hit on the old contents. Walks whichever is smaller: the
+// frame's lines or the level's resident blocks.
+template <class Level>
+void BasicCacheSimulator<Level>::drop_frame(size_t base, size_t bytes) {
+    for (size_t i = 0; i < levels.size(); i++) {
+        size_t first = address_to_block(base, i);
+        size_t count = bytes / config.levels[i].line_size;
+
+        if (count <= levels[i].get_size()) {
+            for (size_t b = first; b < first + count; b++)
+                levels[i].invalidate(b);
+        } else {
+            for (size_t b : levels[i].resident_blocks()) {
+                if (b - first < count)
+                    levels[i].invalidate(b);
+            }
+        }
+    }
+}
+
+template <class Level>
+void BasicCacheSimulator<Level>::access(size_t address, AccessType type) {
+    size_t group = 0;
+    if (sample_one_in > 1) {
+        uint64_t h = sample_hash(address / sample_unit);
+        if (h & (sample_one_in - 1)) {
+            skipped_accesses++;
+            return;
+        }
+        group = (h >> 40) % SAMPLE_GROUPS;
+    }
+
+    total_accesses++;
+    size_t access_cycles = 0;
+
+    const bool write = type == AccessType::WRITE;
+    if (write)
+        writes++;
+
+    if (vm)
+        address = vm->translate(address, write, access_cycles);
+
+    // Walk down until a level hits; every level visited adds its hit time.
+    size_t hit_level = levels.size();
+    bool prefetch_hit = false;
+    for (size_t i = 0; i < levels.size(); i++) {
+        access_cycles += levels[i].get_hit_time();
+        size_t block = address_to_block(address, i);
+        ShadowResult shadow = classifiers.empty() ? ShadowResult::HIT
+                                                  : classifiers[i].reference(block);
+
+        if (levels[i].access(block)) {
+            hits[i]++;
+            hit_level = i;
+            if (prefetchers[i] && levels[i].consume_prefetch(block)) {
+                prefetch_stats[i].useful++;
+                prefetch_hit = true;
+            }
+            break;
+        }
+
+        misses[i]++;
+        if (!classifiers.empty()) {
+            if (shadow == ShadowResult::FIRST_TOUCH)
+                miss_kinds[i].compulsory++;
+            else if (shadow == ShadowResult::MISS)
+                miss_kinds[i].capacity++;
+            else
+                miss_kinds[i].conflict++;
+        }
+
+        if (prefetchers[i] && pollution[i].demand_miss(block))
+            prefetch_stats[i].pollution++;
+    }
+
+    if (hit_level == levels.size()) {
+        memory_accesses++;
+        access_cycles += memory_latency(address, false, access_cycles);
+    }
+
+    // Exclusive: the line moves from where it hit into L1 alone.
+    // Otherwise every level above the one that supplied it is filled,
+    // farthest first.
+    size_t top = hit_level;
+    uint32_t filled = 0;
+    if (config.inclusion == InclusionPolicy::EXCLUSIVE) {
+        if (hit_level > 0 && !(write && !config.levels[0].write_allocate)) {
+            bool dirty = false;
+            if (hit_level < levels.size())
+                dirty = levels[hit_level].invalidate(address_to_block(address, hit_level)).dirty;
+
+            fill(0, address, dirty, access_cycles);
+            top = 0;
+            filled = 1;
+        }
+    } else {
+        for (size_t i = hit_level; i-- > 0;) {
+            if (write && !config.levels[i].write_allocate)
+                continue;
+
+            fill(i, address, false, access_cycles);
+            top = i;
+            filled |= uint32_t(1) << i;
+        }
+    }
+
+    // The write lands in the highest level now holding the line. With no
+    // allocating level it went to memory as the access itself.
+    if (write) {
+        if (top == levels.size()) {
+            memory_writes++;
+        } else if (config.levels[top].write_policy == WritePolicy::WRITE_BACK) {
+            levels[top].set_dirty(address_to_block(address, top));
+        } else {
+            write_throughs[top]++;
+            write_below(top + 1, address, access_cycles);
+        }
+    }
+
+    for (size_t i = 0; i <= hit_level && i < levels.size(); i++) {
+        if (!prefetchers[i])
+            continue;
+
+        size_t block = address_to_block(address, i);
+        prefetch_candidates.clear();
+        prefetchers[i]->on_access(block, i < hit_level || prefetch_hit, prefetch_candidates);
+
+        for (size_t candidate : prefetch_candidates)
+            prefetch(i, candidate, access_cycles);
     }
-    l3_misses++;
-    log("  L3 MISS");
 
-    memory_accesses++;
-    access_cycles =
-        l1.get_hit_time() +
-        l2.get_hit_time() +
-        l3.get_hit_time() +
-        MEMORY_PENALTY;
+    if (profiler) {
+        for (size_t i = 0; i <= hit_level && i < levels.size(); i++)
+            profiler->on_access(i, address_to_block(address, i), i == hit_level);
+    }
 
     total_cycles += access_cycles;
+    if (timer)
+        timer->access(address, hit_level, access_cycles);
+
+    if (sample_one_in > 1) {
+        SampleGroup& g = sample_groups[group];
+        g.accesses++;
+        g.cycles += access_cycles;
+        if (hit_level < levels.size())
+            g.hits[hit_level]++;
+    }
+
+    // The event holds everything the text log prints, so nothing is
+    // formatted here unless stdout logging is on.
+    if (should_log()) {
+        log({address, address_to_block(address, 0),
+             static_cast<uint32_t>(hit_level), static_cast<uint32_t>(access_cycles),
+             filled, static_cast<uint8_t>(write), {}});
+    }
+}
+
+static std::string opt_temp_path(const std::string& tag) {
+    std::random_device rd;
+    std::string name = "memsim_opt_" + std::to_string(rd()) + "_" + tag;
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+template <class Level>
+void BasicCacheSimulator<Level>::run_opt(const std::string& trace_path) {
+    std::string input = trace_path;
+    std::vector<std::string> temps;
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const CacheLevelConfig& level = config.levels[i];
+        std::string miss_path = opt_temp_path(level.name);
+        temps.push_back(miss_path);
+
+        BeladyResult r = simulate_belady(
+            input, miss_path, level.capacity, level.line_size, level.ways);
 
-    log("  MAIN MEMORY ACCESS");
+        if (i == 0)
+            total_accesses += r.accesses;
+        hits[i] += r.hits;
+        misses[i] += r.misses;
+        total_cycles += r.accesses * level.hit_time;
 
-    l3.insert(block);
-    l2.insert(block);
-    l1.insert(block);
+        if (i + 1 == levels.size()) {
+            memory_accesses += r.misses;
+            opt_memory_accesses += r.misses;
+            total_cycles += r.misses * config.memory_penalty;
+        }
 
-    log("  Loaded into L3");
-    log("  Loaded into L2");
-    log("  Loaded into L1");
-    log("  Access time: " + std::to_string(access_cycles) + " cycles");
+        input = miss_path;
+    }
+
+    for (const auto& path : temps)
+        std::remove(path.c_str());
 }
 
-void CacheSimulator::dump() const {
-    l1.dump("L1");
-    l2.dump("L2");
-    l3.dump("L3");
+template <class Level>
+void BasicCacheSimulator<Level>::run_opt(const std::vector<size_t>& addresses) {
+    std::string path = opt_temp_path("trace");
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Cannot write OPT trace: " + path);
+
+        for (size_t address : addresses) {
+            uint64_t a = address;
+            out.write(reinterpret_cast<const char*>(&a), sizeof(a));
+        }
+    }
+
+    run_opt(path);
+    std::remove(path.c_str());
 }
 
-void CacheSimulator::stats() const {
-    std::cout << "Total accesses: " << total_accesses << "\n\n";
+// Snapshot records; the layout is part of the file format, so any change
+// needs a new SNAPSHOT_VERSION.
+struct SavedCacheCounters {
+    uint64_t level_count;
+    uint64_t total_accesses;
+    uint64_t memory_accesses;
+    uint64_t writes;
+    uint64_t memory_writes;
+    uint64_t write_cycles;
+    uint64_t total_cycles;
+};
+
+struct SavedCacheLevel {
+    uint64_t capacity;
+    uint64_t ways;
+    uint64_t line_size;
+    uint64_t policy;
+    uint64_t time;
+    uint64_t first_block;
+    uint64_t block_count;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writebacks;
+    uint64_t write_throughs;
+    uint64_t back_invalidations;
+    uint64_t demotions;
+};
+
+template <class Level>
+void BasicCacheSimulator<Level>::save(SnapshotWriter& out) const {
+    if (sample_one_in > 1)
+        throw std::runtime_error("Sampled simulations cannot be saved");
+    if (vm)
+        throw std::runtime_error("Simulations with virtual memory cannot be saved");
+
+    std::vector<SavedCacheLevel> saved_levels;
+    std::vector<SavedBlock> blocks;
+    for (size_t i = 0; i < levels.size(); i++) {
+        std::vector<SavedBlock> level_blocks = levels[i].save_blocks();
+        saved_levels.push_back({config.levels[i].capacity, levels[i].get_ways(),
+                                config.levels[i].line_size,
+                                static_cast<uint64_t>(levels[i].get_policy()),
+                                levels[i].get_time(), blocks.size(), level_blocks.size(),
+                                hits[i], misses[i], writebacks[i], write_throughs[i],
+                                back_invalidations[i], demotions[i]});
+        blocks.insert(blocks.end(), level_blocks.begin(), level_blocks.end());
+    }
 
-    std::cout << "L1 hits: " << l1_hits
-              << "  misses: " << l1_misses
-              << "  hit rate: "
-              << (total_accesses ? (double)l1_hits / total_accesses * 100 : 0)
-              << "%\n";
+    SavedCacheCounters counters{levels.size(), total_accesses, memory_accesses, writes,
+                                memory_writes, write_cycles, total_cycles};
+    out.add(SnapshotSection::CACHE_COUNTERS, std::vector<SavedCacheCounters>{counters});
+    out.add(SnapshotSection::CACHE_LEVELS, saved_levels);
+    out.add(SnapshotSection::CACHE_BLOCKS, blocks);
+}
 
-    std::cout << "L2 hits: " << l2_hits
-              << "  misses: " << l2_misses
-              << "  hit rate: "
-              << (total_accesses ? (double)l2_hits / total_accesses * 100 : 0)
-              << "%\n";
+template <class Level>
+void BasicCacheSimulator<Level>::restore(const SnapshotReader& in) {
+    if (total_accesses > 0 || skipped_accesses > 0)
+        throw std::runtime_error("Snapshots must be restored before the first access");
+    if (sample_one_in > 1)
+        throw std::runtime_error("Sampled simulations cannot be restored");
+    if (vm)
+        throw std::runtime_error("Simulations with virtual memory cannot be restored");
+
+    const auto& counters = in.record<SavedCacheCounters>(SnapshotSection::CACHE_COUNTERS);
+    size_t level_count, block_count;
+    const SavedCacheLevel* saved_levels =
+        in.records<SavedCacheLevel>(SnapshotSection::CACHE_LEVELS, level_count);
+    const SavedBlock* blocks = in.records<SavedBlock>(SnapshotSection::CACHE_BLOCKS, block_count);
+
+    if (counters.level_count != levels.size() || level_count != levels.size())
+        throw std::runtime_error("Snapshot has " + std::to_string(level_count) +
+                                 " cache levels, the simulator " +
+                                 std::to_string(levels.size()));
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const SavedCacheLevel& s = saved_levels[i];
+        if (s.capacity != config.levels[i].capacity || s.ways != levels[i].get_ways() ||
+            s.line_size != config.levels[i].line_size ||
+            s.policy != static_cast<uint64_t>(levels[i].get_policy()))
+            throw std::runtime_error("Snapshot level " + config.levels[i].name +
+                                     " does not match the configuration");
+        if (s.first_block > block_count || s.block_count > block_count - s.first_block)
+            SnapshotReader::throw_malformed();
+    }
 
-    std::cout << "L3 hits: " << l3_hits
-              << "  misses: " << l3_misses
-              << "  hit rate: "
-              << (total_accesses ? (double)l3_hits / total_accesses * 100 : 0)
-              << "%\n";
+    for (size_t i = 0; i < levels.size(); i++) {
+        const SavedCacheLevel& s = saved_levels[i];
+        levels[i].restore_blocks(blocks + s.first_block, s.block_count, s.time);
+        hits[i] = s.hits;
+        misses[i] = s.misses;
+        writebacks[i] = s.writebacks;
+        write_throughs[i] = s.write_throughs;
+        back_invalidations[i] = s.back_invalidations;
+        demotions[i] = s.demotions;
+    }
+
+    total_accesses = counters.total_accesses;
+    memory_accesses = counters.memory_accesses;
+    writes = counters.writes;
+    memory_writes = counters.memory_writes;
+    write_cycles = counters.write_cycles;
+    total_cycles = counters.total_cycles;
+}
+
+template <class Level>
+void BasicCacheSimulator<Level>::dump() const {
+    for (size_t i = 0; i < levels.size(); i++)
+        levels[i].dump(config.levels[i].name);
+}
+
+template <class Level>
+void BasicCacheSimulator<Level>::stats() const {
+    std::cout << "Total accesses: " << total_accesses << "\n\n";
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        std::cout << config.levels[i].name << " hits: " << hits[i]
+                  << "  misses: " << misses[i]
+                  << "  hit rate: " << get_hit_rate(i)
+                  << "%\n";
+    }
 
     std::cout << "Memory accesses: " << memory_accesses << "\n\n";
 
-    double overall_hit_rate =
-        total_accesses == 0 ? 0.0 :
-        (double)(l1_hits + l2_hits + l3_hits) /
-        total_accesses * 100.0;
+    if (vm)
+        vm->stats(std::cout);
+
+    if (!classifiers.empty()) {
+        std::cout << "Miss causes (3C):\n";
+        for (size_t i = 0; i < levels.size(); i++) {
+            std::cout << "  " << config.levels[i].name
+                      << " compulsory: " << miss_kinds[i].compulsory
+                      << "  capacity: " << miss_kinds[i].capacity
+                      << "  conflict: " << miss_kinds[i].conflict << "\n";
+        }
+        std::cout << "\n";
+    }
 
-    double avg_time =
-        total_accesses == 0 ? 0.0 :
-        (double)total_cycles / total_accesses;
+    bool any_prefetcher = false;
+    for (size_t i = 0; i < levels.size(); i++) {
+        if (!prefetchers[i])
+            continue;
+
+        const PrefetchCounters& p = prefetch_stats[i];
+        std::cout << config.levels[i].name << " prefetcher ("
+                  << prefetch_policy_name(config.levels[i].prefetch)
+                  << ", degree " << config.levels[i].prefetch_degree << "): "
+                  << "issued " << p.issued << "  useful " << p.useful
+                  << "  unused " << p.unused << "\n"
+                  << "  accuracy: " << get_prefetch_accuracy(i) << "%"
+                  << "  coverage: " << get_prefetch_coverage(i) << "%"
+                  << "  pollution: " << p.pollution << " misses\n";
+        any_prefetcher = true;
+    }
+    if (any_prefetcher)
+        std::cout << "\n";
+
+    std::cout << "Inclusion: " << inclusion_policy_name(config.inclusion)
+              << "  unique capacity: " << get_unique_capacity()
+              << " of " << get_total_capacity() << " bytes\n";
+    if (config.inclusion == InclusionPolicy::INCLUSIVE) {
+        for (size_t i = 1; i < levels.size(); i++)
+            std::cout << config.levels[i].name << " back-invalidations: "
+                      << back_invalidations[i] << "\n";
+    }
+    if (config.inclusion == InclusionPolicy::EXCLUSIVE) {
+        for (size_t i = 0; i + 1 < levels.size(); i++)
+            std::cout << config.levels[i].name << " -> " << config.levels[i + 1].name
+                      << " demotions: " << demotions[i] << "\n";
+    }
+    std::cout << "\n";
+
+    if (writes > 0) {
+        std::cout << "Writes: " << writes << "\n";
+        for (size_t i = 0; i < levels.size(); i++) {
+            std::cout << config.levels[i].name << " ("
+                      << write_policy_name(config.levels[i].write_policy)
+                      << (config.levels[i].write_allocate ? ", write-allocate" : ", no-write-allocate")
+                      << ") write-backs: " << writebacks[i]
+                      << "  write-throughs: " << write_throughs[i] << "\n";
+        }
+        std::cout << "Memory writes: " << memory_writes << "\n";
+        std::cout << "Write traffic: " << write_cycles << " cycles\n\n";
+    }
 
-    std::cout << "Overall hit rate: " << overall_hit_rate << "%\n";
-    std::cout << "Average access time: " << avg_time << " cycles\n\n";
+    if (dram)
+        dram->stats(std::cout);
+
+    if (timer)
+        timer->stats(std::cout, total_cycles);
+
+    std::cout << "Overall hit rate: " << get_overall_hit_rate() << "%\n";
+    std::cout << "Average access time: " << get_avg_access_time() << " cycles\n";
+    if (dram && opt_memory_accesses > 0)
+        std::cout << "OPT charged its " << opt_memory_accesses << " memory accesses the flat "
+                  << config.memory_penalty << " cycles, not the DRAM model\n";
+    std::cout << "\n";
+
+    if (sample_one_in > 1) {
+        SampleEstimate rate = get_overall_hit_rate_estimate();
+        SampleEstimate time = get_avg_access_time_estimate();
+        std::cout << "Sampled 1 in " << sample_one_in << " lines: simulated "
+                  << total_accesses << " of " << total_accesses + skipped_accesses
+                  << " accesses\n";
+        for (size_t i = 0; i < levels.size(); i++) {
+            SampleEstimate level = get_hit_rate_estimate(i);
+            std::cout << "  " << config.levels[i].name << " hit rate: " << level.value
+                      << "% +/- " << level.half_width << "%\n";
+        }
+        std::cout << "  overall hit rate: " << rate.value << "% +/- " << rate.half_width << "%\n"
+                  << "  average access time: " << time.value << " +/- " << time.half_width
+                  << " cycles (95% confidence)\n\n";
+    }
 
     std::cout << "Miss penalties:\n";
-    std::cout << "  L1 -> L2: " << l2.get_hit_time() << " cycles\n";
-    std::cout << "  L2 -> L3: " << l3.get_hit_time() << " cycles\n";
-    std::cout << "  L3 -> Memory: " << MEMORY_PENALTY << " cycles\n";
+    for (size_t i = 0; i + 1 < levels.size(); i++) {
+        std::cout << "  " << config.levels[i].name
+                  << " -> " << config.levels[i + 1].name << ": "
+                  << levels[i + 1].get_hit_time() << " cycles\n";
+    }
+    std::cout << "  " << config.levels.back().name << " -> Memory: ";
+    if (dram)
+        std::cout << "DRAM model\n";
+    else
+        std::cout << config.memory_penalty << " cycles\n";
 }
 
-double CacheSimulator::get_overall_hit_rate() const {
+template <class Level>
+double BasicCacheSimulator<Level>::get_overall_hit_rate() const {
+    size_t total_hits = 0;
+    for (size_t h : hits)
+        total_hits += h;
+
     return total_accesses == 0 ? 0.0 :
-           (double)(l1_hits + l2_hits + l3_hits) / total_accesses * 100.0;
+           (double)total_hits / total_accesses * 100.0;
 }
 
-double CacheSimulator::get_avg_access_time() const {
+template <class Level>
+double BasicCacheSimulator<Level>::get_avg_access_time() const {
+    if (timer && timer->get_counters().accesses > 0)
+        return timer->get_cycles_per_access();
     return total_accesses == 0 ? 0.0 :
            (double)total_cycles / total_accesses;
 }
 
-double CacheSimulator::get_l1_hit_rate() const {
-    return total_accesses == 0 ? 0.0 :
-           (double)l1_hits / total_accesses * 100.0;
+template <class Level>
+double BasicCacheSimulator<Level>::get_hit_rate(size_t level) const {
+    if (total_accesses == 0 || level >= hits.size())
+        return 0.0;
+
+    return (double)hits[level] / total_accesses * 100.0;
 }
 
-double CacheSimulator::get_l2_hit_rate() const {
-    return total_accesses == 0 ? 0.0 :
-           (double)l2_hits / total_accesses * 100.0;
+template <class Level>
+double BasicCacheSimulator<Level>::get_l1_hit_rate() const {
+    return get_hit_rate(0);
 }
 
-double CacheSimulator::get_l3_hit_rate() const {
-    return total_accesses == 0 ? 0.0 :
-           (double)l3_hits / total_accesses * 100.0;
+template <class Level>
+double BasicCacheSimulator<Level>::get_l2_hit_rate() const {
+    return get_hit_rate(1);
+}
+
+template <class Level>
+double BasicCacheSimulator<Level>::get_l3_hit_rate() const {
+    return get_hit_rate(2);
 }
 
-size_t CacheSimulator::get_memory_accesses() const {
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_memory_accesses() const {
     return memory_accesses;
 }
 
-size_t CacheSimulator::get_total_accesses() const {
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_write_count() const {
+    return writes;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_writebacks(size_t level) const {
+    return level < writebacks.size() ? writebacks[level] : 0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_write_throughs(size_t level) const {
+    return level < write_throughs.size() ? write_throughs[level] : 0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_memory_writes() const {
+    return memory_writes;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_write_cycles() const {
+    return write_cycles;
+}
+
+template <class Level>
+const PrefetchCounters& BasicCacheSimulator<Level>::get_prefetch_counters(size_t level) const {
+    return prefetch_stats.at(level);
+}
+
+template <class Level>
+double BasicCacheSimulator<Level>::get_prefetch_accuracy(size_t level) const {
+    if (level >= prefetch_stats.size() || prefetch_stats[level].issued == 0)
+        return 0.0;
+
+    return (double)prefetch_stats[level].useful / prefetch_stats[level].issued * 100.0;
+}
+
+template <class Level>
+double BasicCacheSimulator<Level>::get_prefetch_coverage(size_t level) const {
+    if (level >= prefetch_stats.size())
+        return 0.0;
+
+    size_t useful = prefetch_stats[level].useful;
+    size_t demand = useful + misses[level];
+    return demand == 0 ? 0.0 : (double)useful / demand * 100.0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_back_invalidations(size_t level) const {
+    return level < back_invalidations.size() ? back_invalidations[level] : 0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_demotions(size_t level) const {
+    return level < demotions.size() ? demotions[level] : 0;
+}
+
+// Counted in units of the smallest line so levels with different line
+// sizes can be merged.
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_unique_capacity() const {
+    size_t unit = config.levels.front().line_size;
+    for (const auto& level : config.levels)
+        unit = std::min(unit, level.line_size);
+
+    std::unordered_set<size_t> units;
+    for (size_t i = 0; i < levels.size(); i++) {
+        size_t per_line = config.levels[i].line_size / unit;
+        for (size_t block : levels[i].resident_blocks()) {
+            size_t first = block * config.levels[i].line_size / unit;
+            for (size_t u = 0; u < per_line; u++)
+                units.insert(first + u);
+        }
+    }
+    return units.size() * unit;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_total_capacity() const {
+    size_t total = 0;
+    for (const auto& level : config.levels)
+        total += level.capacity * level.line_size;
+    return total;
+}
+
+template <class Level>
+SampleEstimate BasicCacheSimulator<Level>::get_overall_hit_rate_estimate() const {
+    if (sample_one_in == 1)
+        return {get_overall_hit_rate(), 0.0};
+
+    std::vector<double> num, den;
+    for (const SampleGroup& g : sample_groups) {
+        size_t group_hits = 0;
+        for (size_t h : g.hits)
+            group_hits += h;
+        num.push_back(group_hits);
+        den.push_back(g.accesses);
+    }
+    return ratio_estimate(num, den, 100.0);
+}
+
+template <class Level>
+SampleEstimate BasicCacheSimulator<Level>::get_avg_access_time_estimate() const {
+    if (sample_one_in == 1)
+        return {get_avg_access_time(), 0.0};
+
+    std::vector<double> num, den;
+    for (const SampleGroup& g : sample_groups) {
+        num.push_back(g.cycles);
+        den.push_back(g.accesses);
+    }
+    return ratio_estimate(num, den, 1.0);
+}
+
+template <class Level>
+SampleEstimate BasicCacheSimulator<Level>::get_hit_rate_estimate(size_t level) const {
+    if (sample_one_in == 1 || level >= levels.size())
+        return {get_hit_rate(level), 0.0};
+
+    std::vector<double> num, den;
+    for (const SampleGroup& g : sample_groups) {
+        num.push_back(g.hits[level]);
+        den.push_back(g.accesses);
+    }
+    return ratio_estimate(num, den, 100.0);
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_compulsory_misses(size_t level) const {
+    return level < miss_kinds.size() ? miss_kinds[level].compulsory : 0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_capacity_misses(size_t level) const {
+    return level < miss_kinds.size() ? miss_kinds[level].capacity : 0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_conflict_misses(size_t level) const {
+    return level < miss_kinds.size() ? miss_kinds[level].conflict : 0;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_total_accesses() const {
     return total_accesses;
-}
\ No newline at end of file
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_skipped_accesses() const {
+    return skipped_accesses;
+}
+
+template <class Level>
+size_t BasicCacheSimulator<Level>::get_level_count() const {
+    return levels.size();
+}
+
+template <class Level>
+const CacheConfig& BasicCacheSimulator<Level>::get_config() const {
+    return config;
+}
+
+template <class Level>
+const VirtualMemory* BasicCacheSimulator<Level>::get_virtual_memory() const {
+    return vm.get();
+}
+
+template <class Level>
+const NonBlockingTimer* BasicCacheSimulator<Level>::get_timer() const {
+    return timer.get();
+}
+
+template <class Level>
+const DramController* BasicCacheSimulator<Level>::get_dram() const {
+    return dram.get();
+}
+
+template class BasicCacheSimulator<CacheLevel>;
+template class BasicCacheSimulator<BasicCacheLevel<FifoPolicy, Associativity::FULL>>;
+template class BasicCacheSimulator<BasicCacheLevel<FifoPolicy, Associativity::SET>>;
+template class BasicCacheSimulator<BasicCacheLevel<LruPolicy, Associativity::FULL>>;
+template class BasicCacheSimulator<BasicCacheLevel<LruPolicy, Associativity::SET>>;
+template class BasicCacheSimulator<BasicCacheLevel<LfuPolicy, Associativity::FULL>>;
+template class BasicCacheSimulator<BasicCacheLevel<LfuPolicy, Associativity::SET>>;
+template class BasicCacheSimulator<BasicCacheLevel<LfuAgingPolicy, Associativity::FULL>>;
+template class BasicCacheSimulator<BasicCacheLevel<LfuAgingPolicy, Associativity::SET>>;
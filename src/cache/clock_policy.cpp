@@ -0,0 +1,78 @@
+#include "cache/clock_policy.hpp"
+
+ClockPolicy::ClockPolicy(size_t capacity) {
+    ids.reserve(capacity);
+    referenced.reserve(capacity);
+    hand = ring.end();
+}
+
+size_t ClockPolicy::take_slot(size_t block_id) {
+    if (free_slots.empty()) {
+        ids.push_back(block_id);
+        referenced.push_back(0);
+        return ids.size() - 1;
+    }
+
+    size_t slot = free_slots.back();
+    free_slots.pop_back();
+    ids[slot] = block_id;
+    referenced[slot] = 0;
+    return slot;
+}
+
+// Frees the slot and moves the hand past pos if it points there.
+void ClockPolicy::unlink(std::list<size_t>::iterator pos) {
+    free_slots.push_back(*pos);
+    if (hand == pos) {
+        hand = ring.erase(pos);
+        if (hand == ring.end())
+            hand = ring.begin();
+    } else {
+        ring.erase(pos);
+    }
+}
+
+// New blocks go just behind the hand, the last position it will reach.
+void ClockPolicy::on_insert(CacheBlock& blk) {
+    blk.pos = ring.insert(hand, take_slot(blk.block_id));
+    if (hand == ring.end())
+        hand = ring.begin();
+}
+
+void ClockPolicy::on_hit(CacheBlock& blk) {
+    referenced[*blk.pos] = 1;
+}
+
+// Every block passed over loses its bit, so the sweep ends within one
+// revolution; amortised over hits it is constant per access.
+size_t ClockPolicy::evict(size_t) {
+    while (true) {
+        if (hand == ring.end())
+            hand = ring.begin();
+
+        if (referenced[*hand]) {
+            referenced[*hand] = 0;
+            ++hand;
+            continue;
+        }
+
+        size_t victim = ids[*hand];
+        unlink(hand);
+        return victim;
+    }
+}
+
+void ClockPolicy::on_remove(CacheBlock& blk) {
+    unlink(blk.pos);
+}
+
+std::vector<size_t> ClockPolicy::eviction_order() const {
+    std::vector<size_t> order;
+    order.reserve(ring.size());
+
+    for (auto it = hand; it != ring.end(); ++it)
+        order.push_back(ids[*it]);
+    for (auto it = ring.begin(); it != hand; ++it)
+        order.push_back(ids[*it]);
+    return order;
+}
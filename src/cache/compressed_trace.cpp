@@ -0,0 +1,262 @@
+#include "cache/compressed_trace.hpp"
+#include <cstring>
+#include <stdexcept>
+
+static const char HEADER_MAGIC[8] = {'M', 'S', 'T', 'R', 'A', 'C', 'E', '1'};
+static const char FOOTER_MAGIC[8] = {'M', 'S', 'T', 'R', 'I', 'D', 'X', '1'};
+static constexpr size_t HEADER_BYTES = 24;
+static constexpr size_t FOOTER_BYTES = 32;
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static void put_u64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+        v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static uint64_t get_u64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void write_bytes(std::FILE* file, const void* data, size_t n) {
+    if (std::fwrite(data, 1, n, file) != n)
+        throw std::runtime_error("Failed to write compressed trace");
+}
+
+CompressedTraceWriter::CompressedTraceWriter(const std::string& path,
+                                             size_t block_size,
+                                             bool with_writes)
+    : file(nullptr),
+      header{COMPRESSED_TRACE_VERSION, with_writes ? TRACE_FLAG_WRITES : 0, 0},
+      chunk_records(0),
+      previous(0),
+      offset(HEADER_BYTES),
+      total_records(0) {
+    if (block_size == 0 || (block_size & (block_size - 1)))
+        throw std::runtime_error("Trace block size must be a power of two");
+    while ((size_t(1) << header.block_shift) < block_size)
+        header.block_shift++;
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("Cannot write trace: " + path);
+
+    uint8_t buf[HEADER_BYTES];
+    std::memcpy(buf, HEADER_MAGIC, 8);
+    put_u32(buf + 8, header.version);
+    put_u32(buf + 12, header.flags);
+    put_u32(buf + 16, header.block_shift);
+    put_u32(buf + 20, 0);
+    write_bytes(file, buf, HEADER_BYTES);
+
+    payload.reserve(TRACE_CHUNK_RECORDS * 4);
+}
+
+CompressedTraceWriter::~CompressedTraceWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+    }
+}
+
+void CompressedTraceWriter::append(const TraceRecord& rec) {
+    uint64_t block = rec.address >> header.block_shift;
+    int64_t delta = static_cast<int64_t>(block - previous);
+    previous = block;
+
+    uint64_t value = (static_cast<uint64_t>(delta) << 1) ^
+                     static_cast<uint64_t>(delta >> 63);
+    if (header.flags & TRACE_FLAG_WRITES) {
+        if (value >> 63)
+            throw std::runtime_error("Trace address delta too large");
+        value = (value << 1) | (rec.write ? 1 : 0);
+    }
+
+    while (value >= 0x80) {
+        payload.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    payload.push_back(static_cast<uint8_t>(value));
+
+    total_records++;
+    if (++chunk_records == TRACE_CHUNK_RECORDS)
+        flush_chunk();
+}
+
+void CompressedTraceWriter::flush_chunk() {
+    if (chunk_records == 0)
+        return;
+
+    uint8_t buf[8];
+    put_u32(buf, static_cast<uint32_t>(payload.size()));
+    put_u32(buf + 4, chunk_records);
+    write_bytes(file, buf, 8);
+    write_bytes(file, payload.data(), payload.size());
+
+    index.push_back({offset, static_cast<uint32_t>(payload.size()), chunk_records});
+    offset += 8 + payload.size();
+
+    payload.clear();
+    chunk_records = 0;
+    previous = 0;
+}
+
+void CompressedTraceWriter::close() {
+    if (!file)
+        return;
+
+    std::FILE* f = file;
+    flush_chunk();
+
+    uint8_t end[8] = {};
+    write_bytes(f, end, 8);
+    uint64_t index_offset = offset + 8;
+
+    for (const TraceChunkInfo& chunk : index) {
+        uint8_t buf[16];
+        put_u64(buf, chunk.offset);
+        put_u32(buf + 8, chunk.bytes);
+        put_u32(buf + 12, chunk.records);
+        write_bytes(f, buf, 16);
+    }
+
+    uint8_t footer[FOOTER_BYTES];
+    put_u64(footer, index.size());
+    put_u64(footer + 8, total_records);
+    put_u64(footer + 16, index_offset);
+    std::memcpy(footer + 24, FOOTER_MAGIC, 8);
+    write_bytes(f, footer, FOOTER_BYTES);
+
+    offset = index_offset + index.size() * 16 + FOOTER_BYTES;
+    file = nullptr;
+    if (std::fclose(f) != 0)
+        throw std::runtime_error("Failed to write compressed trace");
+}
+
+uint64_t CompressedTraceWriter::get_records() const {
+    return total_records;
+}
+
+uint64_t CompressedTraceWriter::get_bytes() const {
+    return offset + payload.size();
+}
+
+CompressedTraceHeader read_compressed_header(std::FILE* file) {
+    uint8_t buf[HEADER_BYTES];
+    if (std::fread(buf, 1, HEADER_BYTES, file) != HEADER_BYTES ||
+        std::memcmp(buf, HEADER_MAGIC, 8) != 0)
+        throw std::runtime_error("Not a compressed trace");
+
+    CompressedTraceHeader header{get_u32(buf + 8), get_u32(buf + 12), get_u32(buf + 16)};
+    if (header.version != COMPRESSED_TRACE_VERSION)
+        throw std::runtime_error("Unsupported compressed trace version " +
+                                 std::to_string(header.version));
+    if (header.block_shift >= 64)
+        throw std::runtime_error("Corrupt compressed trace header");
+    return header;
+}
+
+std::vector<TraceChunkInfo> read_trace_index(const std::string& path,
+                                             CompressedTraceHeader& header) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        throw std::runtime_error("Cannot open trace: " + path);
+
+    std::vector<TraceChunkInfo> index;
+    try {
+        header = read_compressed_header(file);
+
+        uint8_t footer[FOOTER_BYTES];
+        if (std::fseek(file, -static_cast<long>(FOOTER_BYTES), SEEK_END) != 0 ||
+            std::fread(footer, 1, FOOTER_BYTES, file) != FOOTER_BYTES ||
+            std::memcmp(footer + 24, FOOTER_MAGIC, 8) != 0)
+            throw std::runtime_error("Compressed trace has no index: " + path);
+
+        uint64_t count = get_u64(footer);
+        uint64_t index_offset = get_u64(footer + 16);
+
+        std::vector<uint8_t> raw(count * 16);
+        if (std::fseek(file, static_cast<long>(index_offset), SEEK_SET) != 0 ||
+            std::fread(raw.data(), 1, raw.size(), file) != raw.size())
+            throw std::runtime_error("Truncated compressed trace index: " + path);
+
+        index.resize(count);
+        for (uint64_t i = 0; i < count; i++) {
+            index[i].offset = get_u64(&raw[i * 16]);
+            index[i].bytes = get_u32(&raw[i * 16 + 8]);
+            index[i].records = get_u32(&raw[i * 16 + 12]);
+        }
+    } catch (...) {
+        std::fclose(file);
+        throw;
+    }
+
+    std::fclose(file);
+    return index;
+}
+
+void decode_trace_chunk(const uint8_t* p, size_t bytes, size_t records,
+                        const CompressedTraceHeader& header, TraceRecord* out) {
+    const uint8_t* end = p + bytes;
+    const bool writes = header.flags & TRACE_FLAG_WRITES;
+    const uint32_t shift = header.block_shift;
+    uint64_t block = 0;
+
+    for (size_t i = 0; i < records; i++) {
+        uint64_t value;
+        // Most deltas of a real trace fit in one byte.
+        if (p < end && *p < 0x80) {
+            value = *p++;
+        } else {
+            value = 0;
+            for (int s = 0;; s += 7) {
+                if (p == end || s > 63)
+                    throw std::runtime_error("Corrupt compressed trace chunk");
+                uint8_t byte = *p++;
+                value |= static_cast<uint64_t>(byte & 0x7f) << s;
+                if (byte < 0x80)
+                    break;
+            }
+        }
+
+        bool write = false;
+        if (writes) {
+            write = value & 1;
+            value >>= 1;
+        }
+
+        int64_t delta = static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        block += static_cast<uint64_t>(delta);
+        out[i] = {block << shift, write};
+    }
+
+    if (p != end)
+        throw std::runtime_error("Corrupt compressed trace chunk");
+}
+
+size_t convert_trace(TraceReader& reader, const std::string& path,
+                     size_t block_size, bool with_writes) {
+    CompressedTraceWriter writer(path, block_size, with_writes);
+    std::vector<TraceRecord> records(1 << 16);
+
+    while (size_t n = reader.read(records.data(), records.size())) {
+        for (size_t i = 0; i < n; i++)
+            writer.append(records[i]);
+    }
+
+    writer.close();
+    return writer.get_records();
+}
@@ -0,0 +1,166 @@
+#include "cache/dram.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+bool row_policy_from_string(const std::string& s, RowPolicy& out) {
+    if (s == "open")   { out = RowPolicy::OPEN; return true; }
+    if (s == "closed") { out = RowPolicy::CLOSED; return true; }
+    return false;
+}
+
+std::string row_policy_name(RowPolicy policy) {
+    return policy == RowPolicy::OPEN ? "open" : "closed";
+}
+
+bool address_mapping_from_string(const std::string& s, AddressMapping& out) {
+    if (s == "row-bank-column") { out = AddressMapping::ROW_BANK_COLUMN; return true; }
+    if (s == "row-column-bank") { out = AddressMapping::ROW_COLUMN_BANK; return true; }
+    if (s == "xor")             { out = AddressMapping::XOR; return true; }
+    return false;
+}
+
+std::string address_mapping_name(AddressMapping mapping) {
+    switch (mapping) {
+        case AddressMapping::ROW_BANK_COLUMN: return "row-bank-column";
+        case AddressMapping::ROW_COLUMN_BANK: return "row-column-bank";
+        case AddressMapping::XOR:             return "xor";
+    }
+    return "unknown";
+}
+
+static bool power_of_two(size_t n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+static unsigned log2_of(size_t n) {
+    unsigned bits = 0;
+    while (n >>= 1)
+        bits++;
+    return bits;
+}
+
+void DramConfig::validate(size_t line_size) const {
+    if (!power_of_two(channels) || !power_of_two(ranks) || !power_of_two(banks))
+        throw std::runtime_error("DRAM channels, ranks and banks must be powers of two");
+    if (row_size < line_size || row_size % line_size != 0 ||
+        !power_of_two(row_size / line_size))
+        throw std::runtime_error("DRAM rows must hold a power-of-two number of lines");
+}
+
+DramController::DramController(const DramConfig& cfg, size_t line)
+    : config(cfg), line_size(line) {
+    config.validate(line_size);
+
+    column_bits = log2_of(config.row_size / line_size);
+    channel_bits = log2_of(config.channels);
+    bank_bits = log2_of(config.banks);
+    rank_bits = log2_of(config.ranks);
+
+    banks.resize(config.channels * config.ranks * config.banks);
+    bus_ready.assign(config.channels, 0);
+}
+
+static uint64_t take_bits(uint64_t& value, unsigned bits) {
+    uint64_t field = value & ((uint64_t(1) << bits) - 1);
+    value >>= bits;
+    return field;
+}
+
+DramController::Location DramController::map(uint64_t address) const {
+    uint64_t line = address / line_size;
+    Location loc;
+
+    if (config.mapping == AddressMapping::ROW_COLUMN_BANK) {
+        loc.channel = take_bits(line, channel_bits);
+        loc.bank = take_bits(line, bank_bits);
+        loc.rank = take_bits(line, rank_bits);
+        loc.column = take_bits(line, column_bits);
+    } else {
+        loc.column = take_bits(line, column_bits);
+        loc.channel = take_bits(line, channel_bits);
+        loc.bank = take_bits(line, bank_bits);
+        loc.rank = take_bits(line, rank_bits);
+    }
+    loc.row = line;
+
+    if (config.mapping == AddressMapping::XOR)
+        loc.bank ^= loc.row & (config.banks - 1);
+    return loc;
+}
+
+size_t DramController::access(uint64_t address, bool write, uint64_t now) {
+    Location loc = map(address);
+    Bank& bank = banks[(loc.channel * config.ranks + loc.rank) * config.banks + loc.bank];
+
+    if (counters.reads + counters.writes == 0)
+        counters.first = now;
+    if (write)
+        counters.writes++;
+    else
+        counters.reads++;
+
+    uint64_t start = std::max(now, bank.ready);
+    size_t command = config.t_cas;
+    if (bank.open && bank.row == loc.row) {
+        counters.row_hits++;
+    } else if (!bank.open) {
+        counters.row_empty++;
+        command += config.t_rcd;
+    } else {
+        counters.row_conflicts++;
+        command += config.t_rp + config.t_rcd;
+    }
+
+    uint64_t& bus = bus_ready[loc.channel];
+    uint64_t done = std::max(start + command, bus) + config.t_burst;
+    bus = done;
+    counters.bus_cycles += config.t_burst;
+
+    if (config.row_policy == RowPolicy::OPEN) {
+        // Column accesses to the open row pipeline one burst apart.
+        bank.open = true;
+        bank.row = loc.row;
+        bank.ready = start + command - config.t_cas + config.t_burst;
+    } else {
+        bank.open = false;
+        bank.ready = done + config.t_rp;
+    }
+
+    counters.latency += done - now;
+    counters.last = std::max(counters.last, done);
+    return done - now;
+}
+
+const DramCounters& DramController::get_counters() const {
+    return counters;
+}
+
+double DramController::get_row_hit_rate() const {
+    size_t requests = counters.reads + counters.writes;
+    return requests == 0 ? 0.0 : 100.0 * counters.row_hits / requests;
+}
+
+double DramController::get_bandwidth() const {
+    uint64_t elapsed = counters.last - counters.first;
+    size_t requests = counters.reads + counters.writes;
+    return elapsed == 0 ? 0.0 : (double)requests * line_size / elapsed;
+}
+
+void DramController::stats(std::ostream& out) const {
+    size_t requests = counters.reads + counters.writes;
+    uint64_t elapsed = counters.last - counters.first;
+
+    out << "DRAM: " << config.channels << " channel(s), " << config.ranks << " rank(s), "
+        << config.banks << " banks, " << config.row_size << "-byte rows, "
+        << row_policy_name(config.row_policy) << " rows, "
+        << address_mapping_name(config.mapping) << " mapping\n"
+        << "  reads: " << counters.reads << "  writes: " << counters.writes << "\n"
+        << "  row hits: " << counters.row_hits << "  empty: " << counters.row_empty
+        << "  conflicts: " << counters.row_conflicts
+        << "  row-hit rate: " << get_row_hit_rate() << "%\n"
+        << "  average latency: " << (requests ? (double)counters.latency / requests : 0.0)
+        << " cycles\n"
+        << "  bandwidth: " << get_bandwidth() << " bytes/cycle  bus utilisation: "
+        << (elapsed ? 100.0 * counters.bus_cycles / (elapsed * config.channels) : 0.0)
+        << "%\n\n";
+}
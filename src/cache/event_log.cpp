@@ -0,0 +1,228 @@
+#include "cache/event_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+static const char EVENT_LOG_MAGIC[8] = {'M', 'S', 'E', 'V', 'L', 'O', 'G', '1'};
+static constexpr uint32_t EVENT_LOG_VERSION = 2;
+
+void write_event_text(std::ostream& out, const std::vector<std::string>& level_names,
+                      const CacheEvent& event) {
+    size_t levels = level_names.size();
+    size_t hit_level = event.hit_level < levels ? event.hit_level : levels;
+
+    out << "ACCESS " << event.address << " (block " << event.block
+        << (event.write ? ", write" : "") << "):\n";
+    for (size_t i = 0; i < hit_level; i++)
+        out << "  " << level_names[i] << " MISS\n";
+
+    if (hit_level < levels)
+        out << "  " << level_names[hit_level] << " HIT\n";
+    else
+        out << "  MAIN MEMORY ACCESS\n";
+
+    for (size_t i = hit_level; i-- > 0;) {
+        if (event.filled >> i & 1)
+            out << "  Loaded into " << level_names[i] << "\n";
+    }
+
+    out << "  Access time: " << event.cycles << " cycles\n";
+}
+
+static void write_bytes(std::FILE* file, const void* data, size_t n) {
+    if (std::fwrite(data, 1, n, file) != n)
+        throw std::runtime_error("Failed to write event log");
+}
+
+EventLog::EventLog(const std::string& path, const std::vector<std::string>& level_names,
+                   size_t capacity)
+    : file(std::fopen(path.c_str(), "wb")),
+      head(0),
+      tail(0),
+      stopping(false),
+      failed(false),
+      written(0) {
+    if (!file)
+        throw std::runtime_error("Cannot write event log: " + path);
+
+    // A power-of-two ring lets indices grow freely and wrap with a mask.
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    ring.resize(size);
+
+    uint32_t header[2] = {EVENT_LOG_VERSION, static_cast<uint32_t>(level_names.size())};
+    try {
+        write_bytes(file, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+        write_bytes(file, header, sizeof(header));
+        for (const std::string& name : level_names) {
+            uint32_t length = static_cast<uint32_t>(name.size());
+            write_bytes(file, &length, sizeof(length));
+            write_bytes(file, name.data(), name.size());
+        }
+    } catch (...) {
+        std::fclose(file);
+        throw;
+    }
+
+    writer = std::thread(&EventLog::run, this);
+}
+
+EventLog::~EventLog() {
+    try {
+        close();
+    } catch (const std::exception&) {
+    }
+}
+
+void EventLog::record(const CacheEvent& event) {
+    size_t h = head.load(std::memory_order_relaxed);
+
+    if (h - tail.load(std::memory_order_acquire) == ring.size()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake_writer.notify_one();
+        wake_producer.wait(lock, [&] {
+            return failed.load(std::memory_order_acquire) ||
+                   h - tail.load(std::memory_order_acquire) < ring.size();
+        });
+    }
+    if (failed.load(std::memory_order_acquire))
+        std::rethrow_exception(error);
+
+    ring[h & (ring.size() - 1)] = event;
+    head.store(h + 1, std::memory_order_release);
+
+    // Wake the writer once half the ring is pending, so writes stay large.
+    if (((h + 1) & (ring.size() / 2 - 1)) == 0) {
+        { std::lock_guard<std::mutex> lock(mutex); }
+        wake_writer.notify_one();
+    }
+}
+
+void EventLog::flush_range(size_t from, size_t to) {
+    size_t mask = ring.size() - 1;
+    while (from != to) {
+        size_t start = from & mask;
+        size_t count = std::min(to - from, ring.size() - start);
+        write_bytes(file, &ring[start], count * sizeof(CacheEvent));
+        from += count;
+    }
+}
+
+// Runs the writer loop; a write error stops it and is handed to the
+// producer, which may be waiting for room in the ring.
+void EventLog::run() {
+    try {
+        drain();
+    } catch (...) {
+        error = std::current_exception();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed.store(true, std::memory_order_release);
+        }
+        wake_producer.notify_one();
+    }
+}
+
+void EventLog::drain() {
+    const size_t batch = ring.size() / 2;
+
+    while (true) {
+        size_t t = tail.load(std::memory_order_relaxed);
+
+        if (head.load(std::memory_order_acquire) - t < batch &&
+            !stopping.load(std::memory_order_acquire)) {
+            // Flush whatever is pending at least every 50 ms.
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_writer.wait_for(lock, std::chrono::milliseconds(50), [&] {
+                return stopping.load(std::memory_order_acquire) ||
+                       head.load(std::memory_order_acquire) - t >= batch;
+            });
+        }
+
+        size_t h = head.load(std::memory_order_acquire);
+        if (h != t) {
+            flush_range(t, h);
+            written += h - t;
+            tail.store(h, std::memory_order_release);
+
+            { std::lock_guard<std::mutex> lock(mutex); }
+            wake_producer.notify_one();
+        } else if (stopping.load(std::memory_order_acquire)) {
+            break;
+        }
+    }
+
+    if (std::fflush(file) != 0)
+        throw std::runtime_error("Failed to write event log");
+}
+
+void EventLog::close() {
+    if (!file)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping.store(true, std::memory_order_release);
+    }
+    wake_writer.notify_one();
+    writer.join();
+
+    bool closed = std::fclose(file) == 0;
+    file = nullptr;
+    if (failed.load(std::memory_order_acquire))
+        std::rethrow_exception(error);
+    if (!closed)
+        throw std::runtime_error("Failed to write event log");
+}
+
+size_t EventLog::get_written() const {
+    return written;
+}
+
+size_t decode_event_log(const std::string& path, std::ostream& out) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        throw std::runtime_error("Cannot open event log: " + path);
+
+    auto read_exact = [&](void* data, size_t n) {
+        if (std::fread(data, 1, n, file) != n) {
+            std::fclose(file);
+            throw std::runtime_error("Truncated event log: " + path);
+        }
+    };
+
+    char magic[8];
+    uint32_t header[2];
+    read_exact(magic, sizeof(magic));
+    if (std::memcmp(magic, EVENT_LOG_MAGIC, sizeof(magic)) != 0) {
+        std::fclose(file);
+        throw std::runtime_error("Not an event log: " + path);
+    }
+    read_exact(header, sizeof(header));
+    if (header[0] != EVENT_LOG_VERSION) {
+        std::fclose(file);
+        throw std::runtime_error("Unsupported event log version " +
+                                 std::to_string(header[0]));
+    }
+
+    std::vector<std::string> names(header[1]);
+    for (std::string& name : names) {
+        uint32_t length;
+        read_exact(&length, sizeof(length));
+        name.resize(length);
+        read_exact(&name[0], length);
+    }
+
+    std::vector<CacheEvent> events(1 << 14);
+    size_t total = 0;
+    while (size_t n = std::fread(events.data(), sizeof(CacheEvent), events.size(), file)) {
+        for (size_t i = 0; i < n; i++)
+            write_event_text(out, names, events[i]);
+        total += n;
+    }
+
+    std::fclose(file);
+    return total;
+}
@@ -0,0 +1,94 @@
+#include "cache/miss_classifier.hpp"
+#include <algorithm>
+
+static constexpr unsigned INITIAL_BITS = 10;
+
+MissClassifier::MissClassifier(size_t cap)
+    : capacity(std::max<size_t>(cap, 1)),
+      head(NO_NODE),
+      tail(NO_NODE),
+      keys(size_t(1) << INITIAL_BITS, 0),
+      node_of(size_t(1) << INITIAL_BITS, NO_NODE),
+      used_slots(0),
+      shift(64 - INITIAL_BITS) {
+    nodes.reserve(capacity);
+}
+
+// Slot holding block, or the empty slot where it would go.
+size_t MissClassifier::find_slot(size_t block) const {
+    size_t mask = keys.size() - 1;
+    size_t i = (uint64_t(block) * 0x9e3779b97f4a7c15ull) >> shift;
+    while (keys[i] != 0 && keys[i] != uint64_t(block) + 1)
+        i = (i + 1) & mask;
+    return i;
+}
+
+void MissClassifier::grow() {
+    std::vector<uint64_t> old_keys(keys.size() * 2, 0);
+    std::vector<uint32_t> old_nodes(node_of.size() * 2, NO_NODE);
+    old_keys.swap(keys);
+    old_nodes.swap(node_of);
+    shift--;
+
+    for (size_t i = 0; i < old_keys.size(); i++) {
+        if (old_keys[i] == 0)
+            continue;
+        size_t j = find_slot(old_keys[i] - 1);
+        keys[j] = old_keys[i];
+        node_of[j] = old_nodes[i];
+    }
+}
+
+void MissClassifier::unlink(uint32_t n) {
+    Node& node = nodes[n];
+    if (node.prev != NO_NODE) nodes[node.prev].next = node.next;
+    else head = node.next;
+    if (node.next != NO_NODE) nodes[node.next].prev = node.prev;
+    else tail = node.prev;
+}
+
+void MissClassifier::push_front(uint32_t n) {
+    nodes[n].prev = NO_NODE;
+    nodes[n].next = head;
+    if (head != NO_NODE) nodes[head].prev = n;
+    head = n;
+    if (tail == NO_NODE) tail = n;
+}
+
+ShadowResult MissClassifier::reference(size_t block) {
+    size_t i = find_slot(block);
+    uint32_t n = node_of[i];
+
+    if (n != NO_NODE) {
+        if (n != head) {
+            unlink(n);
+            push_front(n);
+        }
+        return ShadowResult::HIT;
+    }
+
+    bool first = keys[i] == 0;
+    if (first) {
+        if (2 * (used_slots + 1) > keys.size()) {
+            grow();
+            i = find_slot(block);
+        }
+        keys[i] = uint64_t(block) + 1;
+        used_slots++;
+    }
+
+    // Bring the block in, reusing the LRU node once the shadow is full.
+    if (nodes.size() < capacity) {
+        n = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({block, NO_NODE, NO_NODE});
+    } else {
+        n = tail;
+        unlink(n);
+        node_of[find_slot(nodes[n].block)] = NO_NODE;
+        nodes[n].block = block;
+    }
+    push_front(n);
+    node_of[i] = n;
+
+    return first ? ShadowResult::FIRST_TOUCH : ShadowResult::MISS;
+}
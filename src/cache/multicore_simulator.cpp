@@ -0,0 +1,471 @@
+#include "cache/multicore_simulator.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+
+std::string mesi_state_name(MesiState state) {
+    switch (state) {
+    case MesiState::SHARED:    return "S";
+    case MesiState::EXCLUSIVE: return "E";
+    case MesiState::MODIFIED:  return "M";
+    default:                   return "I";
+    }
+}
+
+static const CacheConfig& checked(const CacheConfig& config, size_t cores) {
+    config.validate();
+
+    if (cores == 0 || cores > 64)
+        throw std::runtime_error("Multicore simulation needs 1 to 64 cores");
+    if (config.levels.size() < 2)
+        throw std::runtime_error("Multicore simulation needs a private and a shared level");
+
+    for (const auto& level : config.levels) {
+        if (level.line_size != config.levels.front().line_size)
+            throw std::runtime_error("Multicore simulation needs the same line size at every level");
+    }
+    return config;
+}
+
+static uint64_t core_bit(size_t core) {
+    return uint64_t(1) << core;
+}
+
+MulticoreSimulator::MulticoreSimulator(const CacheConfig& cfg, size_t n)
+    : config(checked(cfg, n)),
+      cores(n),
+      line_size(cfg.levels.front().line_size),
+      word_size(std::max<size_t>(8, line_size / 64)),
+      shared(cfg.levels.back().capacity, cfg.levels.back().hit_time,
+             cfg.levels.back().policy, cfg.levels.back().ways),
+      lost_words(n),
+      counters(n),
+      invalidations(0),
+      interventions(0),
+      writebacks(0),
+      back_invalidations(0),
+      memory_accesses(0),
+      memory_writes(0) {
+
+    private_levels.resize(cores);
+    for (size_t core = 0; core < cores; core++) {
+        for (size_t i = 0; i + 1 < config.levels.size(); i++) {
+            const CacheLevelConfig& level = config.levels[i];
+            private_levels[core].emplace_back(level.capacity, level.hit_time,
+                                              level.policy, level.ways);
+        }
+        counters[core].hits.assign(config.levels.size() - 1, 0);
+        counters[core].misses.assign(config.levels.size() - 1, 0);
+    }
+}
+
+uint64_t MulticoreSimulator::word_bit(size_t address) const {
+    return uint64_t(1) << (address % line_size / word_size);
+}
+
+bool MulticoreSimulator::holds(size_t core, size_t block) const {
+    for (const CacheLevel& level : private_levels[core]) {
+        if (level.contains(block))
+            return true;
+    }
+    return false;
+}
+
+void MulticoreSimulator::drop(size_t core, size_t block) {
+    for (CacheLevel& level : private_levels[core])
+        level.invalidate(block);
+}
+
+// The core has evicted its last private copy: a modified line is written
+// back to the shared level and the core leaves the sharers.
+void MulticoreSimulator::release(size_t core, size_t block, size_t& cycles) {
+    auto it = directory.find(block);
+    if (it == directory.end())
+        return;
+
+    DirectoryEntry& entry = it->second;
+    if (entry.dirty && entry.sharers == core_bit(core)) {
+        writebacks++;
+        shared.set_dirty(block);
+        cycles += shared.get_hit_time();
+    }
+
+    entry.sharers &= ~core_bit(core);
+    if (entry.sharers == 0)
+        entry.owned = entry.dirty = false;
+}
+
+void MulticoreSimulator::fill_private(size_t core, size_t level, size_t block, size_t& cycles) {
+    CacheEviction victim = private_levels[core][level].insert(block);
+    if (victim.valid && !holds(core, victim.block_id))
+        release(core, victim.block_id, cycles);
+}
+
+// Inclusive shared level: its victim is invalidated in every core, and
+// written to memory if it or a core's copy was modified.
+void MulticoreSimulator::fill_shared(size_t block, size_t& cycles) {
+    CacheEviction victim = shared.insert(block);
+    if (!victim.valid)
+        return;
+
+    bool dirty = victim.dirty;
+    auto it = directory.find(victim.block_id);
+    if (it != directory.end()) {
+        const DirectoryEntry& entry = it->second;
+        for (size_t core = 0; core < cores; core++) {
+            if (entry.sharers & core_bit(core)) {
+                drop(core, victim.block_id);
+                back_invalidations++;
+            }
+            if (entry.lost & core_bit(core))
+                lost_words[core].erase(victim.block_id);
+        }
+        dirty |= entry.dirty;
+        directory.erase(it);
+    }
+
+    if (dirty) {
+        memory_writes++;
+        cycles += config.memory_penalty;
+    }
+}
+
+// Gives `core` the only copy: every other sharer is invalidated, and an
+// E/M owner hands over the line (writing it back first if modified).
+void MulticoreSimulator::invalidate_others(size_t core, size_t block, DirectoryEntry& entry,
+                                           size_t& cycles) {
+    uint64_t others = entry.sharers & ~core_bit(core);
+    if (others == 0)
+        return;
+
+    if (entry.owned) {
+        interventions++;
+        if (entry.dirty) {
+            writebacks++;
+            shared.set_dirty(block);
+            cycles += shared.get_hit_time();
+        }
+    }
+
+    for (size_t other = 0; other < cores; other++) {
+        if (!(others & core_bit(other)))
+            continue;
+
+        drop(other, block);
+        invalidations++;
+        counters[other].invalidations_received++;
+        entry.lost |= core_bit(other);
+        lost_words[other][block] = 0;
+    }
+
+    entry.sharers &= core_bit(core);
+    entry.owned = entry.dirty = false;
+}
+
+void MulticoreSimulator::access(size_t core, size_t address, AccessType type) {
+    if (core >= cores)
+        throw std::runtime_error("No core " + std::to_string(core));
+
+    const bool write = type == AccessType::WRITE;
+    const size_t block = address / line_size;
+    size_t cycles = 0;
+
+    CoreCounters& c = counters[core];
+    c.accesses++;
+    if (write)
+        c.writes++;
+
+    std::vector<CacheLevel>& levels = private_levels[core];
+    size_t hit_level = levels.size();
+    for (size_t i = 0; i < levels.size(); i++) {
+        cycles += levels[i].get_hit_time();
+        if (levels[i].access(block)) {
+            c.hits[i]++;
+            hit_level = i;
+            break;
+        }
+        c.misses[i]++;
+    }
+
+    DirectoryEntry* entry;
+    if (hit_level < levels.size()) {
+        entry = &directory[block];
+
+        // S -> M: the other copies are invalidated through the directory.
+        // E -> M is silent.
+        if (write && !entry->owned) {
+            c.upgrades++;
+            cycles += shared.get_hit_time();
+            invalidate_others(core, block, *entry, cycles);
+        }
+    } else {
+        auto lost = lost_words[core].find(block);
+        if (lost != lost_words[core].end()) {
+            c.coherence_misses++;
+            if (lost->second & word_bit(address))
+                c.true_sharing++;
+            else
+                c.false_sharing++;
+            lost_words[core].erase(lost);
+        }
+
+        cycles += shared.get_hit_time();
+        if (shared.access(block)) {
+            c.shared_hits++;
+        } else {
+            c.shared_misses++;
+            memory_accesses++;
+            cycles += config.memory_penalty;
+            fill_shared(block, cycles);
+        }
+
+        entry = &directory[block];
+        entry->lost &= ~core_bit(core);
+
+        if (write) {
+            invalidate_others(core, block, *entry, cycles);
+        } else if (entry->owned) {
+            // The E/M owner supplies the line and drops to S.
+            interventions++;
+            if (entry->dirty) {
+                writebacks++;
+                shared.set_dirty(block);
+                cycles += shared.get_hit_time();
+            }
+            entry->owned = entry->dirty = false;
+        }
+
+        entry->owned = entry->sharers == 0;
+        entry->sharers |= core_bit(core);
+    }
+
+    if (write) {
+        entry->owned = entry->dirty = true;
+
+        uint64_t lost = entry->lost & ~core_bit(core);
+        for (size_t other = 0; lost; other++, lost >>= 1) {
+            if (lost & 1)
+                lost_words[other][block] |= word_bit(address);
+        }
+    }
+
+    // Fill the private levels above the one that hit, farthest first.
+    for (size_t i = hit_level; i-- > 0;)
+        fill_private(core, i, block, cycles);
+
+    c.cycles += cycles;
+}
+
+namespace {
+
+// Parses one trace on a host thread, keeping a few chunks ready ahead of
+// the simulation.
+class TraceFeed {
+private:
+    static constexpr size_t CHUNK_RECORDS = 1 << 14;
+    static constexpr size_t DEPTH = 4;
+
+    TraceReader reader;
+    std::mutex mutex;
+    std::condition_variable ready;   // a chunk arrived or the trace ended
+    std::condition_variable space;   // the simulation took a chunk
+    std::deque<std::vector<TraceRecord>> chunks;
+    bool done = false;
+    bool stop = false;
+    std::exception_ptr error;
+
+    std::vector<TraceRecord> current;
+    size_t pos = 0;
+    std::thread worker;
+
+    void run() {
+        try {
+            while (true) {
+                std::vector<TraceRecord> chunk(CHUNK_RECORDS);
+                chunk.resize(reader.read(chunk.data(), chunk.size()));
+
+                std::unique_lock<std::mutex> lock(mutex);
+                space.wait(lock, [&] { return stop || chunks.size() < DEPTH; });
+                if (stop)
+                    return;
+                if (chunk.empty()) {
+                    done = true;
+                    ready.notify_one();
+                    return;
+                }
+                chunks.push_back(std::move(chunk));
+                ready.notify_one();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            done = true;
+            ready.notify_one();
+        }
+    }
+
+public:
+    TraceFeed(const std::string& path, TraceFormat format)
+        : reader(path, format), worker(&TraceFeed::run, this) {}
+
+    ~TraceFeed() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        space.notify_one();
+        worker.join();
+    }
+
+    // Moves to the next record; false once the trace is exhausted.
+    bool advance() {
+        if (++pos < current.size())
+            return true;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [&] { return !chunks.empty() || done; });
+        if (chunks.empty()) {
+            if (error)
+                std::rethrow_exception(error);
+            return false;
+        }
+
+        current = std::move(chunks.front());
+        chunks.pop_front();
+        pos = 0;
+        space.notify_one();
+        return true;
+    }
+
+    const TraceRecord& record() const { return current[pos]; }
+};
+
+}
+
+size_t MulticoreSimulator::replay(const std::vector<std::string>& paths, TraceFormat format) {
+    if (paths.size() > cores)
+        throw std::runtime_error("More traces than cores");
+
+    std::vector<std::unique_ptr<TraceFeed>> feeds;
+    for (const std::string& path : paths)
+        feeds.push_back(std::make_unique<TraceFeed>(path, format));
+
+    using Next = std::pair<uint64_t, size_t>;   // (time, core)
+    std::priority_queue<Next, std::vector<Next>, std::greater<Next>> order;
+    for (size_t core = 0; core < feeds.size(); core++) {
+        if (feeds[core]->advance())
+            order.push({feeds[core]->record().time, core});
+    }
+
+    size_t total = 0;
+    while (!order.empty()) {
+        size_t core = order.top().second;
+        order.pop();
+
+        const TraceRecord& rec = feeds[core]->record();
+        access(core, rec.address, rec.write ? AccessType::WRITE : AccessType::READ);
+        total++;
+
+        if (feeds[core]->advance())
+            order.push({feeds[core]->record().time, core});
+    }
+    return total;
+}
+
+void MulticoreSimulator::stats() const {
+    const std::string& shared_name = config.levels.back().name;
+
+    for (size_t core = 0; core < cores; core++) {
+        const CoreCounters& c = counters[core];
+        std::cout << "Core " << core << ": accesses " << c.accesses
+                  << "  writes " << c.writes << "\n";
+
+        for (size_t i = 0; i < c.hits.size(); i++) {
+            size_t total = c.hits[i] + c.misses[i];
+            std::cout << "  " << config.levels[i].name << " hits: " << c.hits[i]
+                      << "  misses: " << c.misses[i]
+                      << "  hit rate: " << (total ? (double)c.hits[i] / total * 100.0 : 0.0)
+                      << "%\n";
+        }
+
+        std::cout << "  " << shared_name << " hits: " << c.shared_hits
+                  << "  misses: " << c.shared_misses << "\n"
+                  << "  coherence misses: " << c.coherence_misses
+                  << " (true sharing " << c.true_sharing
+                  << ", false sharing " << c.false_sharing << ")\n"
+                  << "  upgrades: " << c.upgrades
+                  << "  invalidations received: " << c.invalidations_received << "\n"
+                  << "  average access time: "
+                  << (c.accesses ? (double)c.cycles / c.accesses : 0.0) << " cycles\n";
+    }
+
+    std::cout << "\nCoherence (MESI): invalidations " << invalidations
+              << "  interventions " << interventions
+              << "  write-backs to " << shared_name << " " << writebacks << "\n"
+              << shared_name << " back-invalidations: " << back_invalidations << "\n"
+              << "Coherence misses: " << get_coherence_misses() << "\n"
+              << "Memory accesses: " << memory_accesses
+              << "  memory writes: " << memory_writes << "\n\n";
+}
+
+MesiState MulticoreSimulator::get_state(size_t core, size_t address) const {
+    auto it = directory.find(address / line_size);
+    if (core >= cores || it == directory.end() || !(it->second.sharers & core_bit(core)))
+        return MesiState::INVALID;
+
+    const DirectoryEntry& entry = it->second;
+    if (!entry.owned)
+        return MesiState::SHARED;
+    return entry.dirty ? MesiState::MODIFIED : MesiState::EXCLUSIVE;
+}
+
+bool MulticoreSimulator::is_cached(size_t core, size_t address) const {
+    return core < cores && holds(core, address / line_size);
+}
+
+size_t MulticoreSimulator::get_core_count() const {
+    return cores;
+}
+
+const CoreCounters& MulticoreSimulator::get_counters(size_t core) const {
+    return counters.at(core);
+}
+
+size_t MulticoreSimulator::get_coherence_misses() const {
+    size_t total = 0;
+    for (const CoreCounters& c : counters)
+        total += c.coherence_misses;
+    return total;
+}
+
+size_t MulticoreSimulator::get_invalidations() const {
+    return invalidations;
+}
+
+size_t MulticoreSimulator::get_interventions() const {
+    return interventions;
+}
+
+size_t MulticoreSimulator::get_writebacks() const {
+    return writebacks;
+}
+
+size_t MulticoreSimulator::get_back_invalidations() const {
+    return back_invalidations;
+}
+
+size_t MulticoreSimulator::get_memory_accesses() const {
+    return memory_accesses;
+}
+
+size_t MulticoreSimulator::get_memory_writes() const {
+    return memory_writes;
+}
@@ -0,0 +1,138 @@
+#include "cache/prefetcher.hpp"
+#include <algorithm>
+
+bool prefetch_policy_from_string(const std::string& s, PrefetchPolicy& out) {
+    if (s == "none")      { out = PrefetchPolicy::NONE; return true; }
+    if (s == "next-line") { out = PrefetchPolicy::NEXT_LINE; return true; }
+    if (s == "stride")    { out = PrefetchPolicy::STRIDE; return true; }
+    if (s == "stream")    { out = PrefetchPolicy::STREAM; return true; }
+    return false;
+}
+
+std::string prefetch_policy_name(PrefetchPolicy policy) {
+    switch (policy) {
+        case PrefetchPolicy::NONE:      return "none";
+        case PrefetchPolicy::NEXT_LINE: return "next-line";
+        case PrefetchPolicy::STRIDE:    return "stride";
+        case PrefetchPolicy::STREAM:    return "stream";
+    }
+    return "unknown";
+}
+
+// Adds block + step * k for k = 1..count, skipping anything below block 0.
+static void push_run(size_t block, int64_t step, size_t count, std::vector<size_t>& out) {
+    int64_t next = static_cast<int64_t>(block);
+    for (size_t k = 0; k < count; k++) {
+        next += step;
+        if (next < 0)
+            return;
+        out.push_back(static_cast<size_t>(next));
+    }
+}
+
+NextLinePrefetcher::NextLinePrefetcher(size_t d) : degree(std::max<size_t>(d, 1)) {}
+
+void NextLinePrefetcher::on_access(size_t block, bool trigger, std::vector<size_t>& out) {
+    if (trigger)
+        push_run(block, 1, degree, out);
+}
+
+StridePrefetcher::StridePrefetcher(size_t d)
+    : degree(std::max<size_t>(d, 1)),
+      table(TABLE_SIZE, Entry{false, 0, 0, 0, 0}) {}
+
+void StridePrefetcher::on_access(size_t block, bool, std::vector<size_t>& out) {
+    size_t zone = block / ZONE_BLOCKS;
+    Entry& e = table[zone % TABLE_SIZE];
+
+    if (!e.valid || e.zone != zone) {
+        e = {true, zone, block, 0, 0};
+        return;
+    }
+
+    int64_t delta = static_cast<int64_t>(block) - static_cast<int64_t>(e.last_block);
+    if (delta == 0)
+        return;
+
+    if (delta == e.stride) {
+        e.confidence = std::min<uint8_t>(e.confidence + 1, 3);
+    } else {
+        e.stride = delta;
+        e.confidence = 0;
+    }
+    e.last_block = block;
+
+    if (e.confidence > 0)
+        push_run(block, e.stride, degree, out);
+}
+
+StreamPrefetcher::StreamPrefetcher(size_t d)
+    : depth(std::max<size_t>(d, 1)),
+      streams(STREAMS, Stream{false, 0, 0, 0}),
+      clock(0) {}
+
+void StreamPrefetcher::on_access(size_t block, bool trigger, std::vector<size_t>& out) {
+    if (!trigger)
+        return;
+    clock++;
+
+    const int64_t window = static_cast<int64_t>(depth);
+    for (Stream& s : streams) {
+        if (!s.valid)
+            continue;
+
+        int64_t distance = static_cast<int64_t>(block) - static_cast<int64_t>(s.head);
+        if (distance == 0 || distance > window || distance < -window)
+            continue;
+
+        int direction = distance > 0 ? 1 : -1;
+        if (s.direction != 0 && s.direction != direction)
+            continue;
+
+        s.direction = direction;
+        s.head = block;
+        s.last_used = clock;
+        push_run(block, direction, depth, out);
+        return;
+    }
+
+    // No stream matched: start training a new one in the oldest slot.
+    auto victim = std::min_element(streams.begin(), streams.end(),
+        [](const Stream& a, const Stream& b) {
+            return !a.valid ? b.valid : (b.valid && a.last_used < b.last_used);
+        });
+    *victim = {true, block, 0, clock};
+}
+
+std::unique_ptr<Prefetcher> make_prefetcher(PrefetchPolicy policy, size_t degree) {
+    switch (policy) {
+        case PrefetchPolicy::NONE:
+            return nullptr;
+        case PrefetchPolicy::NEXT_LINE:
+            return std::make_unique<NextLinePrefetcher>(degree);
+        case PrefetchPolicy::STRIDE:
+            return std::make_unique<StridePrefetcher>(degree);
+        case PrefetchPolicy::STREAM:
+            return std::make_unique<StreamPrefetcher>(degree);
+    }
+    return nullptr;
+}
+
+PollutionTracker::PollutionTracker(size_t l) : limit(std::max<size_t>(l, 1)) {}
+
+void PollutionTracker::record(size_t block) {
+    if (!evicted.insert(block).second)
+        return;
+
+    order.push_back(block);
+    if (order.size() > limit) {
+        evicted.erase(order.front());
+        order.pop_front();
+    }
+}
+
+bool PollutionTracker::demand_miss(size_t block) {
+    // Its slot in order stays until it ages out, so the window is
+    // approximate.
+    return evicted.erase(block) != 0;
+}
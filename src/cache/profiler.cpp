@@ -0,0 +1,189 @@
+#include "cache/profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+SpaceSaving::SpaceSaving(size_t cap) : capacity(std::max<size_t>(cap, 1)), total(0) {
+    heap.reserve(capacity);
+}
+
+void SpaceSaving::swap_nodes(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    index[heap[a].block] = a;
+    index[heap[b].block] = b;
+}
+
+void SpaceSaving::sift_down(size_t i) {
+    while (true) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1, right = left + 1;
+        if (left < heap.size() && heap[left].count < heap[smallest].count)
+            smallest = left;
+        if (right < heap.size() && heap[right].count < heap[smallest].count)
+            smallest = right;
+        if (smallest == i)
+            return;
+        swap_nodes(i, smallest);
+        i = smallest;
+    }
+}
+
+void SpaceSaving::add(size_t block) {
+    total++;
+
+    auto it = index.find(block);
+    if (it != index.end()) {
+        heap[it->second].count++;
+        sift_down(it->second);
+        return;
+    }
+
+    // A new counter keeps count 1 at the top of the heap, which is already
+    // its place.
+    if (heap.size() < capacity) {
+        heap.push_back({block, 1, 0});
+        index[block] = heap.size() - 1;
+        for (size_t i = heap.size() - 1; i > 0 && heap[(i - 1) / 2].count > heap[i].count;
+             i = (i - 1) / 2)
+            swap_nodes(i, (i - 1) / 2);
+        return;
+    }
+
+    HotBlock& victim = heap.front();
+    index.erase(victim.block);
+    victim = {block, victim.count + 1, victim.count};
+    index[block] = 0;
+    sift_down(0);
+}
+
+std::vector<HotBlock> SpaceSaving::top(size_t k) const {
+    std::vector<HotBlock> sorted = heap;
+    std::sort(sorted.begin(), sorted.end(), [](const HotBlock& a, const HotBlock& b) {
+        return a.count != b.count ? a.count > b.count : a.block < b.block;
+    });
+    if (sorted.size() > k)
+        sorted.resize(k);
+    return sorted;
+}
+
+size_t SpaceSaving::get_total() const {
+    return total;
+}
+
+ReuseHistogram::ReuseHistogram(size_t tracked)
+    : tracked(std::max<size_t>(tracked, 1)), now(0), first_touches(0), aged_out(0) {}
+
+void ReuseHistogram::access(size_t block) {
+    now++;
+    auto it = last_use.find(block);
+    if (it == last_use.end()) {
+        first_touches++;
+        if (recent.size() == tracked) {
+            last_use.erase(recent.back().block);
+            recent.pop_back();
+            aged_out++;
+        }
+        recent.push_front({block, now});
+        last_use[block] = recent.begin();
+        return;
+    }
+
+    uint64_t interval = now - it->second->time;
+    it->second->time = now;
+    recent.splice(recent.begin(), recent, it->second);
+
+    size_t bucket = 0;
+    while (interval >>= 1)
+        bucket++;
+    if (bucket >= buckets.size())
+        buckets.resize(bucket + 1, 0);
+    buckets[bucket]++;
+}
+
+size_t ReuseHistogram::get_first_touches() const {
+    return first_touches;
+}
+
+size_t ReuseHistogram::get_aged_out() const {
+    return aged_out;
+}
+
+const std::vector<size_t>& ReuseHistogram::get_buckets() const {
+    return buckets;
+}
+
+CacheProfiler::CacheProfiler(const CacheConfig& config, size_t counters) {
+    for (const auto& level : config.levels) {
+        names.push_back(level.name);
+        line_sizes.push_back(level.line_size);
+        miss_blocks.emplace_back(counters);
+        reuse.emplace_back();
+    }
+}
+
+void CacheProfiler::on_access(size_t level, size_t block, bool hit) {
+    reuse[level].access(block);
+    if (!hit)
+        miss_blocks[level].add(block);
+}
+
+const SpaceSaving& CacheProfiler::get_miss_blocks(size_t level) const {
+    return miss_blocks.at(level);
+}
+
+const ReuseHistogram& CacheProfiler::get_reuse(size_t level) const {
+    return reuse.at(level);
+}
+
+void CacheProfiler::report(std::ostream& out, size_t k) const {
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+
+    for (size_t i = 0; i < names.size(); i++) {
+        out << names[i] << " hottest missing blocks (of "
+            << miss_blocks[i].get_total() << " misses):\n";
+        for (const HotBlock& hot : miss_blocks[i].top(k)) {
+            out << "  0x" << std::hex << hot.block * line_sizes[i] << std::dec
+                << "  misses: " << hot.count;
+            if (hot.error)
+                out << " (at most " << hot.error << " over)";
+            out << "\n";
+        }
+
+        const ReuseHistogram& h = reuse[i];
+        out << names[i] << " reuse intervals (first touches: " << h.get_first_touches();
+        if (h.get_aged_out())
+            out << ", " << h.get_aged_out() << " blocks aged out";
+        out << "):\n";
+        for (size_t b = 0; b < h.get_buckets().size(); b++) {
+            if (h.get_buckets()[b])
+                out << "  [" << (size_t(1) << b) << ", " << (size_t(2) << b) << "): "
+                    << h.get_buckets()[b] << "\n";
+        }
+        out << "\n";
+    }
+
+    out.copyfmt(flags);
+}
+
+void CacheProfiler::export_csv(const std::string& path, size_t k) const {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Cannot write " + path);
+
+    out << "level,address,misses,error\n";
+    for (size_t i = 0; i < names.size(); i++) {
+        for (const HotBlock& hot : miss_blocks[i].top(k))
+            out << names[i] << "," << hot.block * line_sizes[i] << ","
+                << hot.count << "," << hot.error << "\n";
+    }
+
+    out << "\nlevel,interval_from,interval_to,count\n";
+    for (size_t i = 0; i < names.size(); i++) {
+        out << names[i] << ",first,first," << reuse[i].get_first_touches() << "\n";
+        const std::vector<size_t>& buckets = reuse[i].get_buckets();
+        for (size_t b = 0; b < buckets.size(); b++)
+            out << names[i] << "," << (size_t(1) << b) << "," << (size_t(2) << b) << ","
+                << buckets[b] << "\n";
+    }
+}
@@ -0,0 +1,106 @@
+#include "cache/s3fifo_policy.hpp"
+#include <algorithm>
+
+S3FifoPolicy::S3FifoPolicy(size_t capacity)
+    : small_capacity(std::max<size_t>(capacity / 10, 1)),
+      ghost_capacity(std::max<size_t>(capacity - capacity / 10, 1)) {
+    entries.reserve(capacity);
+}
+
+size_t S3FifoPolicy::take_slot(size_t block_id, bool in_main) {
+    if (free_slots.empty()) {
+        entries.push_back({block_id, 0, in_main});
+        return entries.size() - 1;
+    }
+
+    size_t slot = free_slots.back();
+    free_slots.pop_back();
+    entries[slot] = {block_id, 0, in_main};
+    return slot;
+}
+
+void S3FifoPolicy::on_insert(CacheBlock& blk) {
+    auto it = ghost_index.find(blk.block_id);
+    if (it != ghost_index.end()) {
+        ghost.erase(it->second);
+        ghost_index.erase(it);
+
+        blk.pos = main.insert(main.end(), take_slot(blk.block_id, true));
+        return;
+    }
+
+    blk.pos = small.insert(small.end(), take_slot(blk.block_id, false));
+}
+
+void S3FifoPolicy::on_hit(CacheBlock& blk) {
+    uint8_t& f = entries[*blk.pos].freq;
+    if (f < MAX_FREQ)
+        f++;
+}
+
+// Blocks move between queues by splicing, so the iterators the level keeps
+// in CacheBlock::pos stay valid. Each reinsertion lowers a counter, which
+// bounds the work per eviction to a constant on average.
+size_t S3FifoPolicy::evict_main() {
+    while (true) {
+        size_t slot = main.front();
+        uint8_t& f = entries[slot].freq;
+
+        if (f > 0) {
+            f--;
+            main.splice(main.end(), main, main.begin());
+            continue;
+        }
+
+        main.pop_front();
+        free_slots.push_back(slot);
+        return entries[slot].block_id;
+    }
+}
+
+size_t S3FifoPolicy::evict(size_t) {
+    while (small.size() >= small_capacity || main.empty()) {
+        if (small.empty())
+            break;
+
+        size_t slot = small.front();
+
+        // Re-referenced while in S: promote instead of evicting.
+        Entry& entry = entries[slot];
+        if (entry.freq > 0) {
+            entry.freq = 0;
+            entry.in_main = true;
+            main.splice(main.end(), small, small.begin());
+            continue;
+        }
+
+        small.pop_front();
+        free_slots.push_back(slot);
+
+        size_t id = entry.block_id;
+        ghost_index[id] = ghost.insert(ghost.end(), id);
+        if (ghost.size() > ghost_capacity) {
+            ghost_index.erase(ghost.front());
+            ghost.pop_front();
+        }
+        return id;
+    }
+
+    return evict_main();
+}
+
+void S3FifoPolicy::on_remove(CacheBlock& blk) {
+    size_t slot = *blk.pos;
+    (entries[slot].in_main ? main : small).erase(blk.pos);
+    free_slots.push_back(slot);
+}
+
+std::vector<size_t> S3FifoPolicy::eviction_order() const {
+    std::vector<size_t> ids;
+    ids.reserve(small.size() + main.size());
+    for (size_t slot : small)
+        ids.push_back(entries[slot].block_id);
+    for (size_t slot : main)
+        ids.push_back(entries[slot].block_id);
+    return ids;
+}
@@ -0,0 +1,134 @@
+#include "cache/sampling.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+
+#include "cache/cache_simulator.hpp"
+
+uint64_t sample_hash(uint64_t unit) {
+    // splitmix64 finaliser
+    unit += 0x9e3779b97f4a7c15ull;
+    unit = (unit ^ (unit >> 30)) * 0xbf58476d1ce4e5b9ull;
+    unit = (unit ^ (unit >> 27)) * 0x94d049bb133111ebull;
+    return unit ^ (unit >> 31);
+}
+
+SampleEstimate ratio_estimate(const std::vector<double>& num, const std::vector<double>& den,
+                              double scale) {
+    double sum_num = 0, sum_den = 0;
+    for (size_t g = 0; g < num.size(); g++) {
+        sum_num += num[g];
+        sum_den += den[g];
+    }
+    if (sum_den == 0)
+        return {0.0, 0.0};
+
+    double ratio = sum_num / sum_den;
+    size_t n = num.size();
+    if (n < 2)
+        return {ratio * scale, 0.0};
+
+    double residuals = 0;
+    for (size_t g = 0; g < n; g++) {
+        double r = num[g] - ratio * den[g];
+        residuals += r * r;
+    }
+
+    double mean_den = sum_den / n;
+    double variance = residuals / (n * (n - 1) * mean_den * mean_den);
+    return {ratio * scale, 1.96 * std::sqrt(variance) * scale};
+}
+
+CacheConfig scale_for_sampling(const CacheConfig& config, size_t one_in) {
+    if (one_in == 0 || (one_in & (one_in - 1)) != 0)
+        throw std::runtime_error("Sampling rate must be 1 in a power of two");
+
+    CacheConfig scaled = config;
+    for (CacheLevelConfig& level : scaled.levels) {
+        size_t sets = level.ways == 0 || level.ways >= level.capacity ? 1 : level.capacity / level.ways;
+        if (sets >= one_in) {
+            level.capacity /= one_in;
+        } else {
+            // Too few sets to divide: keep the lines left as one set.
+            level.capacity = std::max<size_t>(1, level.capacity / one_in);
+            level.ways = 0;
+        }
+    }
+    return scaled;
+}
+
+// Replays the trace into sim and returns the seconds it took.
+static double replay(CacheSimulator& sim, const std::string& path, TraceFormat format) {
+    TraceReader reader(path, format);
+    std::vector<TraceRecord> chunk(1 << 16);
+
+    auto start = std::chrono::steady_clock::now();
+    while (size_t n = reader.read(chunk.data(), chunk.size())) {
+        for (size_t i = 0; i < n; i++)
+            sim.access(chunk[i].address, chunk[i].write ? AccessType::WRITE : AccessType::READ);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+SamplingValidation validate_sampling(const CacheConfig& config, const std::string& path,
+                                     TraceFormat format, size_t one_in) {
+    CacheConfig exact = config;
+    exact.sample_one_in = 1;
+    CacheSimulator full(exact);
+
+    CacheConfig scaled = config;
+    scaled.sample_one_in = one_in;
+    CacheSimulator sampled(scaled);
+
+    SamplingValidation v;
+    v.one_in = one_in;
+    v.full_seconds = replay(full, path, format);
+    v.sampled_seconds = replay(sampled, path, format);
+    v.accesses = full.get_total_accesses();
+    v.sampled = sampled.get_total_accesses();
+
+    for (size_t i = 0; i < full.get_level_count(); i++) {
+        v.level_names.push_back(config.levels[i].name);
+        v.full_level_hit_rates.push_back(full.get_hit_rate(i));
+        v.level_hit_rates.push_back(sampled.get_hit_rate_estimate(i));
+    }
+    v.full_hit_rate = full.get_overall_hit_rate();
+    v.hit_rate = sampled.get_overall_hit_rate_estimate();
+    v.full_avg_access_time = full.get_avg_access_time();
+    v.avg_access_time = sampled.get_avg_access_time_estimate();
+    return v;
+}
+
+static void print_row(std::ostream& out, const std::string& name, double exact,
+                      const SampleEstimate& e, const char* unit) {
+    bool inside = std::fabs(e.value - exact) <= e.half_width;
+    out << "  " << std::left << std::setw(20) << name << std::right
+        << std::setw(10) << exact << unit
+        << std::setw(10) << e.value << unit << " +/- " << e.half_width << unit
+        << "  error " << e.value - exact << unit
+        << (inside ? "" : "  (outside interval)") << "\n";
+}
+
+void print_sampling_validation(const SamplingValidation& v, std::ostream& out) {
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+
+    out << std::fixed << std::setprecision(3)
+        << "Sampling 1 in " << v.one_in << " lines: " << v.sampled << " of "
+        << v.accesses << " accesses simulated\n"
+        << "  full " << v.full_seconds << " s, sampled " << v.sampled_seconds << " s ("
+        << (v.sampled_seconds > 0 ? v.full_seconds / v.sampled_seconds : 0.0) << "x)\n"
+        << "  " << std::left << std::setw(20) << "" << std::right
+        << std::setw(11) << "full" << std::setw(11) << "sampled" << "\n";
+
+    for (size_t i = 0; i < v.level_names.size(); i++)
+        print_row(out, v.level_names[i] + " hit rate", v.full_level_hit_rates[i],
+                  v.level_hit_rates[i], "%");
+    print_row(out, "overall hit rate", v.full_hit_rate, v.hit_rate, "%");
+    print_row(out, "avg access time", v.full_avg_access_time, v.avg_access_time, " cy");
+
+    out.copyfmt(flags);
+}
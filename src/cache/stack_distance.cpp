@@ -0,0 +1,155 @@
+#include "cache/stack_distance.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+static constexpr size_t MIN_TREE_SIZE = 1024;
+
+StackDistanceAnalyzer::StackDistanceAnalyzer(size_t block)
+    : block_size(block ? block : 1),
+      tree(MIN_TREE_SIZE + 1, 0),
+      now(0),
+      accesses(0),
+      cold_misses(0) {}
+
+void StackDistanceAnalyzer::add(size_t pos, long long delta) {
+    for (pos++; pos < tree.size(); pos += pos & (~pos + 1))
+        tree[pos] += delta;
+}
+
+// Number of marks at timestamps [0, pos].
+size_t StackDistanceAnalyzer::prefix(size_t pos) const {
+    size_t sum = 0;
+    for (pos++; pos > 0; pos -= pos & (~pos + 1))
+        sum += tree[pos];
+    return sum;
+}
+
+// Renumbers the live timestamps 0..M-1 in order and rebuilds the tree with
+// room for as many new accesses again.
+void StackDistanceAnalyzer::compact() {
+    std::vector<std::pair<size_t, size_t>> by_time;
+    by_time.reserve(last_access.size());
+    for (const auto& entry : last_access)
+        by_time.emplace_back(entry.second, entry.first);
+    std::sort(by_time.begin(), by_time.end());
+
+    size_t size = std::max(MIN_TREE_SIZE, 2 * by_time.size());
+    tree.assign(size + 1, 0);
+
+    for (size_t i = 0; i < by_time.size(); i++) {
+        last_access[by_time[i].second] = i;
+        add(i, 1);
+    }
+    now = by_time.size();
+}
+
+void StackDistanceAnalyzer::access(size_t address) {
+    size_t block = address / block_size;
+    accesses++;
+
+    if (now + 1 >= tree.size())
+        compact();
+
+    auto it = last_access.find(block);
+    if (it == last_access.end()) {
+        cold_misses++;
+        last_access.emplace(block, now);
+    } else {
+        size_t distance = last_access.size() - prefix(it->second);
+        if (distance >= histogram.size())
+            histogram.resize(distance + 1, 0);
+        histogram[distance]++;
+
+        add(it->second, -1);
+        it->second = now;
+    }
+
+    add(now, 1);
+    now++;
+}
+
+size_t StackDistanceAnalyzer::get_accesses() const {
+    return accesses;
+}
+
+size_t StackDistanceAnalyzer::get_cold_misses() const {
+    return cold_misses;
+}
+
+size_t StackDistanceAnalyzer::get_distinct_blocks() const {
+    return last_access.size();
+}
+
+const std::vector<size_t>& StackDistanceAnalyzer::get_histogram() const {
+    return histogram;
+}
+
+double StackDistanceAnalyzer::miss_ratio(size_t capacity) const {
+    if (accesses == 0)
+        return 0.0;
+
+    size_t misses = cold_misses;
+    for (size_t d = capacity; d < histogram.size(); d++)
+        misses += histogram[d];
+
+    return (double)misses / accesses;
+}
+
+std::vector<double> StackDistanceAnalyzer::miss_ratio_curve() const {
+    std::vector<double> curve(last_access.size(), 0.0);
+    if (accesses == 0)
+        return curve;
+
+    // Walk capacities from the largest down; a capacity of c misses every
+    // reuse at distance c or more.
+    size_t misses = cold_misses;
+    for (size_t d = curve.size(); d < histogram.size(); d++)
+        misses += histogram[d];
+
+    for (size_t c = curve.size(); c >= 1; c--) {
+        curve[c - 1] = (double)misses / accesses;
+        if (c - 1 < histogram.size())
+            misses += histogram[c - 1];
+    }
+    return curve;
+}
+
+void StackDistanceAnalyzer::stats() const {
+    std::cout << "Total accesses: " << accesses << "\n";
+    std::cout << "Distinct blocks: " << last_access.size()
+              << " (block size " << block_size << ")\n";
+    std::cout << "Cold misses: " << cold_misses << "\n\n";
+
+    std::cout << "Reuse distance histogram:\n";
+    for (size_t lo = 0; lo < histogram.size(); lo = lo ? lo * 2 : 1) {
+        size_t hi = lo ? lo * 2 : 1;
+        size_t count = 0;
+        for (size_t d = lo; d < hi && d < histogram.size(); d++)
+            count += histogram[d];
+        std::cout << "  [" << lo << ", " << hi << "): " << count << "\n";
+    }
+
+    std::cout << "\nLRU miss ratio:\n";
+    for (size_t c = 1; c <= last_access.size(); c *= 2)
+        std::cout << "  " << c << " blocks: " << miss_ratio(c) * 100.0 << "%\n";
+}
+
+void StackDistanceAnalyzer::export_csv(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out)
+        throw std::runtime_error("Cannot write " + path);
+
+    out << "capacity_blocks,miss_ratio\n";
+    std::vector<double> curve = miss_ratio_curve();
+    for (size_t c = 0; c < curve.size(); c++)
+        out << c + 1 << "," << curve[c] << "\n";
+
+    out << "\nreuse_distance,count\n";
+    for (size_t d = 0; d < histogram.size(); d++) {
+        if (histogram[d])
+            out << d << "," << histogram[d] << "\n";
+    }
+}
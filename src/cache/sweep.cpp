@@ -0,0 +1,167 @@
+#include "cache/sweep.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "cache/cache_simulator.hpp"
+
+static constexpr size_t SWEEP_CHUNK_RECORDS = 1 << 16;
+static constexpr size_t SWEEP_CHUNKS_AHEAD = 4;
+
+static const CachePolicy ALL_POLICIES[] = {
+    CachePolicy::FIFO, CachePolicy::LRU, CachePolicy::LFU, CachePolicy::LFU_AGING,
+    CachePolicy::ARC, CachePolicy::TWO_Q, CachePolicy::CLOCK, CachePolicy::S3_FIFO,
+};
+
+void CacheSweep::add(const std::string& name, const CacheConfig& config) {
+    config.validate();
+    names.push_back(name);
+    configs.push_back(config);
+}
+
+void CacheSweep::add_policy_grid(const CacheConfig& base, const std::vector<size_t>& scales) {
+    for (size_t scale : scales) {
+        for (CachePolicy policy : ALL_POLICIES) {
+            CacheConfig config = base;
+            config.set_policy(policy);
+            for (CacheLevelConfig& level : config.levels)
+                level.capacity *= scale;
+            add(cache_policy_name(policy) + " x" + std::to_string(scale), config);
+        }
+    }
+}
+
+size_t CacheSweep::size() const {
+    return configs.size();
+}
+
+std::vector<SweepResult> CacheSweep::run(const std::string& path, TraceFormat format,
+                                         size_t threads) const {
+    if (configs.empty())
+        throw std::runtime_error("Sweep has no configurations");
+
+    std::vector<std::unique_ptr<CacheSimulator>> sims;
+    for (const CacheConfig& config : configs)
+        sims.push_back(std::make_unique<CacheSimulator>(config));
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, sims.size());
+
+    TraceReader reader(path, format);
+
+    // Worker w runs simulators w, w + threads, ...; each has its own queue
+    // holding the chunks it has not simulated yet. A chunk is freed once
+    // every worker has dropped it.
+    using Chunk = std::shared_ptr<const std::vector<TraceRecord>>;
+    std::mutex mutex;
+    std::condition_variable ready;   // a chunk was queued or decoding ended
+    std::condition_variable space;   // a worker took a chunk
+    std::vector<std::deque<Chunk>> queues(threads);
+    bool done = false;
+
+    auto worker = [&](size_t id) {
+        while (true) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return !queues[id].empty() || done; });
+                if (queues[id].empty())
+                    return;
+                chunk = std::move(queues[id].front());
+                queues[id].pop_front();
+            }
+            space.notify_one();
+
+            for (size_t s = id; s < sims.size(); s += threads) {
+                CacheSimulator& sim = *sims[s];
+                for (const TraceRecord& rec : *chunk)
+                    sim.access(rec.address, rec.write ? AccessType::WRITE : AccessType::READ);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t id = 0; id < threads; id++)
+        pool.emplace_back(worker, id);
+
+    auto finish = [&] {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        ready.notify_all();
+        for (std::thread& t : pool)
+            t.join();
+    };
+
+    size_t total = 0;
+    try {
+        while (true) {
+            auto chunk = std::make_shared<std::vector<TraceRecord>>(SWEEP_CHUNK_RECORDS);
+            chunk->resize(reader.read(chunk->data(), chunk->size()));
+            if (chunk->empty())
+                break;
+            total += chunk->size();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            space.wait(lock, [&] {
+                return std::all_of(queues.begin(), queues.end(), [](const std::deque<Chunk>& q) {
+                    return q.size() < SWEEP_CHUNKS_AHEAD;
+                });
+            });
+            for (auto& queue : queues)
+                queue.push_back(chunk);
+            lock.unlock();
+            ready.notify_all();
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+
+    std::vector<SweepResult> results;
+    for (size_t i = 0; i < sims.size(); i++) {
+        const CacheSimulator& sim = *sims[i];
+        SweepResult result;
+        result.name = names[i];
+        for (size_t l = 0; l < sim.get_level_count(); l++) {
+            result.level_names.push_back(configs[i].levels[l].name);
+            result.level_hit_rates.push_back(sim.get_hit_rate(l));
+        }
+        result.hit_rate = sim.get_overall_hit_rate();
+        result.avg_access_time = sim.get_avg_access_time();
+        result.memory_accesses = sim.get_memory_accesses();
+        result.accesses = total;
+        results.push_back(result);
+    }
+    return results;
+}
+
+void print_sweep(const std::vector<SweepResult>& results, std::ostream& out) {
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+
+    out << std::left << std::setw(18) << "config" << std::right
+        << std::setw(10) << "hit rate" << std::setw(12) << "avg cycles"
+        << std::setw(12) << "memory" << "  per level\n";
+
+    out << std::fixed << std::setprecision(2);
+    for (const SweepResult& r : results) {
+        out << std::left << std::setw(18) << r.name << std::right
+            << std::setw(9) << r.hit_rate << "%"
+            << std::setw(12) << r.avg_access_time
+            << std::setw(12) << r.memory_accesses << " ";
+        for (size_t l = 0; l < r.level_names.size(); l++)
+            out << " " << r.level_names[l] << " " << r.level_hit_rates[l] << "%";
+        out << "\n";
+    }
+
+    out.copyfmt(flags);
+}
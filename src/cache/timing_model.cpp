@@ -0,0 +1,128 @@
+#include "cache/timing_model.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+bool timing_model_from_string(const std::string& s, TimingModel& out) {
+    if (s == "blocking")     { out = TimingModel::BLOCKING; return true; }
+    if (s == "non-blocking") { out = TimingModel::NON_BLOCKING; return true; }
+    return false;
+}
+
+std::string timing_model_name(TimingModel model) {
+    return model == TimingModel::BLOCKING ? "blocking" : "non-blocking";
+}
+
+MshrFile::MshrFile(size_t cap) : capacity(std::max<size_t>(cap, 1)) {
+    entries.reserve(capacity);
+}
+
+uint64_t MshrFile::free_at(uint64_t now) const {
+    if (entries.size() < capacity)
+        return now;
+
+    uint64_t earliest = UINT64_MAX;
+    for (const Entry& e : entries) {
+        if (e.ready <= now)
+            return now;
+        earliest = std::min(earliest, e.ready);
+    }
+    return earliest;
+}
+
+uint64_t MshrFile::pending(size_t block, uint64_t now) const {
+    for (const Entry& e : entries) {
+        if (e.block == block && e.ready > now)
+            return e.ready;
+    }
+    return 0;
+}
+
+void MshrFile::allocate(size_t block, uint64_t ready, uint64_t now) {
+    for (Entry& e : entries) {
+        if (e.ready <= now) {
+            e = {block, ready};
+            return;
+        }
+    }
+    if (entries.size() == capacity)
+        throw std::runtime_error("No free MSHR");
+    entries.push_back({block, ready});
+}
+
+NonBlockingTimer::NonBlockingTimer(const std::vector<size_t>& sizes,
+                                   const std::vector<size_t>& registers, size_t width)
+    : issue_width(std::max<size_t>(width, 1)),
+      issue_cycle(0),
+      issued_this_cycle(0),
+      line_sizes(sizes) {
+    for (size_t n : registers)
+        mshrs.emplace_back(n);
+}
+
+void NonBlockingTimer::access(size_t address, size_t hit_level, size_t latency) {
+    if (issued_this_cycle == issue_width) {
+        issue_cycle++;
+        issued_this_cycle = 0;
+    }
+
+    // Every level missed needs a register for the fill.
+    uint64_t t = issue_cycle;
+    for (size_t i = 0; i < hit_level && i < mshrs.size(); i++)
+        t = std::max(t, mshrs[i].free_at(t));
+    if (t > issue_cycle) {
+        counters.mshr_stalls++;
+        counters.stall_cycles += t - issue_cycle;
+        issue_cycle = t;
+        issued_this_cycle = 0;
+    }
+    issued_this_cycle++;
+
+    uint64_t done = t + latency;
+    if (hit_level < mshrs.size()) {
+        uint64_t ready = mshrs[hit_level].pending(address / line_sizes[hit_level], t);
+        if (ready) {
+            counters.merged++;
+            done = std::max(done, ready);
+        }
+    }
+
+    for (size_t i = 0; i < hit_level && i < mshrs.size(); i++) {
+        mshrs[i].allocate(address / line_sizes[i], done, t);
+        counters.primary_misses++;
+    }
+
+    counters.accesses++;
+    counters.latency += done - t;
+    counters.elapsed = std::max(counters.elapsed, done);
+}
+
+const TimingCounters& NonBlockingTimer::get_counters() const {
+    return counters;
+}
+
+uint64_t NonBlockingTimer::get_issue_cycle() const {
+    return issue_cycle;
+}
+
+double NonBlockingTimer::get_cycles_per_access() const {
+    return counters.accesses == 0 ? 0.0 : (double)counters.elapsed / counters.accesses;
+}
+
+double NonBlockingTimer::get_mlp() const {
+    return counters.elapsed == 0 ? 0.0 : (double)counters.latency / counters.elapsed;
+}
+
+void NonBlockingTimer::stats(std::ostream& out, size_t serial_cycles) const {
+    out << "Non-blocking timing (issue width " << issue_width << "):\n"
+        << "  elapsed cycles: " << counters.elapsed
+        << "  serial cycles: " << serial_cycles;
+    if (counters.elapsed > 0)
+        out << "  (" << (double)serial_cycles / counters.elapsed << "x)";
+    out << "\n  average latency: "
+        << (counters.accesses ? (double)counters.latency / counters.accesses : 0.0)
+        << " cycles  achieved MLP: " << get_mlp() << "\n"
+        << "  MSHR fills: " << counters.primary_misses
+        << "  merged: " << counters.merged
+        << "  stalls: " << counters.mshr_stalls
+        << " (" << counters.stall_cycles << " cycles)\n\n";
+}
@@ -0,0 +1,339 @@
+#include "cache/trace_reader.hpp"
+#include "cache/compressed_trace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+bool trace_format_from_string(const std::string& s, TraceFormat& out) {
+    if (s == "text")   { out = TraceFormat::Text; return true; }
+    if (s == "lackey") { out = TraceFormat::Lackey; return true; }
+    if (s == "binary") { out = TraceFormat::Binary; return true; }
+    if (s == "compressed") { out = TraceFormat::Compressed; return true; }
+    return false;
+}
+
+static bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+TraceFormat guess_trace_format(const std::string& path) {
+    if (ends_with(path, ".bin") || ends_with(path, ".raw"))
+        return TraceFormat::Binary;
+    if (ends_with(path, ".lackey") || ends_with(path, ".vg"))
+        return TraceFormat::Lackey;
+    if (ends_with(path, ".mtc"))
+        return TraceFormat::Compressed;
+    return TraceFormat::Text;
+}
+
+TraceReader::TraceReader(const std::string& path, TraceFormat fmt)
+    : file(std::fopen(path.c_str(), "rb")),
+      format(fmt),
+      buffer(BUFFER_SIZE),
+      begin(0),
+      end(0),
+      eof(false),
+      bytes_read(0),
+      records_read(0),
+      pending_store(false),
+      pending_address(0),
+      trace_flags(0),
+      block_shift(0),
+      decoded_pos(0) {
+    if (!file)
+        throw std::runtime_error("Cannot open trace: " + path);
+
+    if (format == TraceFormat::Compressed) {
+        try {
+            CompressedTraceHeader header = read_compressed_header(file);
+            trace_flags = header.flags;
+            block_shift = header.block_shift;
+        } catch (...) {
+            std::fclose(file);
+            throw;
+        }
+        bytes_read += 24;
+    }
+}
+
+TraceReader::~TraceReader() {
+    if (file)
+        std::fclose(file);
+}
+
+// Moves the unparsed tail to the front of the buffer and reads as much as
+// fits behind it. Returns false when nothing new could be read.
+bool TraceReader::refill() {
+    if (eof)
+        return false;
+
+    size_t left = end - begin;
+    std::memmove(buffer.data(), buffer.data() + begin, left);
+    begin = 0;
+    end = left;
+
+    size_t n = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+    if (n == 0) {
+        eof = true;
+        return false;
+    }
+
+    end += n;
+    bytes_read += n;
+    return true;
+}
+
+// Returns the next line without copying it; the last line may lack '\n'.
+bool TraceReader::next_line(const char*& line, const char*& line_end) {
+    while (true) {
+        const char* start = buffer.data() + begin;
+        const char* nl = static_cast<const char*>(
+            std::memchr(start, '\n', end - begin));
+
+        if (nl) {
+            line = start;
+            line_end = nl;
+            begin = nl - buffer.data() + 1;
+            return true;
+        }
+
+        // A single line longer than the buffer is not a valid trace line.
+        if (end - begin == buffer.size())
+            throw std::runtime_error("Trace line too long");
+
+        if (!refill()) {
+            if (begin == end)
+                return false;
+            line = buffer.data() + begin;
+            line_end = buffer.data() + end;
+            begin = end;
+            return true;
+        }
+    }
+}
+
+static const char* skip_spaces(const char* p, const char* e) {
+    while (p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static const char* parse_hex(const char* p, const char* e, uint64_t& value) {
+    const char* start = p;
+    value = 0;
+    for (int d; p < e && (d = hex_digit(*p)) >= 0; p++)
+        value = value * 16 + d;
+    return p == start ? nullptr : p;
+}
+
+static const char* parse_number(const char* p, const char* e, uint64_t& value) {
+    if (e - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        return parse_hex(p + 2, e, value);
+
+    const char* start = p;
+    value = 0;
+    for (; p < e && *p >= '0' && *p <= '9'; p++)
+        value = value * 10 + (*p - '0');
+    return p == start ? nullptr : p;
+}
+
+bool TraceReader::parse_text(const char* p, const char* e, TraceRecord& rec) const {
+    p = skip_spaces(p, e);
+    if (p == e || *p == '#')
+        return false;
+
+    rec.write = false;
+    if (*p == 'R' || *p == 'r' || *p == 'L' || *p == 'l') {
+        p = skip_spaces(p + 1, e);
+    } else if (*p == 'W' || *p == 'w' || *p == 'S' || *p == 's') {
+        rec.write = true;
+        p = skip_spaces(p + 1, e);
+    }
+
+    p = parse_number(p, e, rec.address);
+    if (!p)
+        throw std::runtime_error("Malformed trace line");
+
+    p = skip_spaces(p, e);
+    if (p != e && *p != '#' && !parse_number(p, e, rec.time))
+        throw std::runtime_error("Malformed trace line");
+    return true;
+}
+
+// Lackey lines look like "I  04016d4c,3", " L 1ffefffd08,8", " S ...",
+// " M ..."; anything else (the "==pid==" banner) is skipped.
+bool TraceReader::parse_lackey(const char* p, const char* e, TraceRecord& rec) {
+    p = skip_spaces(p, e);
+    if (e - p < 2)
+        return false;
+
+    char op = *p;
+    if (op != 'L' && op != 'S' && op != 'M')
+        return false;
+
+    p = skip_spaces(p + 1, e);
+    if (!parse_hex(p, e, rec.address))
+        return false;
+
+    rec.write = op == 'S';
+    if (op == 'M') {
+        pending_store = true;
+        pending_address = rec.address;
+    }
+    return true;
+}
+
+// Makes at least `bytes` unparsed bytes available in the buffer.
+bool TraceReader::ensure(size_t bytes) {
+    while (end - begin < bytes) {
+        if (!refill())
+            return false;
+    }
+    return true;
+}
+
+bool TraceReader::decode_next_chunk() {
+    if (eof && begin == end)
+        return false;
+    if (!ensure(8))
+        throw std::runtime_error("Truncated compressed trace");
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer.data() + begin);
+    uint32_t bytes = p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+    uint32_t records = p[4] | p[5] << 8 | p[6] << 16 | uint32_t(p[7]) << 24;
+
+    // The end marker; the index and footer that follow are not needed for
+    // a sequential read.
+    if (records == 0) {
+        eof = true;
+        begin = end;
+        return false;
+    }
+
+    if (8 + size_t(bytes) > buffer.size())
+        throw std::runtime_error("Compressed trace chunk too large");
+    if (!ensure(8 + size_t(bytes)))
+        throw std::runtime_error("Truncated compressed trace");
+
+    CompressedTraceHeader header{COMPRESSED_TRACE_VERSION, trace_flags, block_shift};
+    decoded.resize(records);
+    decode_trace_chunk(reinterpret_cast<const uint8_t*>(buffer.data() + begin + 8),
+                       bytes, records, header, decoded.data());
+    decoded_pos = 0;
+    begin += 8 + size_t(bytes);
+    return true;
+}
+
+size_t TraceReader::read(TraceRecord* out, size_t max) {
+    size_t n = 0;
+
+    if (format == TraceFormat::Compressed) {
+        while (n < max) {
+            if (decoded_pos == decoded.size() && !decode_next_chunk())
+                break;
+
+            size_t take = std::min(decoded.size() - decoded_pos, max - n);
+            std::memcpy(out + n, decoded.data() + decoded_pos, take * sizeof(TraceRecord));
+            decoded_pos += take;
+            n += take;
+        }
+        for (size_t i = 0; i < n; i++)
+            out[i].time = records_read + i;
+        records_read += n;
+        return n;
+    }
+
+    if (format == TraceFormat::Binary) {
+        while (n < max) {
+            size_t available = (end - begin) / sizeof(uint64_t);
+            if (available == 0 && !refill())
+                break;
+            available = (end - begin) / sizeof(uint64_t);
+            if (available == 0)
+                continue;
+
+            size_t take = std::min(available, max - n);
+            for (size_t i = 0; i < take; i++) {
+                std::memcpy(&out[n].address,
+                            buffer.data() + begin + i * sizeof(uint64_t),
+                            sizeof(uint64_t));
+                out[n].write = false;
+                out[n].time = records_read + n;
+                n++;
+            }
+            begin += take * sizeof(uint64_t);
+        }
+        records_read += n;
+        return n;
+    }
+
+    const char* line;
+    const char* line_end;
+
+    while (n < max) {
+        if (pending_store) {
+            out[n] = {pending_address, true, records_read + n};
+            n++;
+            pending_store = false;
+            continue;
+        }
+
+        if (!next_line(line, line_end))
+            break;
+
+        out[n].time = records_read + n;
+        bool ok = format == TraceFormat::Text
+            ? parse_text(line, line_end, out[n])
+            : parse_lackey(line, line_end, out[n]);
+        if (ok)
+            n++;
+    }
+
+    records_read += n;
+    return n;
+}
+
+size_t TraceReader::get_bytes_read() const {
+    return bytes_read;
+}
+
+size_t TraceReader::get_records_read() const {
+    return records_read;
+}
+
+size_t write_binary_trace(TraceReader& reader, const std::string& path) {
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out)
+        throw std::runtime_error("Cannot write trace: " + path);
+
+    std::vector<TraceRecord> records(1 << 16);
+    std::vector<uint64_t> addresses(records.size());
+    size_t total = 0;
+
+    try {
+        while (size_t n = reader.read(records.data(), records.size())) {
+            for (size_t i = 0; i < n; i++)
+                addresses[i] = records[i].address;
+            if (std::fwrite(addresses.data(), sizeof(uint64_t), n, out) != n)
+                throw std::runtime_error("Failed to write trace: " + path);
+            total += n;
+        }
+    } catch (...) {
+        std::fclose(out);
+        throw;
+    }
+
+    if (std::fclose(out) != 0)
+        throw std::runtime_error("Failed to write trace: " + path);
+    return total;
+}
@@ -0,0 +1,59 @@
+#include "cache/two_q_policy.hpp"
+#include <algorithm>
+
+// The paper's recommended tuning: A1in holds 25% of the blocks and A1out
+// remembers as many ids as half the cache.
+TwoQPolicy::TwoQPolicy(size_t capacity)
+    : kin(std::max<size_t>(capacity / 4, 1)),
+      kout(std::max<size_t>(capacity / 2, 1)) {}
+
+void TwoQPolicy::on_insert(CacheBlock& blk) {
+    auto ghost = a1out_index.find(blk.block_id);
+
+    if (ghost != a1out_index.end()) {
+        a1out.erase(ghost->second);
+        a1out_index.erase(ghost);
+
+        blk.pos = am.insert(am.end(), blk.block_id);
+        blk.queue = AM;
+        return;
+    }
+
+    blk.pos = a1in.insert(a1in.end(), blk.block_id);
+    blk.queue = A1IN;
+}
+
+// Hits in A1in are deliberately ignored: correlated references right after
+// the first one do not prove the block is hot.
+void TwoQPolicy::on_hit(CacheBlock& blk) {
+    if (blk.queue == AM)
+        am.splice(am.end(), am, blk.pos);
+}
+
+size_t TwoQPolicy::evict(size_t) {
+    if (a1in.size() > kin || am.empty()) {
+        size_t victim = a1in.front();
+        a1in.pop_front();
+
+        a1out_index[victim] = a1out.insert(a1out.end(), victim);
+        if (a1out.size() > kout) {
+            a1out_index.erase(a1out.front());
+            a1out.pop_front();
+        }
+        return victim;
+    }
+
+    size_t victim = am.front();
+    am.pop_front();
+    return victim;
+}
+
+void TwoQPolicy::on_remove(CacheBlock& blk) {
+    (blk.queue == AM ? am : a1in).erase(blk.pos);
+}
+
+std::vector<size_t> TwoQPolicy::eviction_order() const {
+    std::vector<size_t> ids(a1in.begin(), a1in.end());
+    ids.insert(ids.end(), am.begin(), am.end());
+    return ids;
+}
@@ -0,0 +1,201 @@
+#include "cache/virtual_memory.hpp"
+#include "cache/cache_config.hpp"
+#include <stdexcept>
+
+static unsigned log2_of(size_t value) {
+    unsigned bits = 0;
+    while (value >>= 1)
+        bits++;
+    return bits;
+}
+
+static void validate_tlb(const TlbConfig& tlb) {
+    if (tlb.ways == 0 || tlb.ways >= tlb.entries)
+        return;
+    size_t sets = tlb.entries / tlb.ways;
+    if (tlb.entries % tlb.ways != 0 || (sets & (sets - 1)) != 0)
+        throw std::runtime_error(tlb.name + " needs a power-of-two number of sets");
+}
+
+void VmConfig::validate() const {
+    if (page_size < 4096 || (page_size & (page_size - 1)) != 0 ||
+        (log2_of(page_size) - 12) % 9 != 0)
+        throw std::runtime_error("Page size must be 4 KiB, 2 MiB, 1 GiB, ...");
+
+    if ((log2_of(page_size) - 12) / 9 >= table_levels)
+        throw std::runtime_error("Page size leaves no page-table level to walk");
+
+    if (l1_tlb.entries == 0)
+        throw std::runtime_error("The L1 TLB needs at least one entry");
+    validate_tlb(l1_tlb);
+    if (l2_tlb.entries > 0)
+        validate_tlb(l2_tlb);
+
+    if (physical_pages == 0)
+        throw std::runtime_error("Virtual memory needs at least one physical page");
+}
+
+VirtualMemory::VirtualMemory(const VmConfig& cfg, PteReader pte_reader, FrameReclaimer reclaimer)
+    : config(cfg),
+      page_shift(log2_of(cfg.page_size)),
+      walk_depth(cfg.table_levels - (log2_of(cfg.page_size) - 12) / INDEX_BITS),
+      frames(cfg.physical_pages, 0, cfg.page_policy),
+      next_frame(0),
+      table_page_count(0),
+      table_base(uint64_t(cfg.physical_pages) * cfg.page_size),
+      read_pte(std::move(pte_reader)),
+      reclaim(std::move(reclaimer)) {
+
+    config.validate();
+    table_pages.resize(walk_depth);
+
+    tlbs.emplace_back(config.l1_tlb.entries, config.l1_tlb.hit_time,
+                      config.l1_tlb.policy, config.l1_tlb.ways);
+    if (config.l2_tlb.entries > 0)
+        tlbs.emplace_back(config.l2_tlb.entries, config.l2_tlb.hit_time,
+                          config.l2_tlb.policy, config.l2_tlb.ways);
+}
+
+uint64_t VirtualMemory::translate(uint64_t address, bool write, size_t& cycles) {
+    uint64_t page = address >> page_shift;
+    counters.translations++;
+
+    size_t tlb_cycles = tlbs[0].get_hit_time();
+    if (tlbs[0].access(page)) {
+        counters.l1_tlb_hits++;
+    } else {
+        bool l2_hit = false;
+        if (tlbs.size() > 1) {
+            tlb_cycles += tlbs[1].get_hit_time();
+            l2_hit = tlbs[1].access(page);
+        }
+
+        if (l2_hit) {
+            counters.l2_tlb_hits++;
+        } else {
+            walk(page, cycles);
+            if (tlbs.size() > 1)
+                tlbs[1].insert(page);
+        }
+        tlbs[0].insert(page);
+    }
+    counters.tlb_cycles += tlb_cycles;
+    cycles += tlb_cycles;
+
+    if (write)
+        frames.set_dirty(page);
+
+    return (uint64_t(frame_of[page]) << page_shift) | (address & (config.page_size - 1));
+}
+
+void VirtualMemory::walk(uint64_t page, size_t& cycles) {
+    counters.walks++;
+
+    for (size_t level = 0; level < walk_depth; level++) {
+        uint64_t prefix = page >> (INDEX_BITS * (walk_depth - level));
+        auto [it, added] = table_pages[level].try_emplace(prefix, table_page_count);
+        if (added)
+            table_page_count++;
+
+        uint64_t index = (page >> (INDEX_BITS * (walk_depth - 1 - level))) &
+                         ((1u << INDEX_BITS) - 1);
+        size_t read = read_pte(table_base + it->second * TABLE_PAGE + index * 8);
+        counters.walk_cycles += read;
+        cycles += read;
+    }
+
+    if (frames.access(page))
+        return;
+    fault(page, cycles);
+}
+
+void VirtualMemory::fault(uint64_t page, size_t& cycles) {
+    size_t cost = config.minor_fault_cycles;
+    if (swapped.erase(page)) {
+        counters.major_faults++;
+        cost = config.major_fault_cycles;
+    } else {
+        counters.minor_faults++;
+    }
+
+    size_t frame = next_frame;
+    CacheEviction victim = frames.insert(page);
+    if (victim.valid) {
+        counters.evictions++;
+        if (victim.dirty) {
+            counters.swap_writes++;
+            cost += config.major_fault_cycles;
+        }
+
+        frame = frame_of[victim.block_id];
+        frame_of.erase(victim.block_id);
+        swapped.insert(victim.block_id);
+        for (CacheLevel& tlb : tlbs)
+            tlb.invalidate(victim.block_id);
+        reclaim(uint64_t(frame) << page_shift, config.page_size);
+    } else {
+        next_frame++;
+    }
+
+    frame_of[page] = frame;
+    counters.fault_cycles += cost;
+    cycles += cost;
+}
+
+const VmCounters& VirtualMemory::get_counters() const {
+    return counters;
+}
+
+const VmConfig& VirtualMemory::get_config() const {
+    return config;
+}
+
+size_t VirtualMemory::get_walk_depth() const {
+    return walk_depth;
+}
+
+size_t VirtualMemory::get_resident_pages() const {
+    return frame_of.size();
+}
+
+size_t VirtualMemory::get_table_pages() const {
+    return table_page_count;
+}
+
+double VirtualMemory::get_tlb_miss_rate(size_t level) const {
+    size_t lookups = level == 0 ? counters.translations
+                                : counters.translations - counters.l1_tlb_hits;
+    size_t misses = level == 0 ? lookups - counters.l1_tlb_hits : counters.walks;
+    if (level >= tlbs.size() || lookups == 0)
+        return 0.0;
+    return 100.0 * misses / lookups;
+}
+
+void VirtualMemory::stats(std::ostream& out) const {
+    out << "Virtual memory: " << config.page_size << "-byte pages, "
+        << walk_depth << "-level walk\n";
+
+    const TlbConfig* names[] = {&config.l1_tlb, &config.l2_tlb};
+    for (size_t i = 0; i < tlbs.size(); i++) {
+        size_t lookups = i == 0 ? counters.translations
+                                : counters.translations - counters.l1_tlb_hits;
+        size_t hits = i == 0 ? counters.l1_tlb_hits : counters.l2_tlb_hits;
+        out << "  " << names[i]->name << " hits: " << hits
+            << "  misses: " << lookups - hits
+            << "  miss rate: " << get_tlb_miss_rate(i) << "%\n";
+    }
+
+    out << "  Page walks: " << counters.walks
+        << "  walk cycles: " << counters.walk_cycles;
+    if (counters.walks > 0)
+        out << " (" << double(counters.walk_cycles) / counters.walks << " per walk)";
+    out << "\n  TLB cycles: " << counters.tlb_cycles << "\n"
+        << "  Page faults: minor " << counters.minor_faults
+        << "  major " << counters.major_faults
+        << "  fault cycles: " << counters.fault_cycles << "\n"
+        << "  Evictions: " << counters.evictions
+        << "  swap writes: " << counters.swap_writes
+        << "  (" << cache_policy_name(config.page_policy) << ")\n"
+        << "  Resident pages: " << frame_of.size() << " of " << config.physical_pages
+        << "  page-table pages: " << table_page_count << "\n\n";
+}
@@ -1,10 +1,26 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <chrono>
+#include <filesystem>
+#include <random>
 
 #include "allocator/list_allocator.hpp"
 #include "allocator/buddy_allocator.hpp"
 #include "cache/cache_simulator.hpp"
+#include "cache/multicore_simulator.hpp"
+#include "cache/sweep.hpp"
+#include "cache/sampling.hpp"
+#include "cache/stack_distance.hpp"
+#include "cache/trace_reader.hpp"
+#include "cache/compressed_trace.hpp"
+#include "workload/locality.hpp"
 
 FitStrategy parse_fit(const std::string& s) {
     if (s == "first") return FitStrategy::FirstFit;
@@ -14,20 +30,152 @@ FitStrategy parse_fit(const std::string& s) {
 }
 
 CachePolicy parse_cache_policy(const std::string& s) {
-    if (s == "fifo") return CachePolicy::FIFO;
-    if (s == "lru")  return CachePolicy::LRU;
-    if (s == "lfu")  return CachePolicy::LFU;
+    CachePolicy policy;
+    if (cache_policy_from_string(s, policy))
+        return policy;
     return CachePolicy::LRU;
 }
 
-int main() {
+// Command-line flags describing the cache hierarchy:
+//   --cache-config <file>
+//   --cache-level <name>:<capacity>:<line_size>:<hit_time>:<policy>[:<ways>]
+//   --memory-penalty <cycles>
+//   --inclusion <nine|inclusive|exclusive>
+//   --prefetch <level>:<none|next-line|stride|stream>[:<degree>]
+//   --sample <one in N lines>
+//   --classify-misses <on|off>
+//   --virtual-memory <on|off>
+//   --page-size <bytes>
+//   --timing <blocking|non-blocking>
+//   --issue-width <accesses per cycle>
+//   --mshrs <level>:<count>
+//   --memory <fixed|dram>
+//   --dram-mapping <row-bank-column|row-column-bank|xor>
+//   --row-policy <open|closed>
+bool parse_args(int argc, char** argv, CacheConfig& config) {
+    bool custom_levels = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+
+            if (i + 1 >= argc) {
+                std::cout << "Missing value for " << arg << "\n";
+                return false;
+            }
+
+            if (arg == "--cache-config") {
+                config = CacheConfig::load(argv[++i]);
+                custom_levels = true;
+            }
+            else if (arg == "--cache-level") {
+                if (!custom_levels)
+                    config.levels.clear();
+                config.levels.push_back(CacheConfig::parse_level(argv[++i]));
+                custom_levels = true;
+            }
+            else if (arg == "--memory-penalty") {
+                config.memory_penalty = std::stoull(argv[++i]);
+            }
+            else if (arg == "--prefetch") {
+                config.parse_prefetch(argv[++i]);
+            }
+            else if (arg == "--classify-misses") {
+                std::string value = argv[++i];
+                if (value != "on" && value != "off") {
+                    std::cout << "--classify-misses takes on or off\n";
+                    return false;
+                }
+                config.classify_misses = value == "on";
+            }
+            else if (arg == "--virtual-memory") {
+                std::string value = argv[++i];
+                if (value != "on" && value != "off") {
+                    std::cout << "--virtual-memory takes on or off\n";
+                    return false;
+                }
+                config.vm.enabled = value == "on";
+            }
+            else if (arg == "--page-size") {
+                config.vm.page_size = std::stoull(argv[++i]);
+            }
+            else if (arg == "--timing") {
+                if (!timing_model_from_string(argv[++i], config.timing)) {
+                    std::cout << "Unknown timing model " << argv[i] << "\n";
+                    return false;
+                }
+            }
+            else if (arg == "--issue-width") {
+                config.issue_width = std::stoull(argv[++i]);
+            }
+            else if (arg == "--mshrs") {
+                config.parse_mshrs(argv[++i]);
+            }
+            else if (arg == "--memory") {
+                std::string value = argv[++i];
+                if (value != "fixed" && value != "dram") {
+                    std::cout << "--memory takes fixed or dram\n";
+                    return false;
+                }
+                config.dram.enabled = value == "dram";
+            }
+            else if (arg == "--dram-mapping") {
+                config.set_dram({"mapping", argv[++i]});
+            }
+            else if (arg == "--row-policy") {
+                config.set_dram({"row_policy", argv[++i]});
+            }
+            else if (arg == "--sample") {
+                config.sample_one_in = std::stoull(argv[++i]);
+            }
+            else if (arg == "--inclusion") {
+                if (!inclusion_policy_from_string(argv[++i], config.inclusion)) {
+                    std::cout << "Unknown inclusion policy " << argv[i] << "\n";
+                    return false;
+                }
+            }
+            else {
+                std::cout << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        config.validate();
+    } catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+// Consumes trailing words: a trace format name sets format, anything else
+// is returned through extra (e.g. a CSV path).
+static bool read_trace_args(std::stringstream& ss, TraceFormat& format,
+                            std::string* extra) {
+    std::string word;
+    while (ss >> word) {
+        if (trace_format_from_string(word, format))
+            continue;
+        if (!extra || !extra->empty()) {
+            std::cout << "Unknown trace format " << word << "\n";
+            return false;
+        }
+        *extra = word;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
     std::cout << "Memory Simulator\n";
 
     Allocator* allocator = nullptr;
     size_t memory_size = 0;
 
     CacheSimulator* cache = nullptr;
-    CachePolicy cache_policy = CachePolicy::LRU;
+    CacheConfig cache_config = CacheConfig::defaults(CachePolicy::LRU);
+
+    if (!parse_args(argc, argv, cache_config))
+        return 1;
 
     std::string line;
 
@@ -59,8 +207,18 @@ int main() {
                 std::cout << "Initialized memory of size " << size << "\n";
             }
             else if (sub == "cache") {
+                std::string path;
+                if (ss >> path) {
+                    try {
+                        cache_config = CacheConfig::load(path);
+                    } catch (const std::exception& e) {
+                        std::cout << e.what() << "\n";
+                        continue;
+                    }
+                }
+
                 delete cache;
-                cache = new CacheSimulator(cache_policy);
+                cache = new CacheSimulator(cache_config);
                 std::cout << "Cache initialized\n";
             }
             else {
@@ -98,11 +256,164 @@ int main() {
                 std::cout << "Allocator set to " << arg << "\n";
             }
             else if (sub == "policy") {
-                cache_policy = parse_cache_policy(arg);
+                cache_config.set_policy(parse_cache_policy(arg));
                 delete cache;
-                cache = new CacheSimulator(cache_policy);
+                cache = new CacheSimulator(cache_config);
                 std::cout << "Cache policy set to " << arg << "\n";
             }
+            else if (sub == "inclusion") {
+                CacheConfig updated = cache_config;
+                try {
+                    if (!inclusion_policy_from_string(arg, updated.inclusion))
+                        throw std::runtime_error("Unknown inclusion policy " + arg);
+                    updated.validate();
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                    continue;
+                }
+
+                cache_config = updated;
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                std::cout << "Cache inclusion set to " << arg << "\n";
+            }
+            else if (sub == "classify") {
+                if (arg != "on" && arg != "off") {
+                    std::cout << "Usage: set classify <on|off>\n";
+                    continue;
+                }
+
+                cache_config.classify_misses = arg == "on";
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                std::cout << "Miss classification " << arg << "\n";
+            }
+            else if (sub == "vm" || sub == "pagesize") {
+                CacheConfig updated = cache_config;
+                try {
+                    if (sub == "pagesize")
+                        updated.vm.page_size = std::stoull(arg);
+                    else if (arg == "on" || arg == "off")
+                        updated.vm.enabled = arg == "on";
+                    else
+                        throw std::runtime_error("Usage: set vm <on|off>");
+                    updated.validate();
+                } catch (const std::invalid_argument&) {
+                    std::cout << "Usage: set pagesize <bytes>\n";
+                    continue;
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                    continue;
+                }
+
+                cache_config = updated;
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                if (sub == "vm")
+                    std::cout << "Virtual memory " << arg << "\n";
+                else
+                    std::cout << "Page size set to " << arg << " bytes\n";
+            }
+            else if (sub == "timing" || sub == "mshrs") {
+                CacheConfig updated = cache_config;
+                try {
+                    size_t count = 0;
+                    bool has_count = static_cast<bool>(ss >> count);
+                    if (sub == "mshrs") {
+                        if (!has_count)
+                            throw std::runtime_error("Usage: set mshrs <level> <count>");
+                        updated.set_mshrs(arg, count);
+                    } else {
+                        if (!timing_model_from_string(arg, updated.timing))
+                            throw std::runtime_error(
+                                "Usage: set timing <blocking|non-blocking> [issue width]");
+                        if (has_count)
+                            updated.issue_width = count;
+                    }
+                    updated.validate();
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                    continue;
+                }
+
+                cache_config = updated;
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                if (sub == "mshrs")
+                    std::cout << arg << " MSHRs set\n";
+                else
+                    std::cout << "Timing set to " << arg << "\n";
+            }
+            else if (sub == "memory" || sub == "dram") {
+                CacheConfig updated = cache_config;
+                try {
+                    if (sub == "memory") {
+                        if (arg != "fixed" && arg != "dram")
+                            throw std::runtime_error("Usage: set memory <fixed|dram>");
+                        updated.dram.enabled = arg == "dram";
+                    } else {
+                        std::vector<std::string> setting = {arg};
+                        std::string value;
+                        while (ss >> value)
+                            setting.push_back(value);
+                        updated.set_dram(setting);
+                    }
+                    updated.validate();
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                    continue;
+                }
+
+                cache_config = updated;
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                if (sub == "memory")
+                    std::cout << "Memory model set to " << arg << "\n";
+                else
+                    std::cout << "DRAM " << arg << " set\n";
+            }
+            else if (sub == "sampling") {
+                CacheConfig updated = cache_config;
+                try {
+                    updated.sample_one_in = std::stoull(arg);
+                    updated.validate();
+                } catch (const std::exception& e) {
+                    std::cout << "Usage: set sampling <one in N lines, a power of two>\n";
+                    continue;
+                }
+
+                cache_config = updated;
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                if (cache_config.sample_one_in > 1)
+                    std::cout << "Sampling 1 in " << arg << " lines\n";
+                else
+                    std::cout << "Sampling disabled\n";
+            }
+            else if (sub == "prefetch") {
+                std::string kind;
+                size_t degree = 1;
+                ss >> kind;
+                if (!(ss >> degree))
+                    degree = 1;
+
+                PrefetchPolicy policy;
+                if (!prefetch_policy_from_string(kind, policy)) {
+                    std::cout << "Usage: set prefetch <level> <none|next-line|stride|stream> [degree]\n";
+                    continue;
+                }
+
+                try {
+                    cache_config.set_prefetch(arg, policy, degree);
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                    continue;
+                }
+
+                delete cache;
+                cache = new CacheSimulator(cache_config);
+                std::cout << arg << " prefetcher set to " << kind << "\n";
+            }
             else {
                 std::cout << "Invalid set command\n";
             }
@@ -175,7 +486,49 @@ int main() {
                     std::cout << "Cache not initialized\n";
                     continue;
                 }
-                cache->stats();
+
+                std::string view;
+                if (!(ss >> view)) {
+                    cache->stats();
+                    continue;
+                }
+                if (view != "profile") {
+                    std::cout << "Invalid stats command\n";
+                    continue;
+                }
+
+                const CacheProfiler* profile = cache->get_profiler();
+                if (!profile) {
+                    std::cout << "Profiling not enabled\n";
+                    continue;
+                }
+
+                // stats cache profile [k] [csv_file]
+                size_t k = 10;
+                std::string arg, csv_path;
+                if (ss >> arg) {
+                    if (arg.find_first_not_of("0123456789") == std::string::npos) {
+                        try {
+                            k = std::stoull(arg);
+                        } catch (const std::out_of_range&) {
+                            std::cout << "Usage: stats cache profile [k] [csv_file]\n";
+                            continue;
+                        }
+                        ss >> csv_path;
+                    } else {
+                        csv_path = arg;
+                    }
+                }
+
+                profile->report(std::cout, k);
+                if (!csv_path.empty()) {
+                    try {
+                        profile->export_csv(csv_path, k);
+                        std::cout << "Profile exported to " << csv_path << "\n";
+                    } catch (const std::exception& e) {
+                        std::cout << e.what() << "\n";
+                    }
+                }
             }
             else {
                 std::cout << "Invalid stats command\n";
@@ -189,8 +542,388 @@ int main() {
             }
 
             size_t addr;
-            ss >> addr;
-            cache->access(addr);
+            std::string type;
+            ss >> addr >> type;
+
+            try {
+                if (type.empty() || type == "r" || type == "read") {
+                    cache->access(addr);
+                } else if (type == "w" || type == "write") {
+                    cache->access(addr, AccessType::WRITE);
+                } else {
+                    std::cout << "Usage: access <address> [r|w]\n";
+                }
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "opt") {
+            std::string path;
+            TraceFormat format = TraceFormat::Binary;
+            if (!(ss >> path)) {
+                std::cout << "Usage: opt <trace_file> [format]\n";
+                continue;
+            }
+            if (!read_trace_args(ss, format, nullptr))
+                continue;
+
+            std::string raw = path;
+            try {
+                // OPT makes two passes over a raw file, so other formats are
+                // converted first.
+                if (format != TraceFormat::Binary) {
+                    raw = (std::filesystem::temp_directory_path() /
+                           ("memsim_trace_" + std::to_string(std::random_device{}()))).string();
+                    TraceReader reader(path, format);
+                    write_binary_trace(reader, raw);
+                }
+
+                CacheSimulator opt(cache_config);
+                opt.run_opt(raw);
+                std::cout << "Belady OPT on " << path << ":\n";
+                opt.stats();
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+
+            if (raw != path)
+                std::remove(raw.c_str());
+        }
+
+        else if (cmd == "analyze") {
+            std::string path, csv;
+            TraceFormat format = TraceFormat::Binary;
+            if (!(ss >> path)) {
+                std::cout << "Usage: analyze <trace_file> [csv_file] [format]\n";
+                continue;
+            }
+            if (!read_trace_args(ss, format, &csv))
+                continue;
+
+            StackDistanceAnalyzer sd(cache_config.levels.front().line_size);
+            try {
+                TraceReader reader(path, format);
+                std::vector<TraceRecord> chunk(1 << 16);
+                while (size_t count = reader.read(chunk.data(), chunk.size())) {
+                    for (size_t i = 0; i < count; i++)
+                        sd.access(chunk[i].address);
+                }
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+                continue;
+            }
+
+            sd.stats();
+            if (!csv.empty()) {
+                try {
+                    sd.export_csv(csv);
+                    std::cout << "Miss-ratio curve written to " << csv << "\n";
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                }
+            }
+        }
+
+        else if (cmd == "replay") {
+            if (!cache) {
+                std::cout << "Cache not initialized\n";
+                continue;
+            }
+
+            std::string path;
+            if (!(ss >> path)) {
+                std::cout << "Usage: replay <trace_file> [format]\n";
+                continue;
+            }
+            TraceFormat format = guess_trace_format(path);
+            if (!read_trace_args(ss, format, nullptr))
+                continue;
+
+            try {
+                TraceReader reader(path, format);
+                std::vector<TraceRecord> chunk(1 << 16);
+                size_t total = 0;
+
+                auto start = std::chrono::steady_clock::now();
+                while (size_t count = reader.read(chunk.data(), chunk.size())) {
+                    for (size_t i = 0; i < count; i++)
+                        cache->access(chunk[i].address, chunk[i].write ? AccessType::WRITE
+                                                                       : AccessType::READ);
+                    total += count;
+                }
+                auto end = std::chrono::steady_clock::now();
+
+                double seconds = std::chrono::duration<double>(end - start).count();
+                std::cout << "Replayed " << total << " accesses ("
+                          << reader.get_bytes_read() << " bytes) in "
+                          << seconds << " s, "
+                          << (seconds > 0 ? total / seconds : 0.0) << " accesses/sec\n";
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "mcreplay") {
+            // One trace per core; a trailing format name applies to all.
+            std::vector<std::string> paths;
+            std::string word;
+            bool format_given = false;
+            TraceFormat format = TraceFormat::Text;
+            while (ss >> word) {
+                if (trace_format_from_string(word, format))
+                    format_given = true;
+                else
+                    paths.push_back(word);
+            }
+            if (paths.empty()) {
+                std::cout << "Usage: mcreplay <trace_file>... [format]\n";
+                continue;
+            }
+            if (!format_given)
+                format = guess_trace_format(paths.front());
+
+            try {
+                MulticoreSimulator multicore(cache_config, paths.size());
+
+                auto start = std::chrono::steady_clock::now();
+                size_t total = multicore.replay(paths, format);
+                auto end = std::chrono::steady_clock::now();
+
+                double seconds = std::chrono::duration<double>(end - start).count();
+                std::cout << "Replayed " << total << " accesses on "
+                          << paths.size() << " cores in " << seconds << " s, "
+                          << (seconds > 0 ? total / seconds : 0.0) << " accesses/sec\n";
+                multicore.stats();
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "sweep") {
+            // Config files to compare, or by default every policy at 1, 2,
+            // 4 and 8 times the current hierarchy's capacities.
+            std::string path, word;
+            if (!(ss >> path)) {
+                std::cout << "Usage: sweep <trace_file> [format] [config_file...]\n";
+                continue;
+            }
+            TraceFormat format = guess_trace_format(path);
+
+            try {
+                CacheSweep sweep;
+                while (ss >> word) {
+                    if (!trace_format_from_string(word, format))
+                        sweep.add(word, CacheConfig::load(word));
+                }
+                if (sweep.size() == 0)
+                    sweep.add_policy_grid(cache_config, {1, 2, 4, 8});
+
+                auto start = std::chrono::steady_clock::now();
+                std::vector<SweepResult> results = sweep.run(path, format);
+                auto end = std::chrono::steady_clock::now();
+
+                double seconds = std::chrono::duration<double>(end - start).count();
+                size_t accesses = results.front().accesses;
+                print_sweep(results, std::cout);
+                std::cout << "Swept " << results.size() << " configurations over "
+                          << accesses << " accesses in " << seconds << " s ("
+                          << (seconds > 0 ? accesses * results.size() / seconds : 0.0)
+                          << " simulated accesses/sec)\n";
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "validate") {
+            std::string path;
+            size_t one_in = 0;
+            if (!(ss >> path >> one_in)) {
+                std::cout << "Usage: validate <trace_file> <one in N lines> [format]\n";
+                continue;
+            }
+            TraceFormat format = guess_trace_format(path);
+            if (!read_trace_args(ss, format, nullptr))
+                continue;
+
+            try {
+                print_sampling_validation(
+                    validate_sampling(cache_config, path, format, one_in), std::cout);
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "convert") {
+            std::string in, out;
+            if (!(ss >> in >> out)) {
+                std::cout << "Usage: convert <trace_file> <output.mtc> [format]\n";
+                continue;
+            }
+            TraceFormat format = guess_trace_format(in);
+            if (!read_trace_args(ss, format, nullptr))
+                continue;
+
+            // Offsets below the smallest line size never affect a lookup.
+            size_t block_size = cache_config.levels.front().line_size;
+            for (const CacheLevelConfig& level : cache_config.levels)
+                block_size = std::min(block_size, level.line_size);
+
+            try {
+                TraceReader reader(in, format);
+                size_t records = convert_trace(reader, out, block_size,
+                                               format != TraceFormat::Binary);
+                size_t bytes = std::filesystem::file_size(out);
+
+                std::cout << "Converted " << records << " accesses: "
+                          << bytes << " bytes ("
+                          << (records ? 8.0 * bytes / records : 0.0)
+                          << " bits/access, block size " << block_size << ")\n";
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "decode") {
+            std::string path, out_path;
+            if (!(ss >> path)) {
+                std::cout << "Usage: decode <event_log> [text_file]\n";
+                continue;
+            }
+            ss >> out_path;
+
+            try {
+                if (out_path.empty()) {
+                    decode_event_log(path, std::cout);
+                } else {
+                    std::ofstream out(out_path);
+                    if (!out)
+                        throw std::runtime_error("Cannot write " + out_path);
+                    size_t events = decode_event_log(path, out);
+                    std::cout << "Decoded " << events << " accesses to " << out_path << "\n";
+                }
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "locality") {
+            // Same synthetic heap workload under every allocator, on the
+            // initialized memory size (if any) and the current hierarchy.
+            LocalityWorkload workload;
+            if (memory_size > 0)
+                workload.heap_size = memory_size;
+
+            // locality [operations] [seed]; the seed must fit in 32 bits.
+            std::string ops_arg, seed_arg;
+            ss >> ops_arg >> seed_arg;
+            try {
+                for (const std::string* arg : {&ops_arg, &seed_arg}) {
+                    if (arg->find_first_not_of("0123456789") != std::string::npos)
+                        throw std::invalid_argument(*arg);
+                }
+                if (!ops_arg.empty())
+                    workload.operations = std::stoull(ops_arg);
+                if (!seed_arg.empty()) {
+                    unsigned long long seed = std::stoull(seed_arg);
+                    if (seed > UINT32_MAX)
+                        throw std::out_of_range(seed_arg);
+                    workload.seed = static_cast<uint32_t>(seed);
+                }
+            } catch (const std::logic_error&) {
+                std::cout << "Usage: locality [operations] [seed < 2^32]\n";
+                continue;
+            }
+
+            try {
+                print_locality(compare_allocators(cache_config, workload), std::cout);
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "snapshot") {
+            std::string path;
+            if (!(ss >> path)) {
+                std::cout << "Usage: snapshot <file>\n";
+                continue;
+            }
+            if (!cache && !allocator) {
+                std::cout << "Nothing to save: no cache or allocator\n";
+                continue;
+            }
+
+            try {
+                SnapshotWriter out;
+                if (cache)
+                    cache->save(out);
+                if (allocator)
+                    allocator->save(out);
+                out.write(path);
+                std::cout << "Saved " << (cache ? "cache" : "")
+                          << (cache && allocator ? " and " : "")
+                          << (allocator ? "allocator" : "") << " state to " << path << "\n";
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
+        }
+
+        else if (cmd == "restore") {
+            std::string path;
+            if (!(ss >> path)) {
+                std::cout << "Usage: restore <file>\n";
+                continue;
+            }
+
+            // Everything is loaded before anything is replaced, so a bad
+            // snapshot leaves the current state alone.
+            try {
+                SnapshotReader in(path);
+                CacheSimulator* restored_cache = nullptr;
+                Allocator* restored_allocator = nullptr;
+                size_t restored_size = 0;
+
+                if (in.has(SnapshotSection::CACHE_COUNTERS)) {
+                    restored_cache = new CacheSimulator(cache_config);
+                    try {
+                        restored_cache->restore(in);
+                    } catch (...) {
+                        delete restored_cache;
+                        throw;
+                    }
+                }
+
+                try {
+                    if (in.has(SnapshotSection::LIST_ALLOCATOR)) {
+                        auto* list = new ListAllocator(in);
+                        restored_size = list->get_total_memory();
+                        restored_allocator = list;
+                    } else if (in.has(SnapshotSection::BUDDY_ALLOCATOR)) {
+                        auto* buddy = new BuddyAllocator(in);
+                        restored_size = buddy->get_total_memory();
+                        restored_allocator = buddy;
+                    }
+                } catch (...) {
+                    delete restored_cache;
+                    throw;
+                }
+
+                if (restored_cache) {
+                    delete cache;
+                    cache = restored_cache;
+                    std::cout << "Cache restored from " << path << "\n";
+                }
+                if (restored_allocator) {
+                    delete allocator;
+                    allocator = restored_allocator;
+                    memory_size = restored_size;
+                    std::cout << "Allocator restored from " << path << "\n";
+                }
+                if (!restored_cache && !restored_allocator)
+                    std::cout << path << " holds no cache or allocator state\n";
+            } catch (const std::exception& e) {
+                std::cout << e.what() << "\n";
+            }
         }
 
         else if (cmd == "enable") {
@@ -207,8 +940,16 @@ int main() {
                 std::cout << "Logs enabled\n";
             }
             else if (what == "filelog") {
-                cache->enable_filelog();
-                std::cout << "File logging enabled\n";
+                try {
+                    cache->enable_filelog();
+                    std::cout << "File logging enabled\n";
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                }
+            }
+            else if (what == "profile") {
+                cache->enable_profiling();
+                std::cout << "Profiling enabled\n";
             }
             else {
                 std::cout << "Unknown enable option\n";
@@ -229,8 +970,16 @@ int main() {
                 std::cout << "Logs disabled\n";
             }
             else if (what == "filelog") {
-                cache->disable_filelog();
-                std::cout << "File logging disabled\n";
+                try {
+                    cache->disable_filelog();
+                    std::cout << "File logging disabled\n";
+                } catch (const std::exception& e) {
+                    std::cout << e.what() << "\n";
+                }
+            }
+            else if (what == "profile") {
+                cache->disable_profiling();
+                std::cout << "Profiling disabled\n";
             }
             else {
                 std::cout << "Unknown disable option\n";
@@ -0,0 +1,204 @@
+#include "snapshot/snapshot.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'S', 'I', 'M', 'S', 'N', 'A', 'P'};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+};
+
+struct TableEntry {
+    uint32_t kind;
+    uint32_t record_size;
+    uint64_t offset;
+    uint64_t count;
+};
+
+uint64_t align8(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+// Maps the whole file read-only. Files too short for a header are not
+// mapped at all.
+const char* map_file(const std::string& path, size_t& length) {
+#ifdef _WIN32
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open snapshot " + path);
+
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader)) {
+        ::CloseHandle(file);
+        throw std::runtime_error(path + " is not a snapshot");
+    }
+
+    // The view keeps the mapping alive once both handles are closed.
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    void* view = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (mapping)
+        ::CloseHandle(mapping);
+    if (!view)
+        throw std::runtime_error("Cannot map snapshot " + path);
+
+    length = static_cast<size_t>(size.QuadPart);
+    return static_cast<const char*>(view);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open snapshot " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a snapshot");
+    }
+
+    void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Cannot map snapshot " + path);
+
+    length = st.st_size;
+    return static_cast<const char*>(mapped);
+#endif
+}
+
+void unmap_file(const char* base, size_t length) {
+#ifdef _WIN32
+    (void)length;
+    ::UnmapViewOfFile(base);
+#else
+    ::munmap(const_cast<char*>(base), length);
+#endif
+}
+
+}
+
+void SnapshotWriter::add_raw(SnapshotSection kind, const void* records,
+                             size_t record_size, size_t count) {
+    Section section{kind, static_cast<uint32_t>(record_size), count, {}};
+    const char* bytes = static_cast<const char*>(records);
+    section.data.assign(bytes, bytes + record_size * count);
+
+    for (Section& s : sections) {
+        if (s.kind == kind) {
+            s = std::move(section);
+            return;
+        }
+    }
+    sections.push_back(std::move(section));
+}
+
+void SnapshotWriter::write(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Cannot write snapshot " + path);
+
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.section_count = static_cast<uint32_t>(sections.size());
+
+    std::vector<TableEntry> table;
+    uint64_t offset = align8(sizeof(FileHeader) + sections.size() * sizeof(TableEntry));
+    for (const Section& s : sections) {
+        table.push_back({static_cast<uint32_t>(s.kind), s.record_size, offset, s.count});
+        offset = align8(offset + s.data.size());
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()),
+              table.size() * sizeof(TableEntry));
+
+    const char padding[8] = {};
+    uint64_t written = sizeof(FileHeader) + table.size() * sizeof(TableEntry);
+    for (size_t i = 0; i < sections.size(); i++) {
+        out.write(padding, table[i].offset - written);
+        out.write(sections[i].data.data(), sections[i].data.size());
+        written = table[i].offset + sections[i].data.size();
+    }
+    out.write(padding, align8(written) - written);
+
+    if (!out)
+        throw std::runtime_error("Cannot write snapshot " + path);
+}
+
+SnapshotReader::SnapshotReader(const std::string& path) : base(nullptr), length(0) {
+    base = map_file(path, length);
+
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    std::string problem;
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0)
+        problem = path + " is not a snapshot";
+    else if (header->version != SNAPSHOT_VERSION)
+        problem = path + " is snapshot version " + std::to_string(header->version) +
+                  ", expected " + std::to_string(SNAPSHOT_VERSION);
+    else if (sizeof(FileHeader) + header->section_count * sizeof(TableEntry) > length)
+        problem = path + " is truncated";
+
+    const TableEntry* table = reinterpret_cast<const TableEntry*>(header + 1);
+    for (uint32_t i = 0; problem.empty() && i < header->section_count; i++) {
+        const TableEntry& e = table[i];
+        if (e.offset % 8 != 0 || e.offset > length ||
+            (e.record_size && e.count > (length - e.offset) / e.record_size))
+            problem = path + " is truncated";
+    }
+
+    if (!problem.empty()) {
+        unmap_file(base, length);
+        throw std::runtime_error(problem);
+    }
+}
+
+SnapshotReader::~SnapshotReader() {
+    unmap_file(base, length);
+}
+
+void SnapshotReader::throw_malformed() {
+    throw std::runtime_error("Malformed snapshot");
+}
+
+bool SnapshotReader::has(SnapshotSection kind) const {
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    const TableEntry* table = reinterpret_cast<const TableEntry*>(header + 1);
+    for (uint32_t i = 0; i < header->section_count; i++) {
+        if (table[i].kind == static_cast<uint32_t>(kind))
+            return true;
+    }
+    return false;
+}
+
+const void* SnapshotReader::find(SnapshotSection kind, size_t record_size,
+                                 size_t& count) const {
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    const TableEntry* table = reinterpret_cast<const TableEntry*>(header + 1);
+    for (uint32_t i = 0; i < header->section_count; i++) {
+        if (table[i].kind != static_cast<uint32_t>(kind))
+            continue;
+        if (table[i].record_size != record_size)
+            throw_malformed();
+        count = table[i].count;
+        return base + table[i].offset;
+    }
+    throw std::runtime_error("Snapshot has no section " +
+                             std::to_string(static_cast<uint32_t>(kind)));
+}
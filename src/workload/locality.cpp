@@ -0,0 +1,169 @@
+#include "workload/locality.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+
+#include "allocator/buddy_allocator.hpp"
+#include "allocator/list_allocator.hpp"
+
+std::vector<WorkloadOp> LocalityWorkload::generate() const {
+    if (alloc_percent == 0 || alloc_percent + free_percent > 100 ||
+        write_percent > 100 || recent_percent > 100)
+        throw std::runtime_error("Workload percentages must be at most 100, with some allocations");
+    if (min_size == 0 || min_size > max_size || max_size > UINT32_MAX)
+        throw std::runtime_error("Workload object sizes must satisfy 0 < min <= max");
+
+    std::mt19937 rng(seed);
+    std::vector<WorkloadOp> ops;
+    std::vector<uint32_t> live;   // in allocation order
+    uint32_t next_object = 0;
+
+    for (size_t i = 0; i < operations; i++) {
+        unsigned roll = rng() % 100;
+
+        if (live.empty() || roll < alloc_percent) {
+            uint32_t size = min_size + rng() % (max_size - min_size + 1);
+            uint32_t object = next_object++;
+            live.push_back(object);
+            ops.push_back({WorkloadOp::ALLOC, object, size});
+            for (uint32_t offset = 0; offset < size; offset += WORD)
+                ops.push_back({WorkloadOp::WRITE, object, offset});
+            continue;
+        }
+
+        if (roll < alloc_percent + free_percent) {
+            size_t index = rng() % live.size();
+            ops.push_back({WorkloadOp::FREE, live[index], 0});
+            live.erase(live.begin() + index);
+            continue;
+        }
+
+        size_t index = rng() % live.size();
+        if (rng() % 100 < recent_percent)
+            index = live.size() - 1 - rng() % std::min(live.size(), RECENT_OBJECTS);
+
+        WorkloadOp::Kind kind = rng() % 100 < write_percent ? WorkloadOp::WRITE
+                                                            : WorkloadOp::READ;
+        // Offsets are drawn for the largest object and wrapped at replay,
+        // where the object's size is known.
+        uint32_t offset = rng() % max_size;
+        ops.push_back({kind, live[index], offset});
+    }
+    return ops;
+}
+
+LocalityResult run_locality(const std::string& name, Allocator& allocator,
+                            CacheSimulator& cache, const std::vector<WorkloadOp>& ops) {
+    struct Object {
+        int id;
+        size_t start;
+        uint32_t size;
+    };
+    std::vector<Object> objects;
+
+    LocalityResult result;
+    result.name = name;
+
+    for (const WorkloadOp& op : ops) {
+        if (op.kind == WorkloadOp::ALLOC) {
+            Object obj{allocator.malloc(op.arg), 0, op.arg};
+            result.allocations++;
+            if (obj.id < 0 || !allocator.get_block_start(obj.id, obj.start)) {
+                obj.id = -1;
+                result.failed_allocations++;
+            } else {
+                result.footprint = std::max(result.footprint, obj.start + obj.size);
+            }
+            objects.push_back(obj);
+            continue;
+        }
+
+        Object& obj = objects.at(op.object);
+        if (obj.id < 0)
+            continue;
+
+        if (op.kind == WorkloadOp::FREE) {
+            allocator.free(obj.id);
+            obj.id = -1;
+            continue;
+        }
+
+        uint32_t offset = op.arg % obj.size / LocalityWorkload::WORD * LocalityWorkload::WORD;
+        cache.access(obj.start + offset,
+                     op.kind == WorkloadOp::WRITE ? AccessType::WRITE : AccessType::READ);
+        result.accesses++;
+    }
+
+    result.external_fragmentation = allocator.external_fragmentation();
+    for (size_t l = 0; l < cache.get_level_count(); l++) {
+        result.level_names.push_back(cache.get_config().levels[l].name);
+        result.level_hit_rates.push_back(cache.get_hit_rate(l));
+    }
+    result.hit_rate = cache.get_overall_hit_rate();
+    result.avg_access_time = cache.get_avg_access_time();
+    result.memory_accesses = cache.get_memory_accesses();
+    return result;
+}
+
+std::vector<LocalityResult> compare_allocators(const CacheConfig& config,
+                                               const LocalityWorkload& workload) {
+    if (workload.heap_size == 0)
+        throw std::runtime_error("Workload heap must not be empty");
+    const std::vector<WorkloadOp> ops = workload.generate();
+
+    const std::pair<const char*, FitStrategy> fits[] = {
+        {"first-fit", FitStrategy::FirstFit},
+        {"best-fit", FitStrategy::BestFit},
+        {"worst-fit", FitStrategy::WorstFit},
+    };
+
+    std::vector<LocalityResult> results;
+    for (const auto& fit : fits) {
+        ListAllocator allocator(workload.heap_size, fit.second);
+        CacheSimulator cache(config);
+        results.push_back(run_locality(fit.first, allocator, cache, ops));
+        results.back().heap_size = workload.heap_size;
+    }
+
+    size_t buddy_heap = 1;
+    while (buddy_heap <= workload.heap_size / 2)
+        buddy_heap *= 2;
+    BuddyAllocator buddy(buddy_heap);
+    CacheSimulator cache(config);
+    results.push_back(run_locality("buddy", buddy, cache, ops));
+    results.back().heap_size = buddy_heap;
+    return results;
+}
+
+void print_locality(const std::vector<LocalityResult>& results, std::ostream& out) {
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+
+    out << std::left << std::setw(12) << "allocator" << std::right
+        << std::setw(10) << "hit rate" << std::setw(12) << "avg cycles"
+        << std::setw(10) << "memory" << std::setw(12) << "footprint"
+        << std::setw(10) << "ext frag" << std::setw(8) << "failed" << "  per level\n";
+
+    out << std::fixed << std::setprecision(2);
+    for (const LocalityResult& r : results) {
+        out << std::left << std::setw(12) << r.name << std::right
+            << std::setw(9) << r.hit_rate << "%"
+            << std::setw(12) << r.avg_access_time
+            << std::setw(10) << r.memory_accesses
+            << std::setw(12) << r.footprint
+            << std::setw(9) << r.external_fragmentation << "%"
+            << std::setw(8) << r.failed_allocations << " ";
+        for (size_t l = 0; l < r.level_names.size(); l++)
+            out << " " << r.level_names[l] << " " << r.level_hit_rates[l] << "%";
+        out << "\n";
+    }
+
+    for (const LocalityResult& r : results) {
+        if (r.heap_size != results.front().heap_size)
+            out << r.name << " ran on a " << r.heap_size << "-byte heap, the largest power of two in "
+                << results.front().heap_size << "\n";
+    }
+
+    out.copyfmt(flags);
+}
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <cassert>
+#include <cstdio>
 #include "allocator/list_allocator.hpp"
+#include "allocator/buddy_allocator.hpp"
+#include "snapshot/snapshot.hpp"
 
 void test_first_fit_basic() {
     ListAllocator alloc(64, FitStrategy::FirstFit);
@@ -56,11 +59,125 @@ void test_coalescing() {
     assert(c > 0);
 }
 
+void test_list_snapshot() {
+    const char* path = "test_allocator_snapshot.bin";
+    ListAllocator alloc(256, FitStrategy::BestFit);
+
+    int a = alloc.malloc(32);
+    int b = alloc.malloc(16);
+    alloc.malloc(64);
+    alloc.free(a);
+    alloc.free(b);
+    alloc.malloc(100);
+
+    SnapshotWriter out;
+    alloc.save(out);
+    out.write(path);
+
+    SnapshotReader in(path);
+    ListAllocator restored(in);
+    assert(restored.get_total_memory() == 256);
+    assert(restored.get_used_memory() == alloc.get_used_memory());
+    assert(restored.get_total_requests() == alloc.get_total_requests());
+    assert(restored.compute_external_fragmentation() ==
+           alloc.compute_external_fragmentation());
+
+    // Best fit picks the same holes and hands out the same ids.
+    for (size_t size : {8, 40, 24}) {
+        int expected = alloc.malloc(size);
+        assert(restored.malloc(size) == expected);
+        assert(restored.get_used_memory() == alloc.get_used_memory());
+    }
+    std::remove(path);
+}
+
+void test_buddy_snapshot() {
+    const char* path = "test_allocator_snapshot.bin";
+    BuddyAllocator alloc(1024);
+
+    int a = alloc.malloc(100);
+    alloc.malloc(60);
+    int c = alloc.malloc(200);
+    alloc.free(a);
+    alloc.free(c);
+
+    SnapshotWriter out;
+    alloc.save(out);
+    out.write(path);
+
+    SnapshotReader in(path);
+    BuddyAllocator restored(in);
+    assert(restored.utilization() == alloc.utilization());
+    assert(restored.external_fragmentation() == alloc.external_fragmentation());
+
+    for (size_t size : {30, 120, 500}) {
+        int expected = alloc.malloc(size);
+        assert(restored.malloc(size) == expected);
+        assert(restored.utilization() == alloc.utilization());
+        assert(restored.internal_fragmentation() == alloc.internal_fragmentation());
+    }
+
+    // A list allocator snapshot holds no buddy state.
+    ListAllocator list(64, FitStrategy::FirstFit);
+    SnapshotWriter list_out;
+    list.save(list_out);
+    list_out.write(path);
+    SnapshotReader list_in(path);
+    bool threw = false;
+    try {
+        BuddyAllocator wrong(list_in);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::remove(path);
+}
+
+// Same layout as the buddy allocator's free-block records.
+struct ForgedBuddyFree {
+    uint64_t order;
+    uint64_t addr;
+};
+
+// Free blocks that overlap an allocation, are misaligned or run past the
+// heap must be rejected rather than handed out again.
+void test_buddy_snapshot_corrupt() {
+    const char* path = "test_allocator_snapshot.bin";
+    BuddyAllocator alloc(1024);
+    alloc.malloc(100);   // 128 bytes at 0; 128, 256 and 512 stay free
+
+    const std::vector<std::vector<ForgedBuddyFree>> forged = {
+        {{7, 128}, {8, 256}, {9, 512}, {7, 0}},   // overlaps the allocation
+        {{7, 192}, {8, 256}, {9, 512}},           // misaligned
+        {{7, 128}, {8, 256}, {9, 1024}},          // past the heap
+        {{7, 128}, {8, 256}},                     // leaves a hole
+    };
+    for (const auto& free_blocks : forged) {
+        SnapshotWriter out;
+        alloc.save(out);
+        out.add(SnapshotSection::BUDDY_FREE, free_blocks);
+        out.write(path);
+
+        SnapshotReader in(path);
+        bool threw = false;
+        try {
+            BuddyAllocator restored(in);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    std::remove(path);
+}
+
 int main() {
     test_first_fit_basic();
     test_best_fit();
     test_worst_fit();
     test_coalescing();
+    test_list_snapshot();
+    test_buddy_snapshot();
+    test_buddy_snapshot_corrupt();
 
     std::cout << "[PASS] All allocator tests\n";
     return 0;
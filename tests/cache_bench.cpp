@@ -0,0 +1,303 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <sstream>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include "cache/cache_level.hpp"
+#include "cache/cache_simulator.hpp"
+#include "cache/trace_reader.hpp"
+#include "cache/compressed_trace.hpp"
+#include "cache/sweep.hpp"
+
+static const size_t ACCESSES = 2000000;
+static const size_t SIZES[] = {16, 256, 4096, 65536, 1048576};
+
+// Per-access cost of a single level kept full: half the accesses hit a
+// resident block, the other half miss and force an eviction.
+template <class Level = CacheLevel>
+static double ns_per_access(CachePolicy policy, size_t capacity, size_t ways) {
+    std::mt19937_64 rng(42);
+    Level level(capacity, 1, policy, ways);
+
+    for (size_t i = 0; i < capacity; i++)
+        level.insert(i);
+
+    size_t next_block = capacity;
+    std::vector<size_t> addresses(ACCESSES);
+    for (size_t i = 0; i < ACCESSES; i++)
+        addresses[i] = (rng() & 1) ? next_block++ : next_block - 1 - rng() % capacity;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t block : addresses) {
+        if (!level.access(block))
+            level.insert(block);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ACCESSES;
+}
+
+static const size_t SIM_ACCESSES = 1000000;
+static const size_t SIM_MAX_ADDRESS = 1 << 20;
+
+// Accesses per second of a whole hierarchy, comparing the runtime-selected
+// CacheSimulator with the compile-time specialised StaticCacheSimulator.
+template <class Simulator>
+static double accesses_per_sec(const CacheConfig& config) {
+    std::mt19937_64 rng(7);
+    std::vector<size_t> addresses(SIM_ACCESSES);
+    for (auto& address : addresses)
+        address = rng() % SIM_MAX_ADDRESS;
+
+    Simulator cache(config);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t address : addresses)
+        cache.access(address);
+    auto end = std::chrono::steady_clock::now();
+
+    return SIM_ACCESSES / std::chrono::duration<double>(end - start).count();
+}
+
+static volatile size_t bench_sink;
+
+// Cost of the disabled-logging path: the simulator as it is now against the
+// same simulator plus the strings the access path used to build for log()
+// on every call, whether or not logging was enabled, and with the binary
+// event log switched on.
+static void compare_logging() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 512, 64, 4, CachePolicy::LRU, 8},
+        {"L2", 4096, 64, 14, CachePolicy::LRU, 8},
+        {"L3", 16384, 64, 50, CachePolicy::LRU, 16},
+    };
+
+    std::mt19937_64 rng(7);
+    std::vector<size_t> addresses(SIM_ACCESSES);
+    for (auto& address : addresses)
+        address = rng() % SIM_MAX_ADDRESS;
+
+    auto run = [&](bool format_strings, bool event_log = false) {
+        CacheSimulator cache(config);
+        if (event_log)
+            cache.enable_filelog();
+        size_t sink = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t address : addresses) {
+            if (format_strings) {
+                std::ostringstream oss;
+                oss << "ACCESS " << address << " (block " << address / 64 << "):";
+                sink += oss.str().size();
+                for (const auto& level : config.levels)
+                    sink += ("  " + level.name + " MISS").size();
+                sink += ("  Access time: " + std::to_string(sink) + " cycles").size();
+            }
+            cache.access(address);
+        }
+        cache.disable_filelog();
+        auto end = std::chrono::steady_clock::now();
+
+        bench_sink = sink;
+        return SIM_ACCESSES / std::chrono::duration<double>(end - start).count();
+    };
+
+    double before = run(true);
+    double after = run(false);
+    double logged = run(false, true);
+    std::remove(CacheSimulator::EVENT_LOG_PATH);
+
+    std::cout << "Logging disabled (8/8/16-way LRU hierarchy):\n"
+              << "  formatting every access=" << std::setw(6) << before / 1e6 << " M/s"
+              << "  no formatting=" << std::setw(6) << after / 1e6 << " M/s"
+              << "  (" << after / before << "x)\n"
+              << "  binary event log enabled=" << std::setw(6) << logged / 1e6 << " M/s\n\n";
+}
+
+// Runs are noisy next to the gap being measured, so each figure is the
+// best of SIM_RUNS.
+static const int SIM_RUNS = 3;
+
+template <class Policy, Associativity Layout>
+static void compare_simulators(const std::string& name) {
+    bool sets = Layout == Associativity::SET;
+    size_t ways = sets ? 8 : 0;
+    CacheConfig config;
+    config.levels = {
+        {"L1", 512, 64, 4, Policy::kind(), ways},
+        {"L2", 4096, 64, 14, Policy::kind(), ways},
+        {"L3", 16384, 64, 50, Policy::kind(), 2 * ways},
+    };
+
+    double dynamic = 0, specialised = 0;
+    double level_dynamic = 1e30, level_static = 1e30;
+    for (int run = 0; run < SIM_RUNS; run++) {
+        dynamic = std::max(dynamic, accesses_per_sec<CacheSimulator>(config));
+        specialised = std::max(specialised,
+                               accesses_per_sec<StaticCacheSimulator<Policy, Layout>>(config));
+        level_dynamic = std::min(level_dynamic,
+                                 ns_per_access<CacheLevel>(Policy::kind(), 4096, ways));
+        level_static = std::min(level_static,
+                                ns_per_access<BasicCacheLevel<Policy, Layout>>(Policy::kind(), 4096, ways));
+    }
+
+    std::cout << "  " << std::left << std::setw(12) << name << std::right
+              << (sets ? " 8/8/16-way" : " fully assoc")
+              << "  hierarchy: dynamic=" << std::setw(6) << dynamic / 1e6 << " M/s"
+              << " static=" << std::setw(6) << specialised / 1e6 << " M/s"
+              << "  4096-entry level: dynamic=" << std::setw(6) << level_dynamic
+              << " ns static=" << std::setw(6) << level_static << " ns\n";
+}
+
+template <class Policy>
+static void compare_simulators(const std::string& name) {
+    compare_simulators<Policy, Associativity::FULL>(name);
+    compare_simulators<Policy, Associativity::SET>(name);
+}
+
+static const size_t TRACE_RECORDS = 8000000;
+
+// Decode rate and on-disk size of the raw and compressed trace formats for
+// a strided-with-noise access stream.
+static void compare_trace_formats() {
+    const char* raw_path = "bench_trace.bin";
+    const char* mtc_path = "bench_trace.mtc";
+
+    std::mt19937_64 rng(3);
+    {
+        std::FILE* raw = std::fopen(raw_path, "wb");
+        CompressedTraceWriter writer(mtc_path, 64, false);
+        uint64_t address = 0x7f0000000000;
+        for (size_t i = 0; i < TRACE_RECORDS; i++) {
+            address = (rng() % 16) ? address + 64 : 0x7f0000000000 + (rng() % (1 << 26)) * 64;
+            std::fwrite(&address, sizeof(address), 1, raw);
+            writer.append({address, false});
+        }
+        std::fclose(raw);
+    }
+
+    auto decode = [](const char* path, TraceFormat format) {
+        TraceReader reader(path, format);
+        std::vector<TraceRecord> chunk(1 << 16);
+        uint64_t checksum = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        while (size_t n = reader.read(chunk.data(), chunk.size())) {
+            for (size_t i = 0; i < n; i++)
+                checksum += chunk[i].address;
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::cout << "  " << std::left << std::setw(10)
+                  << (format == TraceFormat::Binary ? "raw" : "compressed") << std::right
+                  << " bytes/access=" << std::setw(5)
+                  << (double)reader.get_bytes_read() / TRACE_RECORDS
+                  << "  decode=" << std::setw(6) << TRACE_RECORDS / seconds / 1e6
+                  << " M accesses/s"
+                  << "  (checksum " << (checksum & 0xffff) << ")\n";
+    };
+
+    std::cout << "Trace formats (" << TRACE_RECORDS << " accesses):\n";
+    decode(raw_path, TraceFormat::Binary);
+    decode(mtc_path, TraceFormat::Compressed);
+    std::cout << "\n";
+
+    std::remove(raw_path);
+    std::remove(mtc_path);
+}
+
+static const size_t SWEEP_RECORDS = 1000000;
+
+// Eight policies over one text trace: a simulator per configuration, each
+// parsing the trace itself, against one sweep that parses it once.
+static void compare_sweep() {
+    const char* path = "bench_sweep.txt";
+    {
+        std::mt19937_64 rng(9);
+        std::ofstream out(path);
+        for (size_t i = 0; i < SWEEP_RECORDS; i++)
+            out << (rng() % 4 ? "R " : "W ") << rng() % SIM_MAX_ADDRESS << "\n";
+    }
+
+    CacheConfig base;
+    base.levels = {
+        {"L1", 512, 64, 4, CachePolicy::LRU, 8},
+        {"L2", 4096, 64, 14, CachePolicy::LRU, 8},
+        {"L3", 16384, 64, 50, CachePolicy::LRU, 16},
+    };
+    CacheSweep sweep;
+    sweep.add_policy_grid(base, {1});
+
+    auto start = std::chrono::steady_clock::now();
+    for (CachePolicy policy : {CachePolicy::FIFO, CachePolicy::LRU, CachePolicy::LFU,
+                               CachePolicy::LFU_AGING, CachePolicy::ARC, CachePolicy::TWO_Q,
+                               CachePolicy::CLOCK, CachePolicy::S3_FIFO}) {
+        CacheConfig config = base;
+        config.set_policy(policy);
+        CacheSimulator cache(config);
+        TraceReader reader(path, TraceFormat::Text);
+        std::vector<TraceRecord> chunk(1 << 16);
+        while (size_t n = reader.read(chunk.data(), chunk.size())) {
+            for (size_t i = 0; i < n; i++)
+                cache.access(chunk[i].address, chunk[i].write ? AccessType::WRITE
+                                                              : AccessType::READ);
+        }
+        bench_sink = cache.get_memory_accesses();
+    }
+    auto middle = std::chrono::steady_clock::now();
+    std::vector<SweepResult> results = sweep.run(path, TraceFormat::Text);
+    auto end = std::chrono::steady_clock::now();
+    std::remove(path);
+
+    double separate = std::chrono::duration<double>(middle - start).count();
+    double swept = std::chrono::duration<double>(end - middle).count();
+    std::cout << "Policy sweep (" << results.size() << " configs, " << SWEEP_RECORDS
+              << " text accesses, " << std::thread::hardware_concurrency() << " threads):\n"
+              << "  separate replays=" << std::setw(6) << separate << " s"
+              << "  one-pass sweep=" << std::setw(6) << swept << " s"
+              << "  (" << separate / swept << "x)\n\n";
+}
+
+int main() {
+    auto run_policy = [&](const std::string& name, CachePolicy policy,
+                          size_t ways = 0) {
+        std::cout << "Policy: " << name
+                  << (ways ? " (" + std::to_string(ways) + "-way)" : "") << "\n";
+        for (size_t size : SIZES) {
+            std::cout << "  entries=" << std::setw(8) << size
+                      << "  ns/access=" << std::fixed << std::setprecision(1)
+                      << ns_per_access(policy, size, ways) << "\n";
+        }
+        std::cout << "\n";
+    };
+
+    run_policy("FIFO", CachePolicy::FIFO);
+    run_policy("LRU", CachePolicy::LRU);
+    run_policy("LFU", CachePolicy::LFU);
+    run_policy("LFU (aging)", CachePolicy::LFU_AGING);
+    run_policy("ARC", CachePolicy::ARC);
+    run_policy("2Q", CachePolicy::TWO_Q);
+    run_policy("CLOCK", CachePolicy::CLOCK);
+    run_policy("S3-FIFO", CachePolicy::S3_FIFO);
+    run_policy("LRU", CachePolicy::LRU, 8);
+    run_policy("LFU", CachePolicy::LFU, 8);
+
+    compare_trace_formats();
+    compare_sweep();
+    compare_logging();
+
+    std::cout << "Simulator throughput (runtime vs compile-time policy):\n";
+    compare_simulators<FifoPolicy>("FIFO");
+    compare_simulators<LruPolicy>("LRU");
+    compare_simulators<LfuPolicy>("LFU");
+    compare_simulators<LfuAgingPolicy>("LFU (aging)");
+
+    return 0;
+}
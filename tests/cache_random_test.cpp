@@ -42,6 +42,11 @@ int main() {
     run_policy("FIFO", CachePolicy::FIFO);
     run_policy("LRU", CachePolicy::LRU);
     run_policy("LFU", CachePolicy::LFU);
+    run_policy("LFU (aging)", CachePolicy::LFU_AGING);
+    run_policy("ARC", CachePolicy::ARC);
+    run_policy("2Q", CachePolicy::TWO_Q);
+    run_policy("CLOCK", CachePolicy::CLOCK);
+    run_policy("S3-FIFO", CachePolicy::S3_FIFO);
 
     return 0;
 }
@@ -1,6 +1,19 @@
 #include <iostream>
 #include <cassert>
+#include <fstream>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <cmath>
 #include "cache/cache_simulator.hpp"
+#include "cache/multicore_simulator.hpp"
+#include "cache/sweep.hpp"
+#include "cache/stack_distance.hpp"
+#include "cache/trace_reader.hpp"
+#include "cache/compressed_trace.hpp"
+#include "allocator/list_allocator.hpp"
+#include "allocator/buddy_allocator.hpp"
+#include "workload/locality.hpp"
 
 void test_fifo_basic() {
     CacheSimulator cache(CachePolicy::FIFO);
@@ -98,6 +111,1680 @@ void test_cache_levels() {
     assert(cache.get_total_accesses() == 2);
 }
 
+void test_lru_level_order() {
+    CacheLevel level(2, 1, CachePolicy::LRU);
+
+    level.insert(1);
+    level.insert(2);
+    assert(level.access(1));
+
+    level.insert(3);
+
+    assert(!level.access(2));
+    assert(level.access(1));
+    assert(level.access(3));
+}
+
+void test_lfu_level_tie_break() {
+    CacheLevel level(3, 1, CachePolicy::LFU);
+
+    level.insert(1);
+    level.insert(2);
+    level.insert(3);
+    assert(level.access(1));
+    assert(level.access(3));
+
+    // 2 has the lowest frequency.
+    level.insert(4);
+    assert(!level.access(2));
+
+    // 4 (freq 1) goes before the older but more used 1 and 3.
+    level.insert(5);
+    assert(!level.access(4));
+    assert(level.access(1));
+    assert(level.access(3));
+    assert(level.access(5));
+}
+
+void test_lfu_aging_forgets_old_hot_blocks() {
+    CacheLevel plain(2, 1, CachePolicy::LFU);
+    CacheLevel aging(2, 1, CachePolicy::LFU_AGING);
+
+    for (CacheLevel* level : {&plain, &aging}) {
+        level->insert(1);
+        for (int i = 0; i < 20; i++)
+            level->access(1);
+
+        // A long phase where block 1 is never touched again.
+        for (size_t b = 100; b < 140; b++) {
+            if (!level->access(2))
+                level->insert(2);
+            level->insert(b);
+        }
+    }
+
+    assert(plain.access(1));
+    assert(!aging.access(1));
+}
+
+// 32 KiB, 8-way, 64-byte lines (64 sets), as in a Skylake L1D: lines
+// 4 KiB apart share a set, so the ninth one evicts the least recently used.
+void test_set_associative_reference_l1d() {
+    const size_t LINE = 64;
+    CacheLevel l1d(32 * 1024 / LINE, 4, CachePolicy::LRU, 8);
+
+    assert(l1d.get_sets() == 64);
+    assert(l1d.get_ways() == 8);
+
+    for (size_t i = 0; i < 8; i++)
+        l1d.insert(i * 4096 / LINE);
+    l1d.insert(64 / LINE);
+
+    assert(l1d.access(0));
+    l1d.insert(8 * 4096 / LINE);
+
+    assert(l1d.access(0));
+    assert(!l1d.access(1 * 4096 / LINE));
+    assert(l1d.access(8 * 4096 / LINE));
+    assert(l1d.access(64 / LINE));
+}
+
+void test_direct_mapped_conflict() {
+    CacheLevel level(4, 1, CachePolicy::FIFO, 1);
+
+    level.insert(0);
+    level.insert(1);
+    level.insert(4);
+
+    assert(!level.access(0));
+    assert(level.access(1));
+    assert(level.access(4));
+}
+
+void test_four_level_hierarchy() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 2, 64, 4, CachePolicy::LRU, 0},
+        {"L2", 4, 64, 12, CachePolicy::LRU, 0},
+        {"L3", 8, 64, 40, CachePolicy::LRU, 0},
+        {"L4", 16, 64, 80, CachePolicy::LRU, 0},
+    };
+    config.memory_penalty = 200;
+
+    CacheSimulator cache(config);
+    assert(cache.get_level_count() == 4);
+
+    cache.access(0);
+    assert(cache.get_avg_access_time() == 4 + 12 + 40 + 80 + 200);
+
+    cache.access(63);
+    assert(cache.get_l1_hit_rate() == 50.0);
+
+    // Push block 0 out of L1, L2 and L3 but not L4.
+    for (size_t i = 1; i <= 8; i++)
+        cache.access(i * 64);
+    cache.access(0);
+
+    assert(cache.get_hit_rate(3) > 0);
+    assert(cache.get_memory_accesses() == 9);
+}
+
+void test_config_file() {
+    const char* path = "cache_tests_config.tmp";
+    {
+        std::ofstream out(path);
+        out << "# name capacity line_size hit_time policy ways\n"
+            << "level L1 512 64 4 lru 8\n"
+            << "level L2 1024 64 14 lfu\n"
+            << "\n"
+            << "memory_penalty 250\n";
+    }
+
+    CacheConfig config = CacheConfig::load(path);
+    std::remove(path);
+
+    assert(config.levels.size() == 2);
+    assert(config.levels[0].ways == 8);
+    assert(config.levels[1].policy == CachePolicy::LFU);
+    assert(config.memory_penalty == 250);
+
+    CacheLevelConfig level = CacheConfig::parse_level("L4:4096:128:60:fifo");
+    assert(level.name == "L4" && level.line_size == 128 && level.ways == 0);
+    assert(level.write_policy == WritePolicy::WRITE_BACK && level.write_allocate);
+
+    level = CacheConfig::parse_level("L1:64:64:4:lru:4:write-through:no-write-allocate");
+    assert(level.ways == 4 && level.write_policy == WritePolicy::WRITE_THROUGH);
+    assert(!level.write_allocate);
+
+    bool rejected = false;
+    try {
+        CacheConfig::parse_level("L1:4:16:1:random");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+}
+
+template <class Policy, Associativity Layout>
+void check_static_matches_dynamic(size_t ways) {
+    CacheConfig config = CacheConfig::defaults(Policy::kind());
+    for (auto& level : config.levels)
+        level.ways = ways;
+
+    CacheSimulator dynamic(config);
+    StaticCacheSimulator<Policy, Layout> specialised(config);
+
+    std::mt19937 rng(3);
+    std::vector<size_t> trace(2000);
+    for (auto& address : trace)
+        address = rng() % 1024;
+
+    const char* path = "test_static_snapshot.bin";
+    const size_t half = trace.size() / 2;
+    for (size_t i = 0; i < trace.size(); i++) {
+        if (i == half) {
+            SnapshotWriter out;
+            specialised.save(out);
+            out.write(path);
+        }
+        dynamic.access(trace[i]);
+        specialised.access(trace[i]);
+    }
+
+    auto same = [&dynamic](const auto& other) {
+        for (size_t level = 0; level < 3; level++)
+            assert(dynamic.get_hit_rate(level) == other.get_hit_rate(level));
+        assert(dynamic.get_avg_access_time() == other.get_avg_access_time());
+    };
+    same(specialised);
+
+    // The static levels' snapshot, whose blocks lack some stamps, resumes
+    // either kind of simulator.
+    CacheSimulator dynamic_fork(config);
+    StaticCacheSimulator<Policy, Layout> static_fork(config);
+    {
+        SnapshotReader in(path);
+        dynamic_fork.restore(in);
+    }
+    {
+        SnapshotReader in(path);
+        static_fork.restore(in);
+    }
+    std::remove(path);
+
+    for (size_t i = half; i < trace.size(); i++) {
+        dynamic_fork.access(trace[i]);
+        static_fork.access(trace[i]);
+    }
+    same(dynamic_fork);
+    same(static_fork);
+}
+
+template <class Policy>
+void check_static_matches_dynamic() {
+    check_static_matches_dynamic<Policy, Associativity::FULL>(0);
+    check_static_matches_dynamic<Policy, Associativity::SET>(2);
+}
+
+void test_static_policies_match_dynamic() {
+    check_static_matches_dynamic<FifoPolicy>();
+    check_static_matches_dynamic<LruPolicy>();
+    check_static_matches_dynamic<LfuPolicy>();
+    check_static_matches_dynamic<LfuAgingPolicy>();
+
+    // A fixed layout refuses levels of the other kind.
+    bool rejected = false;
+    try {
+        BasicCacheLevel<LruPolicy, Associativity::FULL> level(8, 1, CachePolicy::LRU, 2);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    rejected = false;
+    try {
+        BasicCacheLevel<LruPolicy, Associativity::SET> level(8, 1, CachePolicy::LRU);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+}
+
+void test_arc_scan_resistance() {
+    CacheLevel level(4, 1, CachePolicy::ARC);
+
+    level.insert(1);
+    level.insert(2);
+    assert(level.access(1));
+    assert(level.access(2));
+
+    for (size_t b = 100; b < 110; b++)
+        level.insert(b);
+
+    assert(level.access(1));
+    assert(level.access(2));
+}
+
+void test_two_q_promotes_from_ghost() {
+    CacheLevel level(8, 1, CachePolicy::TWO_Q);
+
+    level.insert(1);
+    level.insert(2);
+    for (size_t b = 100; b < 108; b++)
+        level.insert(b);
+
+    // 1 and 2 were pushed out of A1in; a second miss lands them in Am.
+    assert(!level.access(1));
+    level.insert(1);
+    assert(!level.access(2));
+    level.insert(2);
+
+    for (size_t b = 200; b < 216; b++)
+        level.insert(b);
+
+    assert(level.access(1));
+    assert(level.access(2));
+}
+
+void test_clock_second_chance() {
+    CacheLevel level(3, 1, CachePolicy::CLOCK);
+
+    level.insert(1);
+    level.insert(2);
+    level.insert(3);
+    assert(level.access(1));
+
+    level.insert(4);
+
+    assert(!level.access(2));
+    assert(level.access(1));
+    assert(level.access(3));
+    assert(level.access(4));
+}
+
+void test_s3fifo_filters_one_hit_wonders() {
+    CacheLevel level(10, 1, CachePolicy::S3_FIFO);
+
+    level.insert(1);
+    assert(level.access(1));
+
+    for (size_t b = 100; b < 130; b++)
+        level.insert(b);
+
+    assert(level.access(1));
+}
+
+void test_policies_on_set_associative_levels() {
+    const CachePolicy policies[] = {
+        CachePolicy::ARC, CachePolicy::TWO_Q,
+        CachePolicy::CLOCK, CachePolicy::S3_FIFO
+    };
+
+    for (CachePolicy policy : policies) {
+        CacheLevel level(16, 1, policy, 4);
+        std::mt19937 rng(11);
+
+        for (int i = 0; i < 5000; i++) {
+            size_t block = rng() % 64;
+            if (!level.access(block)) {
+                level.insert(block);
+                assert(level.access(block));
+            }
+        }
+    }
+}
+
+// The textbook reference string: OPT with three frames faults 9 times.
+void test_opt_reference_string() {
+    CacheConfig config;
+    config.levels = {{"L1", 3, 1, 1, CachePolicy::LRU, 0}};
+    config.memory_penalty = 10;
+
+    const size_t refs[] = {7, 0, 1, 2, 0, 3, 0, 4, 2, 3, 0, 3, 2, 1, 2, 0, 1, 7, 0, 1};
+
+    CacheSimulator opt(config);
+    opt.run_opt(std::vector<size_t>(std::begin(refs), std::end(refs)));
+
+    assert(opt.get_total_accesses() == 20);
+    assert(opt.get_memory_accesses() == 9);
+    assert(opt.get_avg_access_time() == (20.0 + 9 * 10) / 20);
+}
+
+void test_opt_bounds_online_policies() {
+    std::mt19937 rng(5);
+    std::vector<size_t> trace;
+    for (int i = 0; i < 20000; i++)
+        trace.push_back((rng() % 4 ? rng() % 512 : rng() % 4096));
+
+    CacheConfig config = CacheConfig::defaults(CachePolicy::LRU);
+    config.levels[1].ways = 2;
+
+    CacheSimulator opt(config);
+    opt.run_opt(trace);
+    assert(opt.get_total_accesses() == trace.size());
+
+    for (CachePolicy policy : {CachePolicy::LRU, CachePolicy::ARC, CachePolicy::LFU}) {
+        config.set_policy(policy);
+        CacheSimulator online(config);
+        for (size_t address : trace)
+            online.access(address);
+
+        assert(opt.get_l1_hit_rate() >= online.get_l1_hit_rate());
+    }
+}
+
+void test_stack_distance_basic() {
+    StackDistanceAnalyzer sd(16);
+
+    // Blocks a b c a b: the reuses of a and b are both at distance 2.
+    for (size_t address : {0, 16, 32, 5, 20})
+        sd.access(address);
+
+    assert(sd.get_cold_misses() == 3);
+    assert(sd.get_histogram().size() == 3 && sd.get_histogram()[2] == 2);
+    assert(sd.miss_ratio(2) == 1.0);
+    assert(sd.miss_ratio(3) == 3.0 / 5);
+}
+
+// The curve must match a fully associative LRU level of every size, also
+// across timestamp compactions.
+void test_stack_distance_matches_lru() {
+    std::mt19937 rng(9);
+    std::vector<size_t> trace;
+    for (int i = 0; i < 30000; i++)
+        trace.push_back(rng() % 3 ? rng() % 2048 : rng() % 65536);
+
+    StackDistanceAnalyzer sd(64);
+    for (size_t address : trace)
+        sd.access(address);
+
+    std::vector<double> curve = sd.miss_ratio_curve();
+
+    for (size_t capacity : {1, 7, 32, 100, 500}) {
+        CacheConfig config;
+        config.levels = {{"L1", capacity, 64, 1, CachePolicy::LRU, 0}};
+
+        CacheSimulator lru(config);
+        for (size_t address : trace)
+            lru.access(address);
+
+        double expected = (double)lru.get_memory_accesses() / trace.size();
+        assert(curve[capacity - 1] == expected);
+        assert(sd.miss_ratio(capacity) == expected);
+    }
+}
+
+void test_trace_formats() {
+    const char* text_path = "test_trace.txt";
+    const char* lackey_path = "test_trace.lackey";
+    const char* bin_path = "test_trace.bin";
+
+    {
+        std::ofstream out(text_path);
+        out << "# comment\n0x10\nW 32\n\n  r 0XfF\n48";
+    }
+    {
+        std::ofstream out(lackey_path);
+        out << "==123== Lackey\nI  04016d4c,3\n L 1ffefffd08,8\n"
+            << " S 0421b0e0,4\n M 04222cac,4\n";
+    }
+
+    TraceRecord rec[8];
+    TraceReader text(text_path, guess_trace_format(text_path));
+    assert(text.read(rec, 8) == 4);
+    assert(rec[0].address == 0x10 && !rec[0].write);
+    assert(rec[1].address == 32 && rec[1].write);
+    assert(rec[2].address == 0xff && !rec[2].write);
+    assert(rec[3].address == 48);
+    assert(text.read(rec, 8) == 0);
+
+    TraceReader lackey(lackey_path, guess_trace_format(lackey_path));
+    assert(lackey.read(rec, 3) == 3);
+    assert(lackey.read(rec + 3, 3) == 1);
+    assert(rec[0].address == 0x1ffefffd08 && !rec[0].write);
+    assert(rec[1].address == 0x421b0e0 && rec[1].write);
+    assert(rec[2].address == 0x4222cac && !rec[2].write);
+    assert(rec[3].address == 0x4222cac && rec[3].write);
+
+    {
+        TraceReader again(lackey_path, TraceFormat::Lackey);
+        assert(write_binary_trace(again, bin_path) == 4);
+    }
+    TraceReader bin(bin_path, guess_trace_format(bin_path));
+    assert(bin.read(rec, 8) == 4 && rec[3].address == 0x4222cac && !rec[3].write);
+
+    // A full disk must not leave a silently truncated trace.
+    bool threw = false;
+    try {
+        TraceReader again(lackey_path, TraceFormat::Lackey);
+        write_binary_trace(again, "/dev/full");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::remove(text_path);
+    std::remove(lackey_path);
+    std::remove(bin_path);
+}
+
+// Replaying a multi-megabyte text trace (lines straddle the read buffer)
+// must match feeding the same addresses directly.
+void test_trace_replay_matches_direct() {
+    const char* path = "test_trace_large.txt";
+    std::mt19937 rng(11);
+    std::vector<size_t> trace;
+    {
+        std::ofstream out(path);
+        for (int i = 0; i < 300000; i++) {
+            trace.push_back(rng() % 100000);
+            out << "0x" << std::hex << trace.back() << "\n";
+        }
+    }
+
+    CacheSimulator direct(CachePolicy::LRU);
+    for (size_t address : trace)
+        direct.access(address);
+
+    CacheSimulator replayed(CachePolicy::LRU);
+    TraceReader reader(path, TraceFormat::Text);
+    std::vector<TraceRecord> chunk(4096);
+    while (size_t n = reader.read(chunk.data(), chunk.size())) {
+        for (size_t i = 0; i < n; i++)
+            replayed.access(chunk[i].address);
+    }
+
+    assert(reader.get_records_read() == trace.size());
+    assert(reader.get_bytes_read() > (1 << 20));
+    assert(replayed.get_total_accesses() == direct.get_total_accesses());
+    assert(replayed.get_memory_accesses() == direct.get_memory_accesses());
+    assert(replayed.get_l1_hit_rate() == direct.get_l1_hit_rate());
+
+    std::remove(path);
+}
+
+// Round trip through the compressed format, including chunk boundaries,
+// negative deltas and the write bit, then decode one chunk via the index.
+void test_compressed_trace_round_trip() {
+    const char* path = "test_trace.mtc";
+    std::mt19937_64 rng(13);
+    std::vector<TraceRecord> trace;
+    for (size_t i = 0; i < 2 * TRACE_CHUNK_RECORDS + 100; i++) {
+        uint64_t address = (rng() % 64 == 0) ? rng() : 4096 + rng() % 1024;
+        trace.push_back({address & ~uint64_t(15), rng() % 3 == 0});
+    }
+
+    {
+        CompressedTraceWriter writer(path, 16, true);
+        for (const TraceRecord& rec : trace)
+            writer.append(rec);
+    }
+
+    TraceReader reader(path, guess_trace_format(path));
+    std::vector<TraceRecord> decoded(1000);
+    size_t pos = 0;
+    while (size_t n = reader.read(decoded.data(), decoded.size())) {
+        for (size_t i = 0; i < n; i++, pos++) {
+            assert(decoded[i].address == trace[pos].address);
+            assert(decoded[i].write == trace[pos].write);
+        }
+    }
+    assert(pos == trace.size());
+
+    CompressedTraceHeader header;
+    std::vector<TraceChunkInfo> index = read_trace_index(path, header);
+    assert(index.size() == 3 && index[2].records == 100);
+    assert(header.block_shift == 4 && (header.flags & TRACE_FLAG_WRITES));
+
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> payload(index[1].bytes);
+    in.seekg(index[1].offset + 8);
+    in.read(reinterpret_cast<char*>(payload.data()), payload.size());
+
+    std::vector<TraceRecord> chunk(index[1].records);
+    decode_trace_chunk(payload.data(), payload.size(), chunk.size(), header, chunk.data());
+    assert(chunk[0].address == trace[TRACE_CHUNK_RECORDS].address);
+    assert(chunk.back().address == trace[2 * TRACE_CHUNK_RECORDS - 1].address);
+
+    // Mostly local accesses should take far less than 8 bytes each.
+    in.seekg(0, std::ios::end);
+    assert(static_cast<size_t>(in.tellg()) < trace.size() * 2);
+
+    std::remove(path);
+}
+
+// A small ring forces wrap-around and producer back-pressure; nothing may
+// be lost or reordered.
+void test_event_log_round_trip() {
+    const char* path = "test_events.bin";
+    std::vector<std::string> names = {"L1", "L2"};
+    std::ostringstream expected;
+
+    {
+        EventLog log(path, names, 64);
+        for (uint32_t i = 0; i < 10000; i++) {
+            CacheEvent event{i * 16ull, i, i % 3, 1 + i % 200, (1u << (i % 3)) - 1,
+                             static_cast<uint8_t>(i % 2), {}};
+            log.record(event);
+            write_event_text(expected, names, event);
+        }
+        log.close();
+        assert(log.get_written() == 10000);
+    }
+
+    std::ostringstream decoded;
+    assert(decode_event_log(path, decoded) == 10000);
+    assert(decoded.str() == expected.str());
+    std::remove(path);
+}
+
+// Write errors in the writer thread surface in the producer instead of
+// terminating the process, whether or not it is waiting on a full ring.
+void test_event_log_write_error() {
+    std::vector<std::string> names = {"L1"};
+    bool threw = false;
+    {
+        EventLog log("/dev/full", names, 64);
+        try {
+            for (uint32_t i = 0; i < 100000; i++)
+                log.record({i, i, 0, 1, 0, 0, {}});
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+    }
+    assert(threw);
+
+    threw = false;
+    EventLog small("/dev/full", names, 64);
+    small.record({0, 0, 0, 1, 0, 0, {}});
+    try {
+        small.close();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+// The file log of a simulator decodes to the text stdout logging prints.
+void test_simulator_event_log() {
+    CacheSimulator cache(CachePolicy::LRU);
+    cache.enable_filelog();
+    for (size_t address : {5, 5, 100, 5, 4000})
+        cache.access(address);
+    cache.disable_filelog();
+
+    std::ostringstream decoded;
+    assert(decode_event_log(CacheSimulator::EVENT_LOG_PATH, decoded) == 5);
+    std::string text = decoded.str();
+    assert(text.find("ACCESS 5 (block 0):\n  L1 MISS\n  L2 MISS\n  L3 MISS\n"
+                     "  MAIN MEMORY ACCESS\n  Loaded into L3\n  Loaded into L2\n"
+                     "  Loaded into L1\n  Access time: 126 cycles\n") == 0);
+    assert(text.find("ACCESS 5 (block 0):\n  L1 HIT\n  Access time: 1 cycles\n") != std::string::npos);
+    std::remove(CacheSimulator::EVENT_LOG_PATH);
+}
+
+// Only the levels an access actually filled are reported as loaded.
+void test_event_log_fills() {
+    CacheConfig config;
+    config.levels = {
+        CacheConfig::parse_level("L1:4:16:1:lru:wt:nwa"),
+        CacheConfig::parse_level("L2:16:16:10:lru"),
+    };
+    config.memory_penalty = 100;
+
+    // A no-write-allocate L1 is skipped on a write miss; L2 still fills.
+    CacheSimulator nwa(config);
+    nwa.enable_filelog();
+    nwa.access(0, AccessType::WRITE);
+    nwa.disable_filelog();
+    std::ostringstream decoded;
+    decode_event_log(CacheSimulator::EVENT_LOG_PATH, decoded);
+    assert(decoded.str() == "ACCESS 0 (block 0, write):\n  L1 MISS\n  L2 MISS\n"
+                            "  MAIN MEMORY ACCESS\n  Loaded into L2\n"
+                            "  Access time: 111 cycles\n");
+
+    // An exclusive hierarchy moves the line into L1 alone.
+    config.levels[0] = CacheConfig::parse_level("L1:4:16:1:lru");
+    config.inclusion = InclusionPolicy::EXCLUSIVE;
+    CacheSimulator exclusive(config);
+    exclusive.enable_filelog();
+    exclusive.access(0);
+    exclusive.disable_filelog();
+    decoded.str("");
+    decode_event_log(CacheSimulator::EVENT_LOG_PATH, decoded);
+    assert(decoded.str() == "ACCESS 0 (block 0):\n  L1 MISS\n  L2 MISS\n"
+                            "  MAIN MEMORY ACCESS\n  Loaded into L1\n"
+                            "  Access time: 111 cycles\n");
+    std::remove(CacheSimulator::EVENT_LOG_PATH);
+}
+
+// Two dirty lines pushed out of a write-back L1 become write-backs into
+// L2, and their cost shows up in the average access time.
+void test_write_back_dirty_evictions() {
+    CacheSimulator cache(CachePolicy::LRU);
+
+    cache.access(0, AccessType::WRITE);
+    cache.access(16, AccessType::WRITE);
+    for (size_t address : {32, 48, 64, 80})
+        cache.access(address);
+
+    assert(cache.get_write_count() == 2);
+    assert(cache.get_writebacks(0) == 2);
+    assert(cache.get_writebacks(1) == 0);
+    assert(cache.get_memory_writes() == 0);
+    assert(cache.get_write_cycles() == 2 * 5);
+    assert(cache.get_avg_access_time() == (6 * 126.0 + 10) / 6);
+
+    // Re-reading a written-back line does not write it back again.
+    cache.access(0);
+    assert(cache.get_writebacks(0) == 2);
+}
+
+void test_write_through_no_allocate() {
+    CacheConfig config;
+    config.levels = {
+        CacheConfig::parse_level("L1:4:16:1:lru:wt:nwa"),
+        CacheConfig::parse_level("L2:16:16:10:lru:write-back"),
+    };
+    config.memory_penalty = 100;
+    assert(config.levels[0].write_policy == WritePolicy::WRITE_THROUGH);
+    assert(!config.levels[0].write_allocate && config.levels[1].write_allocate);
+
+    CacheSimulator cache(config);
+
+    // L1 does not allocate on the write miss; L2 does and takes the write.
+    cache.access(0, AccessType::WRITE);
+    assert(cache.get_write_throughs(0) == 0);
+    assert(cache.get_avg_access_time() == 111);
+
+    // A read brings the line into L1; the next write hits there and is
+    // written through to L2, where it stays dirty.
+    cache.access(0);
+    cache.access(0, AccessType::WRITE);
+    assert(cache.get_hit_rate(0) == 1.0 / 3 * 100.0);
+    assert(cache.get_write_throughs(0) == 1);
+    assert(cache.get_memory_writes() == 0);
+
+    // Sixteen more lines push the dirty one out of L2 to memory.
+    for (size_t i = 1; i <= 16; i++)
+        cache.access(i * 16);
+    assert(cache.get_writebacks(1) == 1);
+    assert(cache.get_memory_writes() == 1);
+}
+
+// L2 evicting a line that L1 still holds must take it out of L1 too.
+void test_inclusive_back_invalidation() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 2, 16, 1, CachePolicy::LRU, 0},
+        {"L2", 2, 16, 10, CachePolicy::LRU, 0},
+    };
+    config.inclusion = InclusionPolicy::INCLUSIVE;
+    CacheSimulator cache(config);
+
+    cache.access(0);
+    cache.access(16);
+    cache.access(0);    // L1 hit; L2 still sees 0 as its oldest line
+    cache.access(32);   // L2 evicts 0, which leaves L1 as well
+
+    assert(cache.get_back_invalidations(1) == 1);
+    assert(cache.get_unique_capacity() == 2 * 16);
+
+    cache.access(0);
+    assert(cache.get_l1_hit_rate() == 1.0 / 5 * 100.0);
+    assert(cache.get_memory_accesses() == 4);
+}
+
+void test_exclusive_demotion() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 2, 16, 1, CachePolicy::LRU, 0},
+        {"L2", 2, 16, 10, CachePolicy::LRU, 0},
+    };
+    config.inclusion = InclusionPolicy::EXCLUSIVE;
+    CacheSimulator cache(config);
+
+    for (size_t address : {0, 16, 32, 48})
+        cache.access(address);
+
+    assert(cache.get_demotions(0) == 2);
+    assert(cache.get_unique_capacity() == cache.get_total_capacity());
+
+    // 0 was demoted to L2; hitting it there swaps it with L1's LRU line.
+    cache.access(0);
+    assert(cache.get_l2_hit_rate() == 1.0 / 5 * 100.0);
+    assert(cache.get_demotions(0) == 3);
+    assert(cache.get_memory_accesses() == 4);
+
+    // Dirty lines keep their state while moving and are written back
+    // only when they leave the last level.
+    cache.access(64, AccessType::WRITE);
+    for (size_t address : {80, 96, 112})
+        cache.access(address);
+    assert(cache.get_memory_writes() == 0);
+    cache.access(128);
+    assert(cache.get_memory_writes() == 1);
+
+    bool rejected = false;
+    config.levels[1].line_size = 64;
+    try {
+        config.validate();
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+}
+
+// Random traffic through inclusive and exclusive hierarchies for every
+// policy, fully and set-associative, with prefetchers filling lines too:
+// inclusion must hold throughout.
+void test_inclusion_invariants() {
+    const CachePolicy policies[] = {
+        CachePolicy::FIFO, CachePolicy::LRU, CachePolicy::LFU, CachePolicy::LFU_AGING,
+        CachePolicy::ARC, CachePolicy::TWO_Q, CachePolicy::CLOCK, CachePolicy::S3_FIFO,
+    };
+
+    for (CachePolicy policy : policies) {
+        for (size_t ways : {0, 2}) {
+            CacheConfig config;
+            config.levels = {
+                {"L1", 8, 16, 1, policy, ways},
+                {"L2", 32, 32, 5, policy, ways},
+                {"L3", 64, 32, 20, policy, 0},
+            };
+            config.set_prefetch("L1", PrefetchPolicy::NEXT_LINE, 2);
+            config.set_prefetch("L2", PrefetchPolicy::STRIDE, 1);
+            config.inclusion = InclusionPolicy::INCLUSIVE;
+            CacheSimulator inclusive(config);
+
+            for (auto& level : config.levels)
+                level.line_size = 16;
+            config.inclusion = InclusionPolicy::EXCLUSIVE;
+            CacheSimulator exclusive(config);
+
+            std::mt19937 rng(21);
+            for (int i = 0; i < 20000; i++) {
+                size_t address = rng() % 4096;
+                AccessType type = rng() % 4 ? AccessType::READ : AccessType::WRITE;
+                inclusive.access(address, type);
+                exclusive.access(address, type);
+            }
+
+            // With inclusion intact the unique data is exactly the (full)
+            // last level; any stray upper line would add to it.
+            assert(inclusive.get_unique_capacity() == 64 * 32);
+            assert(exclusive.get_unique_capacity() == exclusive.get_total_capacity());
+        }
+    }
+}
+
+// Tagged next-line prefetching keeps a sequential scan one step ahead, so
+// only the first access misses.
+void test_next_line_prefetch() {
+    CacheConfig config = CacheConfig::defaults(CachePolicy::LRU);
+    config.set_prefetch("L1", PrefetchPolicy::NEXT_LINE, 2);
+    CacheSimulator cache(config);
+
+    for (size_t address = 0; address < 3200; address += 16)
+        cache.access(address);
+
+    const PrefetchCounters& p = cache.get_prefetch_counters(0);
+    assert(cache.get_memory_accesses() == 1);
+    assert(p.useful == 199 && p.issued == 201);
+    assert(cache.get_prefetch_coverage(0) == 199.0 / 200 * 100.0);
+    assert(cache.get_prefetch_counters(1).issued == 0);
+}
+
+void test_stride_and_stream_prefetch() {
+    CacheConfig config;
+    config.levels = {{"L1", 64, 16, 1, CachePolicy::LRU, 0}};
+
+    // A stride of three lines is learned after three accesses.
+    config.set_prefetch("L1", PrefetchPolicy::STRIDE, 2);
+    CacheSimulator strided(config);
+    for (size_t i = 0; i < 80; i++)
+        strided.access(i * 48);
+    assert(strided.get_memory_accesses() == 3);
+    assert(strided.get_prefetch_accuracy(0) > 95.0);
+
+    // A descending scan trains a stream on its second miss.
+    config.set_prefetch("L1", PrefetchPolicy::STREAM, 4);
+    CacheSimulator stream(config);
+    for (size_t i = 2000; i-- > 1000;)
+        stream.access(i * 16);
+    assert(stream.get_memory_accesses() == 2);
+}
+
+// Prefetching two lines ahead into a four-line cache that loops over two
+// scattered lines only displaces the loop.
+void test_prefetch_pollution() {
+    CacheConfig config;
+    config.levels = {{"L1", 4, 16, 1, CachePolicy::LRU, 0}};
+    config.set_prefetch("L1", PrefetchPolicy::NEXT_LINE, 2);
+    CacheSimulator cache(config);
+
+    for (int round = 0; round < 10; round++) {
+        for (size_t address : {0, 320})
+            cache.access(address);
+    }
+
+    const PrefetchCounters& p = cache.get_prefetch_counters(0);
+    assert(p.useful == 0 && p.issued > 0);
+    assert(p.pollution > 0);
+    assert(p.unused > 0);
+}
+
+void test_mesi_transitions() {
+    MulticoreSimulator mc(CacheConfig::defaults(CachePolicy::LRU), 2);
+
+    mc.access(0, 0);
+    assert(mc.get_state(0, 0) == MesiState::EXCLUSIVE);
+    mc.access(1, 0);
+    assert(mc.get_state(0, 0) == MesiState::SHARED && mc.get_state(1, 0) == MesiState::SHARED);
+    assert(mc.get_interventions() == 1);
+
+    // Upgrade from S invalidates the other copy.
+    mc.access(0, 0, AccessType::WRITE);
+    assert(mc.get_state(0, 0) == MesiState::MODIFIED && mc.get_state(1, 0) == MesiState::INVALID);
+    assert(!mc.is_cached(1, 0));
+    assert(mc.get_counters(0).upgrades == 1 && mc.get_invalidations() == 1);
+
+    // Reading the written word back is a true-sharing coherence miss.
+    mc.access(1, 0);
+    assert(mc.get_state(0, 0) == MesiState::SHARED && mc.get_writebacks() == 1);
+    assert(mc.get_counters(1).coherence_misses == 1 && mc.get_counters(1).true_sharing == 1);
+
+    // The other word of the 16-byte line: false sharing.
+    mc.access(1, 8, AccessType::WRITE);
+    mc.access(0, 0);
+    assert(mc.get_counters(0).coherence_misses == 1 && mc.get_counters(0).false_sharing == 1);
+
+    // E -> M needs no upgrade.
+    mc.access(0, 64);
+    mc.access(0, 64, AccessType::WRITE);
+    assert(mc.get_state(0, 64) == MesiState::MODIFIED && mc.get_counters(0).upgrades == 1);
+}
+
+// Writers ping-ponging one line see coherence misses; the same writes to
+// separate lines see none.
+void test_multicore_false_sharing() {
+    for (size_t distance : {8, 16}) {
+        MulticoreSimulator mc(CacheConfig::defaults(CachePolicy::LRU), 2);
+        for (int i = 0; i < 100; i++) {
+            mc.access(0, 0, AccessType::WRITE);
+            mc.access(1, distance, AccessType::WRITE);
+        }
+
+        if (distance == 8) {
+            assert(mc.get_coherence_misses() == 198);
+            assert(mc.get_counters(0).false_sharing == 99);
+            assert(mc.get_counters(1).false_sharing == 99);
+        } else {
+            assert(mc.get_coherence_misses() == 0 && mc.get_invalidations() == 0);
+            assert(mc.get_counters(0).misses[0] == 1);
+        }
+    }
+}
+
+// Random traffic from four cores over few lines: at most one E/M copy,
+// no other copy beside it, and the directory agrees with the caches.
+void test_mesi_invariants() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 4, 16, 1, CachePolicy::LRU, 0},
+        {"L2", 8, 16, 5, CachePolicy::FIFO, 2},
+        {"L3", 32, 16, 20, CachePolicy::LRU, 4},
+    };
+    MulticoreSimulator mc(config, 4);
+    std::mt19937 rng(5);
+
+    for (int i = 0; i < 20000; i++) {
+        size_t core = rng() % 4;
+        size_t address = rng() % 48 * 16 + rng() % 16;
+        mc.access(core, address, rng() % 3 == 0 ? AccessType::WRITE : AccessType::READ);
+
+        for (size_t line = 0; line < 48 * 16; line += 16) {
+            size_t owners = 0, holders = 0;
+            for (size_t c = 0; c < 4; c++) {
+                MesiState state = mc.get_state(c, line);
+                assert(mc.is_cached(c, line) == (state != MesiState::INVALID));
+                holders += state != MesiState::INVALID;
+                owners += state == MesiState::EXCLUSIVE || state == MesiState::MODIFIED;
+            }
+            assert(owners <= 1 && (owners == 0 || holders == 1));
+        }
+    }
+    assert(mc.get_back_invalidations() > 0 && mc.get_coherence_misses() > 0);
+}
+
+// Per-core text traces with explicit times replay in time order.
+void test_multicore_replay() {
+    const char* paths[] = {"test_core0.txt", "test_core1.txt"};
+    {
+        std::ofstream core0(paths[0]);
+        core0 << "W 0x100 5\nR 0x200 30\n";
+        std::ofstream core1(paths[1]);
+        core1 << "R 0x100 10\nW 0x100 20\n# done\n";
+    }
+
+    TraceRecord rec[2];
+    TraceReader reader(paths[1], TraceFormat::Text);
+    assert(reader.read(rec, 2) == 2 && rec[0].time == 10 && rec[1].time == 20);
+
+    MulticoreSimulator replayed(CacheConfig::defaults(CachePolicy::LRU), 2);
+    assert(replayed.replay({paths[0], paths[1]}, TraceFormat::Text) == 4);
+
+    MulticoreSimulator direct(CacheConfig::defaults(CachePolicy::LRU), 2);
+    direct.access(0, 0x100, AccessType::WRITE);
+    direct.access(1, 0x100);
+    direct.access(1, 0x100, AccessType::WRITE);
+    direct.access(0, 0x200);
+
+    for (size_t core = 0; core < 2; core++) {
+        assert(replayed.get_counters(core).cycles == direct.get_counters(core).cycles);
+        assert(replayed.get_counters(core).upgrades == direct.get_counters(core).upgrades);
+    }
+    assert(replayed.get_state(1, 0x100) == MesiState::MODIFIED);
+    assert(replayed.get_interventions() == 1 && replayed.get_invalidations() == 1);
+
+    std::remove(paths[0]);
+    std::remove(paths[1]);
+}
+
+// A sweep gives every configuration the numbers a simulator of its own
+// would, whatever the number of threads.
+void test_sweep_matches_separate_runs() {
+    const char* path = "test_sweep.txt";
+    std::mt19937 rng(21);
+    std::vector<std::pair<size_t, bool>> trace;
+    {
+        std::ofstream out(path);
+        for (int i = 0; i < 200000; i++) {
+            size_t address = (i % 3 ? rng() % 4096 : i * 16 % 65536);
+            bool write = rng() % 5 == 0;
+            trace.push_back({address, write});
+            out << (write ? "W " : "R ") << address << "\n";
+        }
+    }
+
+    CacheSweep sweep;
+    sweep.add_policy_grid(CacheConfig::defaults(CachePolicy::LRU), {1, 4});
+    CacheConfig exclusive = CacheConfig::defaults(CachePolicy::LRU);
+    exclusive.inclusion = InclusionPolicy::EXCLUSIVE;
+    sweep.add("exclusive", exclusive);
+    assert(sweep.size() == 17);
+
+    std::vector<SweepResult> one = sweep.run(path, TraceFormat::Text, 1);
+    std::vector<SweepResult> many = sweep.run(path, TraceFormat::Text, 3);
+    assert(one.size() == 17 && many.size() == 17);
+
+    for (size_t i = 0; i < one.size(); i++) {
+        CacheConfig config = i < 16 ? CacheConfig::defaults(CachePolicy::LRU) : exclusive;
+        if (i < 16) {
+            CachePolicy policy;
+            assert(cache_policy_from_string(one[i].name.substr(0, one[i].name.find(' ')), policy));
+            config.set_policy(policy);
+            for (auto& level : config.levels)
+                level.capacity *= i < 8 ? 1 : 4;
+        }
+
+        CacheSimulator cache(config);
+        for (const auto& access : trace)
+            cache.access(access.first, access.second ? AccessType::WRITE : AccessType::READ);
+
+        assert(one[i].accesses == trace.size());
+        assert(one[i].memory_accesses == cache.get_memory_accesses());
+        assert(one[i].avg_access_time == cache.get_avg_access_time());
+        assert(one[i].level_hit_rates[1] == cache.get_hit_rate(1));
+        assert(many[i].memory_accesses == one[i].memory_accesses);
+        assert(many[i].avg_access_time == one[i].avg_access_time);
+    }
+
+    std::ostringstream table;
+    print_sweep(one, table);
+    assert(table.str().find("s3-fifo x4") != std::string::npos);
+
+    std::remove(path);
+}
+
+void test_sampling_scales_levels() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 512, 64, 4, CachePolicy::LRU, 8},
+        {"L2", 32, 64, 14, CachePolicy::LRU, 8},
+        {"L3", 1024, 64, 50, CachePolicy::LRU, 0},
+    };
+
+    CacheConfig scaled = scale_for_sampling(config, 16);
+    assert(scaled.levels[0].capacity == 32 && scaled.levels[0].ways == 8);
+    assert(scaled.levels[1].capacity == 2 && scaled.levels[1].ways == 0);
+    assert(scaled.levels[2].capacity == 64);
+
+    bool threw = false;
+    try {
+        scale_for_sampling(config, 12);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    config.sample_one_in = 4;
+    config.set_prefetch("L1", PrefetchPolicy::NEXT_LINE, 1);
+    threw = false;
+    try {
+        config.validate();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+// The sampled estimates of a mixed trace land near the full simulation,
+// which itself reports exact values. Several 95% intervals are checked at
+// once, so twice the half-width is allowed.
+void test_sampled_simulation_estimates() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 256, 64, 4, CachePolicy::LRU, 4},
+        {"L2", 2048, 64, 14, CachePolicy::LRU, 8},
+        {"L3", 8192, 64, 50, CachePolicy::LRU, 16},
+    };
+    CacheSimulator full(config);
+    config.sample_one_in = 8;
+    CacheSimulator sampled(config);
+
+    std::mt19937 rng(17);
+    const size_t accesses = 400000;
+    for (size_t i = 0; i < accesses; i++) {
+        size_t r = rng() % 10;
+        size_t address = r < 5 ? rng() % 8192 * 64
+                       : r < 8 ? rng() % 65536 * 64
+                               : i * 64 % (1 << 24);
+        full.access(address);
+        sampled.access(address);
+    }
+
+    assert(sampled.get_total_accesses() + sampled.get_skipped_accesses() == accesses);
+    assert(sampled.get_total_accesses() > accesses / 16 &&
+           sampled.get_total_accesses() < accesses / 4);
+    assert(full.get_avg_access_time_estimate().half_width == 0.0);
+
+    SampleEstimate rate = sampled.get_overall_hit_rate_estimate();
+    SampleEstimate time = sampled.get_avg_access_time_estimate();
+    assert(rate.half_width > 0.0 && rate.half_width < 5.0);
+    assert(std::abs(rate.value - full.get_overall_hit_rate()) <= 2 * rate.half_width);
+    assert(std::abs(time.value - full.get_avg_access_time()) <= 2 * time.half_width);
+    for (size_t i = 0; i < 3; i++) {
+        SampleEstimate level = sampled.get_hit_rate_estimate(i);
+        assert(std::abs(level.value - full.get_hit_rate(i)) <= 2 * level.half_width);
+    }
+}
+
+void test_miss_classifier_shadow() {
+    MissClassifier shadow(2);
+    assert(shadow.reference(1) == ShadowResult::FIRST_TOUCH);
+    assert(shadow.reference(2) == ShadowResult::FIRST_TOUCH);
+    assert(shadow.reference(1) == ShadowResult::HIT);
+    assert(shadow.reference(3) == ShadowResult::FIRST_TOUCH);
+    assert(shadow.reference(2) == ShadowResult::MISS);   // LRU evicted it
+
+    // Enough distinct blocks to grow the table several times.
+    MissClassifier big(100);
+    for (size_t b = 0; b < 5000; b++)
+        assert(big.reference(b * 7919) == ShadowResult::FIRST_TOUCH);
+    for (size_t b = 4900; b < 5000; b++)
+        assert(big.reference(b * 7919) == ShadowResult::HIT);
+    assert(big.reference(0) == ShadowResult::MISS);
+}
+
+void test_three_c_classification() {
+    CacheConfig config;
+    config.classify_misses = true;
+
+    // Direct mapped, 4 sets: blocks 0 and 4 share a set and keep evicting
+    // each other, though a 4-line LRU would hold both.
+    config.levels = {{"L1", 4, 16, 1, CachePolicy::LRU, 1}};
+    CacheSimulator direct(config);
+    for (int i = 0; i < 10; i++) {
+        direct.access(0);
+        direct.access(64);
+    }
+    assert(direct.get_compulsory_misses(0) == 2);
+    assert(direct.get_conflict_misses(0) == 18);
+    assert(direct.get_capacity_misses(0) == 0);
+
+    // Fully associative LRU cycling over five blocks: capacity misses.
+    config.levels = {{"L1", 4, 16, 1, CachePolicy::LRU, 0}};
+    CacheSimulator cyclic(config);
+    for (int i = 0; i < 10; i++) {
+        for (size_t block = 0; block < 5; block++)
+            cyclic.access(block * 16);
+    }
+    assert(cyclic.get_compulsory_misses(0) == 5);
+    assert(cyclic.get_capacity_misses(0) == 45);
+    assert(cyclic.get_conflict_misses(0) == 0);
+
+    // Random traffic through a set-associative hierarchy: the three kinds
+    // cover every miss at every level.
+    config.levels = {
+        {"L1", 16, 16, 1, CachePolicy::LRU, 2},
+        {"L2", 64, 32, 5, CachePolicy::FIFO, 4},
+        {"L3", 256, 32, 20, CachePolicy::CLOCK, 0},
+    };
+    CacheSimulator random(config);
+    std::mt19937 rng(8);
+    for (int i = 0; i < 50000; i++)
+        random.access(rng() % 16384);
+    // Level hit rates are shares of all accesses.
+    size_t total = random.get_total_accesses();
+    size_t reaching = total;
+    for (size_t level = 0; level < 3; level++) {
+        size_t hits = (size_t)(random.get_hit_rate(level) * total / 100.0 + 0.5);
+        size_t misses = reaching - hits;
+        assert(random.get_compulsory_misses(level) + random.get_capacity_misses(level) +
+               random.get_conflict_misses(level) == misses);
+        reaching = misses;
+    }
+    assert(random.get_compulsory_misses(0) == 1024);
+    assert(random.get_compulsory_misses(1) == 512 && random.get_compulsory_misses(2) == 512);
+
+    config.classify_misses = false;
+    CacheSimulator off(config);
+    off.access(0);
+    assert(off.get_compulsory_misses(0) == 0);
+}
+
+void test_space_saving_heavy_hitters() {
+    // Three blocks far above total / capacity among a long tail of
+    // one-off blocks: all three survive, with counts within the error.
+    SpaceSaving sketch(16);
+    std::mt19937 rng(3);
+    size_t exact[3] = {0, 0, 0};
+    for (int i = 0; i < 20000; i++) {
+        size_t r = rng() % 10;
+        if (r < 3) {
+            sketch.add(r);
+            exact[r]++;
+        } else {
+            sketch.add(1000 + rng() % 100000);
+        }
+    }
+    assert(sketch.get_total() == 20000);
+
+    std::vector<HotBlock> top = sketch.top(3);
+    assert(top.size() == 3);
+    for (const HotBlock& hot : top) {
+        assert(hot.block < 3);
+        assert(hot.count >= exact[hot.block]);
+        assert(hot.count - hot.error <= exact[hot.block]);
+    }
+    assert(top[0].count >= top[1].count && top[1].count >= top[2].count);
+
+    SpaceSaving small(4);
+    small.add(7);
+    small.add(7);
+    small.add(8);
+    top = small.top(10);
+    assert(top.size() == 2);
+    assert(top[0].block == 7 && top[0].count == 2 && top[0].error == 0);
+}
+
+void test_reuse_histogram() {
+    ReuseHistogram h;
+    h.access(1);
+    h.access(1);   // interval 1
+    h.access(2);
+    h.access(3);
+    h.access(1);   // interval 3
+    h.access(2);   // interval 3
+    for (int i = 0; i < 8; i++)
+        h.access(100 + i);
+    h.access(1);   // interval 9
+
+    assert(h.get_first_touches() == 11);
+    const std::vector<size_t>& b = h.get_buckets();
+    assert(b.size() == 4);
+    assert(b[0] == 1 && b[1] == 2 && b[2] == 0 && b[3] == 1);
+}
+
+void test_reuse_histogram_bounded() {
+    ReuseHistogram h(4);
+    for (size_t i = 0; i < 4; i++)
+        h.access(i);
+    h.access(0);   // interval 4, still tracked
+    h.access(4);   // ages out 1, the least recently used
+    h.access(1);   // back after aging out: a first touch, aging out 2
+    h.access(0);   // interval 3
+
+    assert(h.get_first_touches() == 6);
+    assert(h.get_aged_out() == 2);
+    const std::vector<size_t>& b = h.get_buckets();
+    assert(b.size() == 3 && b[1] == 1 && b[2] == 1);
+}
+
+void test_simulator_profile() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 4, 16, 1, CachePolicy::LRU, 0},
+        {"L2", 16, 16, 10, CachePolicy::LRU, 0},
+    };
+    CacheSimulator cache(config);
+    assert(cache.get_profiler() == nullptr);
+    cache.access(0);   // before profiling: not counted
+
+    cache.enable_profiling(8);
+    // Block 0x40 cycles with four others through the 4-line L1, so it
+    // misses L1 every time but hits L2; the rest are cold streaming blocks.
+    for (int i = 0; i < 50; i++) {
+        cache.access(0x40);
+        for (size_t j = 0; j < 4; j++)
+            cache.access(0x1000 + (i * 4 + j) * 16);
+    }
+
+    const CacheProfiler* profile = cache.get_profiler();
+    assert(profile);
+    std::vector<HotBlock> l1 = profile->get_miss_blocks(0).top(1);
+    assert(l1.size() == 1 && l1[0].block == 4 && l1[0].count >= 50);
+    assert(profile->get_miss_blocks(0).get_total() == cache.get_total_accesses() - 1);
+    // L2 saw every L1 miss; only the first reference to 0x40 missed there.
+    assert(profile->get_reuse(1).get_first_touches() == 201);
+    assert(profile->get_miss_blocks(1).get_total() == 201);
+    // 0x40 comes back every 5 references at both levels.
+    assert(profile->get_reuse(0).get_buckets()[2] == 49);
+
+    const char* path = "cache_tests_profile.tmp";
+    profile->export_csv(path, 2);
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    assert(line == "level,address,misses,error");
+    std::getline(in, line);
+    assert(line.rfind("L1,64,", 0) == 0);
+    in.close();
+    std::remove(path);
+
+    cache.disable_profiling();
+    assert(cache.get_profiler() == nullptr);
+}
+
+void test_virtual_memory_tlbs_and_walks() {
+    CacheConfig config = CacheConfig::defaults(CachePolicy::LRU);
+    config.vm.enabled = true;
+    config.vm.l1_tlb = {"L1 TLB", 4, 1, CachePolicy::LRU, 0};
+    config.vm.l2_tlb = {"L2 TLB", 8, 5, CachePolicy::LRU, 0};
+    CacheSimulator cache(config);
+    const VirtualMemory* vm = cache.get_virtual_memory();
+    assert(vm && vm->get_walk_depth() == 4);
+
+    // Four pages fit the L1 TLB: one walk and minor fault each.
+    for (int round = 0; round < 5; round++) {
+        for (size_t page = 0; page < 4; page++)
+            cache.access(page * 4096 + 8);
+    }
+    const VmCounters& c = vm->get_counters();
+    assert(c.translations == 20 && c.l1_tlb_hits == 16);
+    assert(c.walks == 4 && c.minor_faults == 4 && c.major_faults == 0);
+    assert(c.walk_cycles > 0 && c.fault_cycles == 4 * config.vm.minor_fault_cycles);
+    // Page-table reads are not accesses.
+    assert(cache.get_total_accesses() == 20);
+    // One table page per level covers the first 2 MiB; a page 1 GiB away
+    // needs a new directory and table.
+    assert(vm->get_table_pages() == 4);
+    cache.access(size_t(1) << 30);
+    assert(vm->get_table_pages() == 6);
+
+    // Eight pages cycling through the 4-entry L1 TLB hit the L2 TLB.
+    for (int round = 0; round < 3; round++) {
+        for (size_t page = 0; page < 8; page++)
+            cache.access(page * 4096);
+    }
+    assert(c.walks == 5 + 4);
+    assert(vm->get_tlb_miss_rate(0) > 50.0);
+    assert(c.l2_tlb_hits > 0 && vm->get_tlb_miss_rate(1) < 100.0);
+
+    // Huge pages: a 2 MiB page is one fault and a three-level walk.
+    config.vm.page_size = size_t(2) << 20;
+    CacheSimulator huge(config);
+    for (size_t a = 0; a < (size_t(2) << 20); a += 4096)
+        huge.access(a);
+    assert(huge.get_virtual_memory()->get_walk_depth() == 3);
+    assert(huge.get_virtual_memory()->get_counters().walks == 1);
+    assert(huge.get_virtual_memory()->get_counters().minor_faults == 1);
+
+    config.vm.page_size = 8192;
+    bool threw = false;
+    try {
+        config.validate();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_page_replacement() {
+    CacheConfig config;
+    config.levels = {{"L1", 64, 16, 1, CachePolicy::LRU, 0}};
+    config.vm.enabled = true;
+    config.vm.physical_pages = 2;
+    config.vm.page_policy = CachePolicy::LRU;
+    config.vm.l1_tlb = {"L1 TLB", 4, 1, CachePolicy::LRU, 0};
+    config.vm.l2_tlb.entries = 0;
+    CacheSimulator cache(config);
+    const VmCounters& c = cache.get_virtual_memory()->get_counters();
+
+    cache.access(0x0000);                    // A -> frame 0
+    cache.access(0x1000, AccessType::WRITE); // B -> frame 1, dirty
+    size_t before = cache.get_memory_accesses();
+    cache.access(0x2000);                    // C evicts A, reuses frame 0
+    assert(c.evictions == 1 && c.swap_writes == 0);
+    // A's line at frame 0 was dropped, so C misses rather than hitting it.
+    assert(cache.get_memory_accesses() == before + 1);
+    assert(cache.get_virtual_memory()->get_resident_pages() == 2);
+
+    cache.access(0x0000);                    // A is back from swap, B (dirty) goes
+    assert(c.major_faults == 1 && c.evictions == 2 && c.swap_writes == 1);
+    assert(c.fault_cycles == 3 * config.vm.minor_fault_cycles +
+                             2 * config.vm.major_fault_cycles);
+}
+
+void test_non_blocking_timing() {
+    CacheConfig config;
+    config.levels = {{"L1", 64, 16, 1, CachePolicy::LRU, 0}};
+    config.memory_penalty = 100;
+    config.timing = TimingModel::NON_BLOCKING;
+    config.issue_width = 1;
+
+    // Four independent misses issue on consecutive cycles and overlap.
+    config.levels[0].mshrs = 4;
+    CacheSimulator overlapped(config);
+    for (size_t i = 0; i < 4; i++)
+        overlapped.access(i * 16);
+    const TimingCounters& c = overlapped.get_timer()->get_counters();
+    assert(c.elapsed == 3 + 101);
+    assert(c.mshr_stalls == 0 && c.primary_misses == 4);
+    assert(overlapped.get_avg_access_time() == 104.0 / 4);
+    assert(overlapped.get_timer()->get_mlp() > 3.8);
+
+    // With one MSHR every miss waits for the one before it.
+    config.levels[0].mshrs = 1;
+    CacheSimulator serial(config);
+    for (size_t i = 0; i < 4; i++)
+        serial.access(i * 16);
+    assert(serial.get_timer()->get_counters().elapsed == 4 * 101);
+    assert(serial.get_timer()->get_counters().mshr_stalls == 3);
+
+    // A second access to a line still being filled merges with the fill:
+    // a hit for the cache contents, but it completes when the fill lands.
+    CacheSimulator merging(config);
+    merging.access(0);
+    merging.access(4);
+    merging.access(8);
+    assert(merging.get_hit_rate(0) > 66.0);
+    assert(merging.get_timer()->get_counters().merged == 2);
+    assert(merging.get_timer()->get_counters().elapsed == 101);
+
+    // Hits issue issue_width per cycle: the miss and three hits in cycle
+    // 0, then four a cycle until the last one issues in cycle 200.
+    config.issue_width = 4;
+    CacheSimulator wide(config);
+    wide.access(0);
+    for (int i = 0; i < 800; i++)
+        wide.access(0);
+    assert(wide.get_timer()->get_counters().elapsed == 200 + 1);
+    assert(wide.get_avg_access_time() < 1.0);
+
+    config.timing = TimingModel::BLOCKING;
+    CacheSimulator blocking(config);
+    blocking.access(0);
+    blocking.access(16);
+    assert(!blocking.get_timer());
+    assert(blocking.get_avg_access_time() == 101.0);
+}
+
+void test_dram_row_buffer() {
+    DramConfig config;
+    config.enabled = true;
+    config.t_rcd = 10;
+    config.t_cas = 12;
+    config.t_rp = 14;
+    config.t_burst = 4;
+
+    // Open rows: one activation, then row hits for the rest of the row.
+    DramController open(config, 64);
+    assert(open.access(0, false, 0) == 10 + 12 + 4);
+    assert(open.access(64, false, 1000) == 12 + 4);
+    assert(open.access(128, true, 2000) == 12 + 4);
+    // Another row in bank 0 (one row of every bank lies in between).
+    assert(open.access(8192 * 8, false, 3000) == 14 + 10 + 12 + 4);
+    assert(open.get_counters().row_hits == 2 && open.get_counters().row_conflicts == 1);
+    assert(open.get_counters().writes == 1);
+    assert(open.get_row_hit_rate() == 50.0);
+
+    // Closed rows: every access activates.
+    config.row_policy = RowPolicy::CLOSED;
+    DramController closed(config, 64);
+    for (int i = 0; i < 4; i++)
+        assert(closed.access(i * 64, false, i * 1000) == 10 + 12 + 4);
+    assert(closed.get_counters().row_hits == 0 && closed.get_counters().row_empty == 4);
+
+    // Back-to-back requests to one bank queue behind each other and share
+    // the data bus.
+    config.row_policy = RowPolicy::OPEN;
+    DramController busy(config, 64);
+    busy.access(0, false, 0);
+    assert(busy.access(64, false, 0) == 26 + 4);
+    assert(busy.get_bandwidth() == 128.0 / 30);
+}
+
+void test_dram_address_mapping() {
+    DramConfig config;
+    config.channels = 2;
+    config.banks = 4;
+    config.row_size = 1024;   // 16 lines of 64 bytes
+
+    DramController by_row(config, 64);
+    DramController::Location a = by_row.map(64 * 3);
+    assert(a.column == 3 && a.channel == 0 && a.bank == 0 && a.row == 0);
+    DramController::Location b = by_row.map(64 * 16);
+    assert(b.column == 0 && b.channel == 1);
+
+    config.mapping = AddressMapping::ROW_COLUMN_BANK;
+    DramController by_bank(config, 64);
+    DramController::Location c = by_bank.map(64 * 3);
+    assert(c.channel == 1 && c.bank == 1 && c.column == 0);
+
+    // XOR spreads rows that share a bank under ROW_BANK_COLUMN.
+    config.mapping = AddressMapping::XOR;
+    DramController spread(config, 64);
+    size_t row_stride = 1024 * 2 * 4;
+    assert(by_row.map(0).bank == by_row.map(row_stride).bank);
+    assert(spread.map(0).bank != spread.map(row_stride).bank);
+
+    config.banks = 6;
+    bool threw = false;
+    try {
+        config.validate(64);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_dram_behind_hierarchy() {
+    CacheConfig config;
+    config.levels = {{"L1", 8, 64, 1, CachePolicy::LRU, 0}};
+    config.dram.enabled = true;
+    CacheSimulator streaming(config);
+    for (size_t i = 0; i < 256; i++)
+        streaming.access(i * 64);
+
+    const DramController* dram = streaming.get_dram();
+    assert(dram && dram->get_counters().reads == 256);
+    // 128 lines per 8 KiB row: two activations.
+    assert(dram->get_counters().row_empty == 2);
+    assert(streaming.get_avg_access_time() < 1 + config.memory_penalty);
+
+    config.dram.enabled = false;
+    CacheSimulator flat(config);
+    flat.access(0);
+    assert(!flat.get_dram());
+    assert(flat.get_avg_access_time() == 1.0 + config.memory_penalty);
+}
+
+void test_snapshot_round_trip() {
+    CacheConfig config;
+    config.levels = {
+        {"L1", 8, 64, 1, CachePolicy::LRU, 2},
+        {"L2", 32, 64, 4, CachePolicy::LFU_AGING, 0},
+        {"L3", 64, 64, 10, CachePolicy::FIFO, 4},
+    };
+    config.levels[1].write_policy = WritePolicy::WRITE_THROUGH;
+
+    std::mt19937 rng(7);
+    std::vector<std::pair<size_t, AccessType>> trace;
+    for (size_t i = 0; i < 20000; i++) {
+        size_t address = (rng() % 160) * 64;
+        trace.push_back({address, rng() % 4 == 0 ? AccessType::WRITE : AccessType::READ});
+    }
+
+    const char* path = "test_snapshot.bin";
+    CacheSimulator warm(config);
+    for (size_t i = 0; i < trace.size() / 2; i++)
+        warm.access(trace[i].first, trace[i].second);
+    {
+        SnapshotWriter out;
+        warm.save(out);
+        out.write(path);
+    }
+    for (size_t i = trace.size() / 2; i < trace.size(); i++)
+        warm.access(trace[i].first, trace[i].second);
+
+    CacheSimulator forked(config);
+    {
+        SnapshotReader in(path);
+        forked.restore(in);
+    }
+    for (size_t i = trace.size() / 2; i < trace.size(); i++)
+        forked.access(trace[i].first, trace[i].second);
+
+    assert(forked.get_total_accesses() == warm.get_total_accesses());
+    for (size_t l = 0; l < 3; l++) {
+        assert(forked.get_hit_rate(l) == warm.get_hit_rate(l));
+        assert(forked.get_writebacks(l) == warm.get_writebacks(l));
+        assert(forked.get_write_throughs(l) == warm.get_write_throughs(l));
+    }
+    assert(forked.get_memory_accesses() == warm.get_memory_accesses());
+    assert(forked.get_memory_writes() == warm.get_memory_writes());
+    assert(forked.get_avg_access_time() == warm.get_avg_access_time());
+
+    // A simulator that has run, or whose levels differ, cannot take it.
+    bool threw = false;
+    try {
+        SnapshotReader in(path);
+        warm.restore(in);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    CacheConfig other = config;
+    other.levels[2].ways = 8;
+    CacheSimulator mismatched(other);
+    threw = false;
+    try {
+        SnapshotReader in(path);
+        mismatched.restore(in);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::remove(path);
+
+    // ARC keeps ghost lists the blocks do not carry.
+    CacheSimulator arc(CacheConfig::defaults(CachePolicy::ARC));
+    arc.access(0);
+    SnapshotWriter out;
+    threw = false;
+    try {
+        arc.save(out);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    threw = false;
+    try {
+        SnapshotReader in("Makefile");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_allocator_locality() {
+    CacheConfig config;
+    config.levels = {{"L1", 2, 64, 1, CachePolicy::LRU, 0}};
+
+    // Object 1 lands right after object 0, one line further.
+    std::vector<WorkloadOp> ops = {
+        {WorkloadOp::ALLOC, 0, 64},
+        {WorkloadOp::ALLOC, 1, 64},
+        {WorkloadOp::READ, 1, 0},
+        {WorkloadOp::WRITE, 0, 8},
+        {WorkloadOp::READ, 1, 100},   // wraps to offset 32
+        {WorkloadOp::FREE, 0, 0},
+        {WorkloadOp::READ, 0, 0},     // freed: not accessed
+    };
+    ListAllocator list(1024, FitStrategy::FirstFit);
+    CacheSimulator cache(config);
+    LocalityResult r = run_locality("first-fit", list, cache, ops);
+    assert(r.allocations == 2 && r.failed_allocations == 0);
+    assert(r.accesses == 3 && r.footprint == 128);
+    assert(cache.get_memory_accesses() == 2);
+    assert(std::abs(r.hit_rate - 100.0 / 3) < 1e-9);
+    size_t start = 0;
+    assert(!list.get_block_start(1000, start));
+
+    // A request the heap cannot hold fails and its object is never touched.
+    BuddyAllocator small(64);
+    CacheSimulator small_cache(config);
+    r = run_locality("buddy", small, small_cache, {
+        {WorkloadOp::ALLOC, 0, 128}, {WorkloadOp::READ, 0, 0}});
+    assert(r.failed_allocations == 1 && r.accesses == 0);
+
+    LocalityWorkload workload;
+    workload.operations = 3000;
+    std::vector<WorkloadOp> generated = workload.generate();
+    assert(generated.size() > workload.operations);   // initialising writes
+    assert(generated.front().kind == WorkloadOp::ALLOC);
+    std::vector<WorkloadOp> again = workload.generate();
+    assert(again.size() == generated.size() && again.back().arg == generated.back().arg);
+
+    std::vector<LocalityResult> results =
+        compare_allocators(CacheConfig::defaults(CachePolicy::LRU), workload);
+    assert(results.size() == 4 && results.back().name == "buddy");
+    for (const LocalityResult& res : results) {
+        assert(res.failed_allocations == 0);
+        assert(res.accesses == results.front().accesses);
+        assert(res.level_hit_rates.size() == 3);
+        assert(res.external_fragmentation >= 0.0 && res.external_fragmentation <= 100.0);
+    }
+
+    std::ostringstream out;
+    print_locality(results, out);
+    assert(out.str().find("worst-fit") != std::string::npos);
+    assert(out.str().find("largest power of two") == std::string::npos);
+
+    // A heap buddy cannot use whole still compares every allocator.
+    workload.heap_size = 100000;
+    results = compare_allocators(CacheConfig::defaults(CachePolicy::LRU), workload);
+    assert(results.size() == 4);
+    assert(results.front().heap_size == 100000 && results.back().heap_size == 65536);
+    std::ostringstream note;
+    print_locality(results, note);
+    assert(note.str().find("buddy ran on a 65536-byte heap") != std::string::npos);
+}
+
 int main() {
     test_fifo_basic();
     test_lru_basic();
@@ -107,6 +1794,59 @@ int main() {
     test_lfu_eviction();
     test_cache_hit_rate();
     test_cache_levels();
+    test_lru_level_order();
+    test_lfu_level_tie_break();
+    test_lfu_aging_forgets_old_hot_blocks();
+    test_set_associative_reference_l1d();
+    test_direct_mapped_conflict();
+    test_four_level_hierarchy();
+    test_config_file();
+    test_static_policies_match_dynamic();
+    test_arc_scan_resistance();
+    test_two_q_promotes_from_ghost();
+    test_clock_second_chance();
+    test_s3fifo_filters_one_hit_wonders();
+    test_policies_on_set_associative_levels();
+    test_opt_reference_string();
+    test_opt_bounds_online_policies();
+    test_stack_distance_basic();
+    test_stack_distance_matches_lru();
+    test_trace_formats();
+    test_trace_replay_matches_direct();
+    test_compressed_trace_round_trip();
+    test_event_log_round_trip();
+    test_event_log_write_error();
+    test_simulator_event_log();
+    test_event_log_fills();
+    test_write_back_dirty_evictions();
+    test_write_through_no_allocate();
+    test_inclusive_back_invalidation();
+    test_exclusive_demotion();
+    test_inclusion_invariants();
+    test_next_line_prefetch();
+    test_stride_and_stream_prefetch();
+    test_prefetch_pollution();
+    test_mesi_transitions();
+    test_multicore_false_sharing();
+    test_mesi_invariants();
+    test_multicore_replay();
+    test_sweep_matches_separate_runs();
+    test_sampling_scales_levels();
+    test_sampled_simulation_estimates();
+    test_miss_classifier_shadow();
+    test_three_c_classification();
+    test_space_saving_heavy_hitters();
+    test_reuse_histogram();
+    test_reuse_histogram_bounded();
+    test_simulator_profile();
+    test_virtual_memory_tlbs_and_walks();
+    test_page_replacement();
+    test_non_blocking_timing();
+    test_dram_row_buffer();
+    test_dram_address_mapping();
+    test_dram_behind_hierarchy();
+    test_snapshot_round_trip();
+    test_allocator_locality();
     
     std::cout << "[PASS] All cache tests\n";
     return 0;